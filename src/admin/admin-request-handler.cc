@@ -21,13 +21,19 @@
 
 #include "admin/admin-request.h"
 #include "cli/command-handler.h"
+#include "cli/search.h"
 #include "core/configuration.h"
+#include "core/registry.h"
+#include "logging/live-tail.h"
 #include "logging/log.h"
+#include "logging/log-search.h"
 #include "net/session.h"
 #include "tasks/log-rotator.h"
 
 using namespace residue;
 
+const std::size_t AdminRequestHandler::MAX_PENDING_SEARCH_WRITES = 16;
+
 AdminRequestHandler::AdminRequestHandler(Registry* registry, CommandHandler* commandHandler) :
     RequestHandler("Admin", registry),
     m_commandHandler(commandHandler)
@@ -111,6 +117,37 @@ void AdminRequestHandler::handle(RawRequest&& rawRequest)
         }
         break;
     }
+    case AdminRequest::Type::EXTRACT_ARCHIVE:
+        cmd = "extract";
+        params.push_back("--archive");
+        params.push_back(request.archive());
+        if (!request.from().empty()) {
+            params.push_back("--from");
+            params.push_back(request.from());
+        }
+        if (!request.to().empty()) {
+            params.push_back("--to");
+            params.push_back(request.to());
+        }
+        break;
+    case AdminRequest::Type::SEARCH:
+        // not run by command handler as matches are streamed to session
+        search(request, session);
+        return;
+    case AdminRequest::Type::TAIL:
+    {
+        std::string errorText;
+        std::set<std::string> levels;
+        for (std::string level : request.loggingLevels()) {
+            levels.insert(Utils::toLower(level));
+        }
+        if (m_registry->liveTail() == nullptr) {
+            respond("Live tail is not available\n", session);
+        } else if (!m_registry->liveTail()->subscribe(request.loggerId(), levels, request.clientId(), session, &errorText)) {
+            respond(errorText + "\n", session);
+        }
+        return;
+    }
     case AdminRequest::Type::UNKNOWN:
     default:
         break;
@@ -133,6 +170,45 @@ void AdminRequestHandler::handle(RawRequest&& rawRequest)
     respond(result.str(), session);
 }
 
+void AdminRequestHandler::search(const AdminRequest& request, const std::shared_ptr<Session>& session) const
+{
+    if (m_registry->logSearch() == nullptr) {
+        respond("Search is not available\n", session);
+        return;
+    }
+    LogSearch::Query query;
+    query.loggerId = request.loggerId();
+    query.from = Utils::parseTime(request.from());
+    query.to = Utils::parseTime(request.to());
+    if ((!request.from().empty() && query.from == 0) || (!request.to().empty() && query.to == 0)) {
+        respond("Invalid time range\n", session);
+        return;
+    }
+    for (std::string level : request.loggingLevels()) {
+        query.levels.insert(Utils::toLower(level));
+    }
+    query.text = request.text();
+    query.isRegex = request.isRegex();
+    query.isWord = request.isWord();
+    query.maxResults = request.maxResults();
+
+    RVLOG(RV_INFO) << "Running search via admin request on [" << query.loggerId << "]";
+    std::string errorText;
+    if (!m_registry->logSearch()->submit(query, [this, session](const std::string& matches) {
+                                             if (!session->isConnected()
+                                                     || session->pendingWrites() >= MAX_PENDING_SEARCH_WRITES) {
+                                                 RVLOG(RV_INFO) << "Stopping search for session [" << session->id() << "]";
+                                                 return false;
+                                             }
+                                             respond(matches, session);
+                                             return true;
+                                         }, [this, session](const LogSearch::Summary& summary) {
+                                             respond(Search::formatSummary(summary) + "\n", session);
+                                         }, &errorText)) {
+        respond(errorText + "\n", session);
+    }
+}
+
 void AdminRequestHandler::respond(const std::string& response, const std::shared_ptr<Session>& session) const
 {
     session->write(response.c_str(), configuration()->serverKey().c_str());
@@ -24,6 +24,7 @@
 
 namespace residue {
 
+class AdminRequest;
 class CommandHandler;
 ///
 /// \brief Handles incoming AdminRequest
@@ -32,12 +33,22 @@ class CommandHandler;
 class AdminRequestHandler : public RequestHandler
 {
 public:
+    // search is stopped once session has this many responses waiting to be sent
+    static const std::size_t MAX_PENDING_SEARCH_WRITES;
+
     explicit AdminRequestHandler(Registry*, CommandHandler*);
     virtual void handle(RawRequest&&);
 private:
     CommandHandler* m_commandHandler;
 
     void respond(const std::string&, const std::shared_ptr<Session>& session) const;
+
+    ///
+    /// \brief Runs search on search threads and responds with matches as they are found
+    /// (one response per chunk) followed by summary. Search stops if session disconnects or
+    /// does not keep up with responses
+    ///
+    void search(const AdminRequest& request, const std::shared_ptr<Session>& session) const;
 };
 }
 
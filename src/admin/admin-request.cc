@@ -26,6 +26,9 @@ using namespace residue;
 
 AdminRequest::AdminRequest(const Configuration* conf) :
     Request(conf),
+    m_isRegex(false),
+    m_isWord(false),
+    m_maxResults(0),
     m_type(AdminRequest::Type::UNKNOWN)
 {
 }
@@ -40,6 +43,20 @@ bool AdminRequest::deserialize(std::string&& json)
     m_type = static_cast<AdminRequest::Type>(m_jsonDoc.get<unsigned int>("type", 0));
     m_clientId = m_jsonDoc.get<std::string>("client_id", "");
     m_loggerId = m_jsonDoc.get<std::string>("logger_id", "");
+    m_archive = m_jsonDoc.get<std::string>("archive", "");
+    // time range can either be epoch (number) or formatted time (string)
+    m_from = m_jsonDoc.get<std::string>("from", "");
+    if (m_from.empty() && m_jsonDoc.get<unsigned long>("from", 0UL) > 0) {
+        m_from = std::to_string(m_jsonDoc.get<unsigned long>("from", 0UL));
+    }
+    m_to = m_jsonDoc.get<std::string>("to", "");
+    if (m_to.empty() && m_jsonDoc.get<unsigned long>("to", 0UL) > 0) {
+        m_to = std::to_string(m_jsonDoc.get<unsigned long>("to", 0UL));
+    }
+    m_text = m_jsonDoc.get<std::string>("text", "");
+    m_isRegex = m_jsonDoc.get<bool>("regex", false);
+    m_isWord = m_jsonDoc.get<bool>("word", false);
+    m_maxResults = m_jsonDoc.get<unsigned int>("max_results", 0);
     JsonDoc::Value levels = m_jsonDoc.get<JsonDoc::Value>("logging_levels", JsonDoc::Value());
     if (levels.isArray()) {
         for (auto level : levels) {
@@ -52,7 +69,10 @@ bool AdminRequest::deserialize(std::string&& json)
             || (m_type == AdminRequest::Type::LIST_LOGGING_FILES && (!m_loggerId.empty() || !m_clientId.empty()))
             || (m_type == AdminRequest::Type::FORCE_LOG_ROTATION && !m_loggerId.empty())
             || (m_type == AdminRequest::Type::STATS)
-            || (m_type == AdminRequest::Type::LIST_CLIENTS);
+            || (m_type == AdminRequest::Type::LIST_CLIENTS)
+            || (m_type == AdminRequest::Type::EXTRACT_ARCHIVE && !m_archive.empty())
+            || (m_type == AdminRequest::Type::SEARCH && !m_loggerId.empty())
+            || (m_type == AdminRequest::Type::TAIL && !m_loggerId.empty());
     return m_isValid;
 }
 
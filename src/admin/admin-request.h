@@ -41,7 +41,10 @@ public:
         LIST_LOGGING_FILES = 5,
         FORCE_LOG_ROTATION = 6,
         STATS = 7,
-        LIST_CLIENTS = 8
+        LIST_CLIENTS = 8,
+        EXTRACT_ARCHIVE = 9,
+        SEARCH = 10,
+        TAIL = 11
     };
 
     explicit AdminRequest(const Configuration* conf);
@@ -66,12 +69,54 @@ public:
         return m_loggingLevels;
     }
 
+    inline std::string archive() const
+    {
+        return m_archive;
+    }
+
+    inline std::string from() const
+    {
+        return m_from;
+    }
+
+    inline std::string to() const
+    {
+        return m_to;
+    }
+
+    inline std::string text() const
+    {
+        return m_text;
+    }
+
+    inline bool isRegex() const
+    {
+        return m_isRegex;
+    }
+
+    inline bool isWord() const
+    {
+        return m_isWord;
+    }
+
+    inline unsigned int maxResults() const
+    {
+        return m_maxResults;
+    }
+
     virtual bool deserialize(std::string&& json) override;
     virtual bool validateTimestamp() const override;
 private:
     std::string m_clientId;
     std::string m_loggerId;
     std::set<std::string> m_loggingLevels;
+    std::string m_archive;
+    std::string m_from;
+    std::string m_to;
+    std::string m_text;
+    bool m_isRegex;
+    bool m_isWord;
+    unsigned int m_maxResults;
     Type m_type;
 };
 }
@@ -37,7 +37,7 @@ Clients::Clients(Registry* registry) :
 void Clients::execute(std::vector<std::string>&& params, std::ostringstream& result, bool ignoreConfirmation) const
 {
     if (params.empty()) {
-        result << "Clients: " << registry()->clients().size() << std::endl;
+        result << "Clients: " << registry()->clientCount() << std::endl;
     }
     if (hasParam(params, "list")) {
         list(result, &params);
@@ -58,19 +58,19 @@ void Clients::list(std::ostringstream& result, const std::vector<std::string>* p
 {
     int i = 1;
     for (auto& c : registry()->clients()) {
-        result << (i++) << " > " << c.second.id()
-               << ", Ack: " << (c.second.acknowledged() ? "YES" : "NO")
-               << ", Age: " << (Utils::now() - c.second.dateCreated()) << "s"
+        result << (i++) << " > " << c->id()
+               << ", Ack: " << (c->acknowledged() ? "YES" : "NO")
+               << ", Age: " << (Utils::now() - c->dateCreated()) << "s"
                << ", Status: "
-               << (!c.second.isAlive() ? "DEAD" : "ALIVE " + std::to_string(c.second.age() - (Utils::now() - c.second.dateCreated())) + "s");
+               << (!c->isAlive() ? "DEAD" : "ALIVE " + std::to_string(c->age() - (Utils::now() - c->dateCreated())) + "s");
         if (hasParam(*paramsPtr, "--with-token")) {
-            result << ", Token: " << c.second.token();
+            result << ", Token: " << c->token();
         }
         if (hasParam(*paramsPtr, "--with-key")) {
-            result << ", Key: " << c.second.key();
+            result << ", Key: " << c->key();
 
-            if (!c.second.backupKey().empty()) {
-                result << ", Backup Key: " << c.second.backupKey();
+            if (!c->backupKey().empty()) {
+                result << ", Backup Key: " << c->backupKey();
             }
         }
         result << std::endl;
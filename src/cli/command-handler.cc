@@ -24,10 +24,12 @@
 #include "linenoise/linenoise.h"
 
 #include "cli/clients.h"
+#include "cli/extract.h"
 #include "cli/list-logging-files.h"
 #include "cli/rotate.h"
 #include "cli/reset.h"
 #include "cli/reload-config.h"
+#include "cli/search.h"
 #include "cli/stats.h"
 #include "cli/update.h"
 #include "logging/log.h"
@@ -88,6 +90,8 @@ CommandHandler::CommandHandler(Registry* registry) :
     registerCommand(std::unique_ptr<Command>(new Rotate(registry)));
     registerCommand(std::unique_ptr<Command>(new ListLoggingFiles(registry)));
     registerCommand(std::unique_ptr<Command>(new Clients(registry)));
+    registerCommand(std::unique_ptr<Command>(new Extract(registry)));
+    registerCommand(std::unique_ptr<Command>(new Search(registry)));
 }
 
 void CommandHandler::handle(std::string&& cmd,
@@ -0,0 +1,130 @@
+//
+//  extract.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "cli/extract.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+
+#include "core/registry.h"
+#include "logging/log.h"
+#include "tasks/archive-retention.h"
+#include "utils/archive-index.h"
+#include "utils/utils.h"
+
+using namespace residue;
+
+const std::size_t Extract::MAX_RESULT_SIZE = 1024 * 1024; // 1MB
+
+Extract::Extract(Registry* registry) :
+    Command("extract",
+            "Extract logs for time range from archive without decompressing whole archive",
+            "extract --archive <archive> [--from <time>] [--to <time>] [--output <file>]",
+            registry)
+{
+}
+
+void Extract::execute(std::vector<std::string>&& params, std::ostringstream& result, bool) const
+{
+    const std::string archive = getParamValue(params, "--archive");
+    if (archive.empty()) {
+        result << "No archive provided\n";
+        return;
+    }
+    char resolved[PATH_MAX];
+    if (!Utils::fileExists(archive.c_str()) || ::realpath(archive.c_str(), resolved) == nullptr) {
+        result << "Archive [" << archive << "] does not exist\n";
+        return;
+    }
+    if (!isInArchiveDirectory(resolved)) {
+        result << "Archive [" << archive << "] is not in archive directory of any logger\n";
+        return;
+    }
+    types::Time from = 0;
+    types::Time to = 0;
+    if (hasParam(params, "--from") && (from = Utils::parseTime(getParamValue(params, "--from"))) == 0) {
+        result << "Invalid --from, expected epoch seconds or YYYY-MM-DDTHH:MM[:SS]\n";
+        return;
+    }
+    if (hasParam(params, "--to") && (to = Utils::parseTime(getParamValue(params, "--to"))) == 0) {
+        result << "Invalid --to, expected epoch seconds or YYYY-MM-DDTHH:MM[:SS]\n";
+        return;
+    }
+    if (from > 0 && to > 0 && from > to) {
+        result << "--from must be before --to\n";
+        return;
+    }
+    std::string errorText;
+    const std::string output = getParamValue(params, "--output");
+    if (!output.empty()) {
+        std::ofstream out(output, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out.is_open()) {
+            result << "Unable to open [" << output << "] " << std::strerror(errno) << "\n";
+            return;
+        }
+        int frames = ArchiveIndex::extract(resolved, from, to, out, 0, &errorText);
+        if (frames == -1) {
+            result << errorText << "\n";
+            return;
+        }
+        result << "Extracted " << frames << " segment(s) to [" << output << "]\n";
+        return;
+    }
+    std::ostringstream logs;
+    int frames = ArchiveIndex::extract(resolved, from, to, logs, MAX_RESULT_SIZE, &errorText);
+    if (frames == -1) {
+        result << errorText << "\n";
+        return;
+    }
+    result << logs.str();
+    if (logs.tellp() >= static_cast<std::streamoff>(MAX_RESULT_SIZE)) {
+        result << "\n(Output truncated to " << MAX_RESULT_SIZE << " bytes, use --output <file> for complete logs)\n";
+    }
+}
+
+bool Extract::isInArchiveDirectory(const std::string& resolvedPath) const
+{
+    std::vector<std::string> loggerIds;
+    el::Loggers::populateAllLoggerIds(&loggerIds);
+    for (const auto& loggerId : loggerIds) {
+        for (const auto& pattern : ArchiveRetention::archivePatterns(registry()->configuration(), loggerId)) {
+            // deepest directory that has no format specifier
+            std::size_t rootEnd = pattern.find_last_of('/', std::min(pattern.find('%'), pattern.find_last_of('/')));
+            if (rootEnd == std::string::npos) {
+                continue;
+            }
+            char root[PATH_MAX];
+            if (::realpath(rootEnd == 0 ? "/" : pattern.substr(0, rootEnd).c_str(), root) == nullptr) {
+                continue;
+            }
+            std::string rootDir(root);
+            if (rootDir.back() != '/') {
+                rootDir.push_back('/');
+            }
+            if (resolvedPath.compare(0, rootDir.size(), rootDir) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,49 @@
+//
+//  extract.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef Extract_h
+#define Extract_h
+
+#include "cli/command.h"
+
+namespace residue {
+
+class Registry;
+
+///
+/// \brief Extract command to read logs for time range from indexed archive
+///
+class Extract final : public Command
+{
+public:
+    // maximum bytes returned in result when no --output is provided
+    static const std::size_t MAX_RESULT_SIZE;
+
+    explicit Extract(Registry* registry);
+
+    virtual void execute(std::vector<std::string>&&, std::ostringstream&, bool) const override;
+private:
+    ///
+    /// \brief Whether resolved (real) path is inside archived_log_directory of any registered logger
+    ///
+    bool isInArchiveDirectory(const std::string& resolvedPath) const;
+};
+}
+
+#endif /* Extract_h */
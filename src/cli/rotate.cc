@@ -74,7 +74,8 @@ void Rotate::execute(std::vector<std::string>&& params, std::ostringstream& resu
             if (rotator->frequency() != freqPair->second) {
                 continue;
             }
-            if (rotator->isExecuting()) {
+            Task::ExecutionGuard guard(rotator);
+            if (!guard.acquired()) {
                 result << "Log rotator already running, please try later\n";
                 return;
             }
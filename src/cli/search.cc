@@ -0,0 +1,125 @@
+//
+//  search.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "cli/search.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "core/registry.h"
+#include "utils/utils.h"
+
+using namespace residue;
+
+Search::Search(Registry* registry) :
+    Command("search",
+            "Search logs of a logger in live files, closed segments and indexed archives",
+            "search --logger-id <id> [--from <time>] [--to <time>] [--levels <csv_levels>] [--max <n>] [--regex | --word] --text <text>",
+            registry)
+{
+}
+
+bool Search::buildQuery(const std::vector<std::string>& params, LogSearch::Query* query, std::string* errorText) const
+{
+    query->loggerId = getParamValue(params, "--logger-id");
+    if (query->loggerId.empty()) {
+        *errorText = "No logger ID provided";
+        return false;
+    }
+    query->from = 0;
+    query->to = 0;
+    if (hasParam(params, "--from") && (query->from = Utils::parseTime(getParamValue(params, "--from"))) == 0) {
+        *errorText = "Invalid --from, expected epoch seconds or YYYY-MM-DDTHH:MM[:SS]";
+        return false;
+    }
+    if (hasParam(params, "--to") && (query->to = Utils::parseTime(getParamValue(params, "--to"))) == 0) {
+        *errorText = "Invalid --to, expected epoch seconds or YYYY-MM-DDTHH:MM[:SS]";
+        return false;
+    }
+    std::string level;
+    std::istringstream levels(getParamValue(params, "--levels"));
+    while (std::getline(levels, level, ',')) {
+        if (!level.empty()) {
+            query->levels.insert(Utils::toLower(level));
+        }
+    }
+    query->maxResults = 0;
+    const std::string max = getParamValue(params, "--max");
+    if (!max.empty()) {
+        if (max.find_first_not_of("0123456789") != std::string::npos || max.size() > 9) {
+            *errorText = "Invalid --max";
+            return false;
+        }
+        query->maxResults = static_cast<std::size_t>(std::stoul(max));
+    }
+    query->isRegex = hasParam(params, "--regex");
+    query->isWord = hasParam(params, "--word");
+    // text is last so it can have spaces
+    auto textPos = std::find(params.begin(), params.end(), "--text");
+    if (textPos != params.end()) {
+        for (auto iter = std::next(textPos); iter != params.end(); ++iter) {
+            if (!query->text.empty()) {
+                query->text.append(" ");
+            }
+            query->text.append(*iter);
+        }
+    }
+    return true;
+}
+
+std::string Search::formatSummary(const LogSearch::Summary& summary)
+{
+    std::stringstream ss;
+    ss << "Matches: " << summary.matches << (summary.truncated ? " (limit reached)" : "")
+       << ", Scanned: " << (summary.chunks - summary.skippedChunks) << " chunk(s), " << Utils::bytesToHumanReadable(static_cast<long>(summary.bytesScanned))
+       << " in " << summary.elapsedMs << "ms";
+    if (summary.skippedChunks > 0) {
+        ss << ", Skipped: " << summary.skippedChunks << " chunk(s) by bloom filter";
+    }
+    if (summary.failedChunks > 0) {
+        ss << ", Failed: " << summary.failedChunks << " chunk(s)";
+    }
+    if (summary.unindexedArchives > 0) {
+        ss << ", Not searched: " << summary.unindexedArchives << " archive(s) without index";
+    }
+    return ss.str();
+}
+
+void Search::execute(std::vector<std::string>&& params, std::ostringstream& result, bool) const
+{
+    if (registry()->logSearch() == nullptr) {
+        result << "Search is not available\n";
+        return;
+    }
+    LogSearch::Query query;
+    std::string errorText;
+    if (!buildQuery(params, &query, &errorText)) {
+        result << errorText << "\n";
+        return;
+    }
+    LogSearch::Summary summary;
+    if (!registry()->logSearch()->run(query, [&](const std::string& matches) {
+                                          result << matches;
+                                          return true;
+                                      }, &summary, &errorText)) {
+        result << errorText << "\n";
+        return;
+    }
+    result << formatSummary(summary) << "\n";
+}
@@ -0,0 +1,54 @@
+//
+//  search.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef Search_h
+#define Search_h
+
+#include "cli/command.h"
+#include "logging/log-search.h"
+
+namespace residue {
+
+class Registry;
+
+///
+/// \brief Search command to find lines in live and archived logs of a logger
+///
+class Search final : public Command
+{
+public:
+    explicit Search(Registry* registry);
+
+    virtual void execute(std::vector<std::string>&&, std::ostringstream&, bool) const override;
+
+    ///
+    /// \brief Last line of search result
+    ///
+    static std::string formatSummary(const LogSearch::Summary& summary);
+
+private:
+    ///
+    /// \brief Builds query from command params
+    /// \return False if params are invalid (with reason in errorText)
+    ///
+    bool buildQuery(const std::vector<std::string>& params, LogSearch::Query* query, std::string* errorText) const;
+};
+}
+
+#endif /* Search_h */
@@ -19,12 +19,15 @@
 
 #include "cli/stats.h"
 
+#include <algorithm>
 #include <iomanip>
 
 #include "core/client.h"
 #include "core/registry.h"
+#include "logging/live-tail.h"
 #include "logging/log-request-handler.h"
 #include "logging/residue-log-dispatcher.h"
+#include "net/udp-server.h"
 #include "utils/utils.h"
 
 using namespace residue;
@@ -32,7 +35,7 @@ using namespace residue;
 Stats::Stats(Registry* registry) :
     Command("stats",
             "Displays current session details e.g, active sessions, queue and buffer info etc",
-            "stats [list] [dyn] [queue] [--client-id <client_id>]",
+            "stats [list] [dyn] [queue] [udp] [tail] [--client-id <client_id>]",
             registry)
 {
 }
@@ -51,7 +54,11 @@ void Stats::execute(std::vector<std::string>&& params, std::ostringstream& resul
         std::ostringstream tmpR;
         std::size_t i = 1;
         auto now = Utils::now();
-        for (auto& activeSession : registry()->activeSessions()) {
+        std::vector<Registry::ActiveSession> activeSessions = registry()->activeSessions();
+        std::sort(activeSessions.begin(), activeSessions.end(), [](const Registry::ActiveSession& a, const Registry::ActiveSession& b) {
+            return a.session->serial() < b.session->serial();
+        });
+        for (auto& activeSession : activeSessions) {
             if (!clientId.empty()) {
                 if (activeSession.session->client() == nullptr
                         || activeSession.session->client()->id() != clientId) {
@@ -65,13 +72,16 @@ void Stats::execute(std::vector<std::string>&& params, std::ostringstream& resul
             tmpR << ", Active for " << (now - activeSession.timeCreated) << "s"
                    << ", Sent: " << activeSession.session->bytesSent() << "b"
                    << ", Recv: " << activeSession.session->bytesReceived() << "b";
+            if (activeSession.session->readPaused()) {
+                tmpR << ", Paused (queue full)";
+            }
             tmpR << std::endl;
         }
         result << "Active sessions";
         if (!clientId.empty()) {
             result << " by [" << clientId << "]: " << (i - 1) << std::endl;
         } else {
-            result << ": " << registry()->activeSessions().size() << std::endl;
+            result << ": " << (i - 1) << std::endl;
         }
         result << tmpR.str();
     } else if (hasParam(params, "dyn")) {
@@ -91,6 +101,32 @@ void Stats::execute(std::vector<std::string>&& params, std::ostringstream& resul
         } else {
             result << "Could not extract dispatcher";
         }
+    } else if (hasParam(params, "tail")) {
+        if (registry()->liveTail() == nullptr || !registry()->liveTail()->hasSubscribers()) {
+            result << "No live tail subscribers";
+        } else {
+            for (const auto& subscriber : registry()->liveTail()->subscribers()) {
+                result << "Logger: " << subscriber.loggerId << "\t";
+                result << "Session: " << subscriber.sessionId << "\t";
+                if (!subscriber.levels.empty()) {
+                    result << "Levels: " << subscriber.levels << "\t";
+                }
+                if (!subscriber.clientId.empty()) {
+                    result << "Client: " << subscriber.clientId << "\t";
+                }
+                result << "Buffered: " << subscriber.buffered << "\t";
+                result << "Sent: " << subscriber.sent << "\t";
+                result << "Dropped: " << subscriber.dropped << "\n";
+            }
+        }
+    } else if (hasParam(params, "udp")) {
+        if (registry()->udpServer() == nullptr) {
+            result << "UDP listener is not enabled";
+        } else {
+            result << "Datagrams received: " << registry()->udpServer()->received()
+                   << ", Dropped: " << registry()->udpServer()->dropped()
+                   << ", Malformed: " << registry()->udpServer()->malformed();
+        }
     } else if (hasParam(params, "queue")) {
         auto displayQueueStat = [&](const std::string& clientId) {
             auto pos = registry()->logRequestHandler()->m_queueProcessor.find(clientId);
@@ -101,6 +137,7 @@ void Stats::execute(std::vector<std::string>&& params, std::ostringstream& resul
                 result << "Queue For: " << std::setw(20) << std::left << clientId << " ";
                 result << "Active:" << std::setw(6) << std::right << processor->m_queue.size() << " ";
                 result << "Backlog:" << std::setw(6) << std::right << processor->m_queue.backlogSize();
+                result << " Depth:" << std::setw(6) << std::right << processor->m_queue.depth();
                 if (hasParam(params, "sampling")) {
                     std::string sampleCount = getParamValue(params, "sampling");
                     if (sampleCount.empty()) {
@@ -23,6 +23,8 @@
 #include "connect/connection-response.h"
 #include "core/client.h"
 #include "core/configuration.h"
+#include "logging/log-request-handler.h"
+#include "net/shm-ring.h"
 #include "net/session.h"
 #include "utils/utils.h"
 #include "crypto/aes.h"
@@ -93,6 +95,13 @@ void ConnectionRequestHandler::handle(RawRequest&& rawRequest)
         return;
     }
 
+    if (request.type() == ConnectionRequest::Type::CONNECT
+            && request.ackMode() != Client::AckMode::PER_PACKET
+            && !m_registry->configuration()->hasFlag(Configuration::ALLOW_PIPELINED_LOGGING)) {
+        RVLOG(RV_INFO) << "Pipelined logging is not allowed, client will be acknowledged per packet";
+        request.setAckMode(Client::AckMode::PER_PACKET);
+    }
+
     switch (request.type()) {
     case ConnectionRequest::Type::CONNECT:
         connect(&request, session, managedClient);
@@ -103,6 +112,9 @@ void ConnectionRequestHandler::handle(RawRequest&& rawRequest)
     case ConnectionRequest::Type::TOUCH:
         touch(&request, session);
         break;
+    case ConnectionRequest::Type::ATTACH_RING:
+        attachRing(&request, session);
+        break;
     default:
         RLOG(WARNING) << "Invalid connection request type received";
     }
@@ -115,15 +127,31 @@ void ConnectionRequestHandler::connect(ConnectionRequest* request, const std::sh
         // Re-generate a new client ID for this one already exists
         request->setClientId(Utils::generateRandomString(16));
     }
-    if (isManagedClient && m_registry->clientExists(request->clientId())) {
+    std::shared_ptr<Client> client = isManagedClient ? m_registry->findClient(request->clientId()) : nullptr;
+    if (client != nullptr) {
         // Already connected known client, just respond with key
-        Client* client = m_registry->findClient(request->clientId());
-        if (!client->isAlive()) {
-            // reset key
+        const std::string newKey = client->isAlive() ? "" : AES::generateKey(request->keySize());
+        bool keyReset = false;
+        std::shared_ptr<Client> updatedClient = m_registry->updateClient(client->id(), [&](Client* c) {
+            if (!newKey.empty() && !c->isAlive()) {
+                // reset key
+                c->setBackupKey(c->key());
+                c->setKey(newKey);
+                c->setKeySize(request->keySize() / 8);
+                keyReset = true;
+            }
+            // acknowledgement mode is renegotiated with every CONNECT
+            c->setAckMode(request->ackMode());
+            c->setAckEvery(request->ackEvery());
+            c->setAckIntervalMs(request->ackIntervalMs());
+            return true;
+        });
+        if (updatedClient != nullptr) {
+            client = updatedClient;
+        }
+        if (keyReset) {
             RLOG(INFO) << "Client [" << client->id() << "] key reset";
-            client->setBackupKey(client->key());
-            client->setKey(AES::generateKey(request->keySize()));
-            client->setKeySize(request->keySize() / 8);
+            m_registry->scheduleBackupKeyRemoval(client->id());
         }
         // Clone client
         Client clonedClient(request);
@@ -162,7 +190,7 @@ void ConnectionRequestHandler::connect(ConnectionRequest* request, const std::sh
 
 void ConnectionRequestHandler::acknowledge(const ConnectionRequest* request, const std::shared_ptr<Session>& session) const
 {
-    Client* existingClient = m_registry->findClient(request->clientId());
+    std::shared_ptr<Client> existingClient = m_registry->findClient(request->clientId());
     if (existingClient == nullptr) {
         ConnectionResponse response(Response::StatusCode::BAD_REQUEST, "Client with this ID does not exists. Please send CONNECT request first.");
         std::string output;
@@ -178,22 +206,26 @@ void ConnectionRequestHandler::acknowledge(const ConnectionRequest* request, con
     }
     RVLOG(RV_DETAILS) << "Acknowledging client [" << existingClient->id() << "]";
 
-    existingClient->setAcknowledged(true);
-    existingClient->setAge(m_registry->configuration()->clientAge());
-    existingClient->resetDateCreated();
-    if (m_registry->updateClient(*existingClient)) {
-        ConnectionResponse response(existingClient, m_registry->configuration());
+    const unsigned int clientAge = m_registry->configuration()->clientAge();
+    std::shared_ptr<Client> client = m_registry->updateClient(existingClient->id(), [&](Client* c) {
+        c->setAcknowledged(true);
+        c->setAge(clientAge);
+        c->resetDateCreated();
+        return true;
+    });
+    if (client != nullptr) {
+        ConnectionResponse response(client.get(), m_registry->configuration());
         response.setLoggingPort(m_registry->configuration()->loggingPort());
         std::string output;
         response.serialize(output);
-        session->write(output.c_str(), existingClient->key().c_str());
-        session->setClient(existingClient);
+        session->write(output.c_str(), client->key().c_str());
+        session->setClient(client);
     }
 }
 
 void ConnectionRequestHandler::touch(const ConnectionRequest* request, const std::shared_ptr<Session>& session) const
 {
-    Client* client = m_registry->findClient(request->clientId());
+    std::shared_ptr<Client> client = m_registry->findClient(request->clientId());
     if (client != nullptr) {
         RVLOG(RV_DETAILS) << "Touching client [" << client->id() << "]";
         if (!client->acknowledged()) {
@@ -211,10 +243,16 @@ void ConnectionRequestHandler::touch(const ConnectionRequest* request, const std
             response.serialize(output);
             session->write(output.c_str(), client->key().c_str());
         } else {
-            client->setAge(m_registry->configuration()->clientAge());
-            client->resetDateCreated();
-            m_registry->updateClient(*client);
-            ConnectionResponse response(client, m_registry->configuration());
+            const unsigned int clientAge = m_registry->configuration()->clientAge();
+            std::shared_ptr<Client> updatedClient = m_registry->updateClient(client->id(), [&](Client* c) {
+                c->setAge(clientAge);
+                c->resetDateCreated();
+                return true;
+            });
+            if (updatedClient != nullptr) {
+                client = updatedClient;
+            }
+            ConnectionResponse response(client.get(), m_registry->configuration());
             response.setLoggingPort(m_registry->configuration()->loggingPort());
             std::string output;
             response.serialize(output);
@@ -225,3 +263,53 @@ void ConnectionRequestHandler::touch(const ConnectionRequest* request, const std
         session->writeStandardResponse(Response::StatusCode::BAD_REQUEST);
     }
 }
+
+void ConnectionRequestHandler::attachRing(const ConnectionRequest* request, const std::shared_ptr<Session>& session) const
+{
+    std::shared_ptr<Client> client = m_registry->findClient(request->clientId());
+    auto respondErr = [&](const std::string& msg) {
+        RVLOG(RV_ERROR) << msg;
+        ConnectionResponse response(Response::StatusCode::BAD_REQUEST, msg);
+        std::string output;
+        response.serialize(output);
+        if (client != nullptr) {
+            session->write(output.c_str(), client->key().c_str());
+        } else {
+            session->write(output);
+        }
+    };
+    if (client == nullptr || !client->acknowledged() || !client->isAlive()) {
+        client = nullptr;
+        respondErr("Client is not connected. Please CONNECT and ACKNOWLEDGE first");
+        return;
+    }
+    if (!m_registry->configuration()->hasFlag(Configuration::ALLOW_SHM_RING)) {
+        respondErr("Shared memory ring is not allowed by this server");
+        return;
+    }
+    if (request->client() == nullptr || request->client()->id() != client->id()) {
+        // only client itself (encrypted with its key or from local peer trusted
+        // for this client) can attach ring for itself
+        respondErr("ATTACH_RING must be encrypted with client key");
+        return;
+    }
+    if (session->peerUid() < 0) {
+        // segment is checked against peer credentials, that we only have for local sessions
+        respondErr("ATTACH_RING is only accepted over local socket");
+        return;
+    }
+    std::unique_ptr<ShmRing> ring;
+    try {
+        ring = std::unique_ptr<ShmRing>(new ShmRing(request->ringName(), client->id(), session->peerUid()));
+    } catch (const std::exception& e) {
+        respondErr(e.what());
+        return;
+    }
+    RVLOG(RV_DETAILS) << "Attaching ring [" << request->ringName() << "] for client [" << client->id() << "]";
+    m_registry->logRequestHandler()->attachRing(client, std::move(ring));
+    ConnectionResponse response(client.get(), m_registry->configuration());
+    response.setLoggingPort(m_registry->configuration()->loggingPort());
+    std::string output;
+    response.serialize(output);
+    session->write(output.c_str(), client->key().c_str());
+}
@@ -38,6 +38,7 @@ private:
     void connect(ConnectionRequest*, const std::shared_ptr<Session>&, bool isManagedClient) const;
     void acknowledge(const ConnectionRequest*, const std::shared_ptr<Session>&) const;
     void touch(const ConnectionRequest*, const std::shared_ptr<Session>&) const;
+    void attachRing(const ConnectionRequest*, const std::shared_ptr<Session>&) const;
 };
 }
 
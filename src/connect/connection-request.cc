@@ -17,6 +17,8 @@
 //  limitations under the License.
 //
 
+#include <algorithm>
+
 #include "logging/log.h"
 #include "connect/connection-request.h"
 #include "crypto/base64.h"
@@ -24,9 +26,16 @@
 
 using namespace residue;
 
+const unsigned int ConnectionRequest::MAX_ACK_EVERY = 100000;
+const unsigned int ConnectionRequest::MIN_ACK_INTERVAL_MS = 10;
+const unsigned int ConnectionRequest::MAX_ACK_INTERVAL_MS = 60000;
+
 ConnectionRequest::ConnectionRequest(const Configuration* conf) :
     Request(conf),
-    m_type(ConnectionRequest::Type::UNKNOWN)
+    m_type(ConnectionRequest::Type::UNKNOWN),
+    m_ackMode(Client::AckMode::PER_PACKET),
+    m_ackEvery(0),
+    m_ackIntervalMs(0)
 {
 }
 
@@ -38,6 +47,7 @@ bool ConnectionRequest::deserialize(std::string&& json)
         m_clientId = m_jsonDoc.get<std::string>("client_id", "");
         m_rsaPublicKey = Base64::decode(m_jsonDoc.get<std::string>("rsa_public_key", ""));
         m_type = static_cast<ConnectionRequest::Type>(m_jsonDoc.get<unsigned int>("type", 0));
+        m_ringName = m_jsonDoc.get<std::string>("ring_name", "");
         unsigned int keySize = m_jsonDoc.get<unsigned int>("key_size", 0);
 
         if (keySize == 0 || keySize == 128 || keySize == 192 || keySize == 256) {
@@ -46,16 +56,41 @@ bool ConnectionRequest::deserialize(std::string&& json)
             RLOG(ERROR) << "Invalid key size [" << keySize << "]";
             m_isValid = false;
         }
+
+        unsigned int ackMode = m_jsonDoc.get<unsigned int>("ack_mode", 0);
+        if (ackMode > static_cast<unsigned int>(Client::AckMode::CUMULATIVE)) {
+            RLOG(ERROR) << "Invalid acknowledgement mode [" << ackMode << "]";
+            m_isValid = false;
+        } else {
+            m_ackMode = static_cast<Client::AckMode>(ackMode);
+        }
+        if (m_ackMode == Client::AckMode::CUMULATIVE) {
+            m_ackEvery = std::min(m_jsonDoc.get<unsigned int>("ack_every", 0), MAX_ACK_EVERY);
+            m_ackIntervalMs = m_jsonDoc.get<unsigned int>("ack_interval_ms", 0);
+            if (m_ackIntervalMs != 0) {
+                m_ackIntervalMs = std::max(std::min(m_ackIntervalMs, MAX_ACK_INTERVAL_MS), MIN_ACK_INTERVAL_MS);
+            }
+            if (m_ackEvery == 0 && m_ackIntervalMs == 0) {
+                RLOG(ERROR) << "Cumulative acknowledgement requires [ack_every] or [ack_interval_ms]";
+                m_isValid = false;
+            }
+        }
     }
     bool validConnect = (m_type == ConnectionRequest::Type::CONNECT && (!m_rsaPublicKey.empty() || !m_clientId.empty()));
     if (m_type == ConnectionRequest::Type::CONNECT && !validConnect) {
         RLOG(ERROR) << "CONNECT request must have valid public key or client ID";
     }
     bool validSubsequentRequests = (m_type == ConnectionRequest::Type::ACKNOWLEDGE
-                                    || m_type == ConnectionRequest::Type::TOUCH) && !m_clientId.empty();
+                                    || m_type == ConnectionRequest::Type::TOUCH
+                                    || m_type == ConnectionRequest::Type::ATTACH_RING) && !m_clientId.empty();
     if ((m_type == ConnectionRequest::Type::ACKNOWLEDGE
-         || m_type == ConnectionRequest::Type::TOUCH) && m_clientId.empty()) {
-        RLOG(ERROR) << "Valid client ID must be provided with ACKNOWLEDGE or TOUCH requests";
+         || m_type == ConnectionRequest::Type::TOUCH
+         || m_type == ConnectionRequest::Type::ATTACH_RING) && m_clientId.empty()) {
+        RLOG(ERROR) << "Valid client ID must be provided with ACKNOWLEDGE, TOUCH or ATTACH_RING requests";
+    }
+    if (m_type == ConnectionRequest::Type::ATTACH_RING && m_ringName.empty()) {
+        RLOG(ERROR) << "ATTACH_RING request must have ring name";
+        validSubsequentRequests = false;
     }
     m_isValid &= validConnect || validSubsequentRequests;
     return m_isValid;
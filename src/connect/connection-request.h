@@ -21,13 +21,14 @@
 #define ConnectionRequest_h
 
 #include <string>
+#include "core/client.h"
 #include "core/request.h"
 
 namespace residue {
 
 ///
 /// \brief Request entity to connect to the server. This request can be of following types:
-/// Connect, Disconnect, Acknowledge, Touch
+/// Connect, Disconnect, Acknowledge, Touch, Attach ring
 ///
 class ConnectionRequest final : public Request
 {
@@ -38,8 +39,17 @@ public:
         CONNECT = 1,
         ACKNOWLEDGE = 2,
         TOUCH = 3,
+        ATTACH_RING = 4,
     };
 
+    ///
+    /// \brief Limits for cumulative acknowledgement parameters. Values
+    /// outside these are clamped so client cannot hold acknowledgements forever
+    ///
+    static const unsigned int MAX_ACK_EVERY;
+    static const unsigned int MIN_ACK_INTERVAL_MS;
+    static const unsigned int MAX_ACK_INTERVAL_MS;
+
     explicit ConnectionRequest(const Configuration* conf);
 
     inline const std::string& clientId() const
@@ -77,12 +87,41 @@ public:
         return m_keySize;
     }
 
+    inline const std::string& ringName() const
+    {
+        return m_ringName;
+    }
+
+    inline Client::AckMode ackMode() const
+    {
+        return m_ackMode;
+    }
+
+    inline void setAckMode(Client::AckMode ackMode)
+    {
+        m_ackMode = ackMode;
+    }
+
+    inline unsigned int ackEvery() const
+    {
+        return m_ackEvery;
+    }
+
+    inline unsigned int ackIntervalMs() const
+    {
+        return m_ackIntervalMs;
+    }
+
     virtual bool deserialize(std::string&& json) override;
 private:
     std::string m_clientId;
     std::string m_rsaPublicKey;
     unsigned int m_keySize;
     Type m_type;
+    Client::AckMode m_ackMode;
+    unsigned int m_ackEvery;
+    unsigned int m_ackIntervalMs;
+    std::string m_ringName;
 };
 }
 #endif /* ConnectionRequest_h */
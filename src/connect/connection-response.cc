@@ -36,7 +36,10 @@ ConnectionResponse::ConnectionResponse(const Client* client, const Configuration
     m_clientToken(client->token()),
     m_clientAge(client->age()),
     m_clientDateCreated(client->dateCreated()),
-    m_isAcknowledged(client->acknowledged())
+    m_isAcknowledged(client->acknowledged()),
+    m_ackMode(static_cast<unsigned int>(client->ackMode())),
+    m_ackEvery(client->ackEvery()),
+    m_ackIntervalMs(client->ackIntervalMs())
 {
 
 }
@@ -49,7 +52,10 @@ ConnectionResponse::ConnectionResponse(Response::StatusCode status, const std::s
     m_loggingPort(0),
     m_clientAge(0),
     m_clientDateCreated(0),
-    m_isAcknowledged(false)
+    m_isAcknowledged(false),
+    m_ackMode(0),
+    m_ackEvery(0),
+    m_ackIntervalMs(0)
 {
 
 }
@@ -75,6 +81,9 @@ void ConnectionResponse::serialize(std::string& output) const
 
         doc.addValue("flags", static_cast<std::size_t>(m_configuration->flag()))
            .addValue("max_bulk_size", static_cast<std::size_t>(m_configuration->maxItemsInBulk()))
+           .addValue("ack_mode", m_ackMode)
+           .addValue("ack_every", m_ackEvery)
+           .addValue("ack_interval_ms", m_ackIntervalMs)
            .startObject("server_info")
                .addValue("version", ss.str())
            .endObject();
@@ -59,6 +59,9 @@ private:
     unsigned int m_clientAge;
     types::Time m_clientDateCreated;
     bool m_isAcknowledged;
+    unsigned int m_ackMode;
+    unsigned int m_ackEvery;
+    unsigned int m_ackIntervalMs;
 
     friend class ConnectionRequestHandler;
 };
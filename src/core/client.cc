@@ -38,7 +38,11 @@ Client::Client(const ConnectionRequest* request):
     m_age(0),
     m_rsaPublicKey(request->rsaPublicKey()),
     m_keySize(request->keySize() / 8),
-    m_acknowledged(false)
+    m_acknowledged(false),
+    m_isManaged(false),
+    m_ackMode(request->ackMode()),
+    m_ackEvery(request->ackEvery()),
+    m_ackIntervalMs(request->ackIntervalMs())
 {
     m_key = AES::generateKey(request->keySize());
     resetDateCreated();
@@ -36,6 +36,22 @@ class Registry;
 class Client final
 {
 public:
+    ///
+    /// \brief How log requests from this client are acknowledged. This is
+    /// negotiated with CONNECT request
+    ///
+    enum class AckMode : unsigned short
+    {
+        // One standard response for every log packet (default, legacy clients)
+        PER_PACKET = 0,
+
+        // No response for successful log packets (fire-and-forget)
+        NONE = 1,
+
+        // One response with sequence number for every N packets or T milliseconds
+        CUMULATIVE = 2
+    };
+
     explicit Client(const ConnectionRequest* request);
 
     ~Client();
@@ -150,6 +166,36 @@ public:
         m_backupKey = key;
     }
 
+    inline AckMode ackMode() const
+    {
+        return m_ackMode;
+    }
+
+    inline void setAckMode(AckMode ackMode)
+    {
+        m_ackMode = ackMode;
+    }
+
+    inline unsigned int ackEvery() const
+    {
+        return m_ackEvery;
+    }
+
+    inline void setAckEvery(unsigned int ackEvery)
+    {
+        m_ackEvery = ackEvery;
+    }
+
+    inline unsigned int ackIntervalMs() const
+    {
+        return m_ackIntervalMs;
+    }
+
+    inline void setAckIntervalMs(unsigned int ackIntervalMs)
+    {
+        m_ackIntervalMs = ackIntervalMs;
+    }
+
     bool isAlive(const types::Time& compareTo = 0L) const;
 
 private:
@@ -165,6 +211,10 @@ private:
     bool m_acknowledged;
     bool m_isManaged;
 
+    AckMode m_ackMode;
+    unsigned int m_ackEvery;
+    unsigned int m_ackIntervalMs;
+
     // a backup key is previously set key with potentially different key size
     // see https://github.com/abumq/residue/issues/75
     std::string m_backupKey;
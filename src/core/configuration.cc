@@ -28,6 +28,7 @@
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <thread>
 
 #include "core/json-builder.h"
 #include "core/json-doc.h"
@@ -39,12 +40,17 @@
 #include "logging/log-request.h"
 #include "logging/log.h"
 #include "net/http-client.h"
+#include "utils/bloom-filter.h"
 #include "utils/utils.h"
 
 using namespace residue;
 
 const std::string Configuration::UNMANAGED_CLIENT_ID = "unmanaged";
 const int Configuration::MAX_BLACKLIST_LOGGERS = 10000;
+const unsigned long Configuration::MIN_MAX_FILE_SIZE = 1024UL * 1024UL;
+const float Configuration::DEFAULT_BLOOM_FILTER_FP_RATE = 0.01f;
+const unsigned long Configuration::MIN_ARCHIVE_SEGMENT_SIZE = 1024UL * 1024UL;
+const unsigned int Configuration::MIN_ARCHIVE_SEGMENT_INTERVAL = 60;
 
 // taken from Easylogging++ cc file
 static const char* kConfigurationLoggerId                  =      "--";
@@ -85,8 +91,13 @@ void Configuration::loadFromInput(std::string&& jsonStr)
     m_archivedLogsFilenames.clear();
     m_archivedLogCompressedFilename.clear();
     m_rotationFrequencies.clear();
+    m_maxFileSizes.clear();
+    m_archiveRetentions.clear();
+    m_bloomFilterOptions.clear();
     m_loggerFlags.clear();
     m_blacklist.clear();
+    m_trustedSocketUsers.clear();
+    m_trustedSocketUids.clear();
     m_managedClientsEndpoint.clear();
     m_managedClientsKeys.clear();
     m_managedClientsLoggers.clear();
@@ -125,6 +136,7 @@ void Configuration::loadFromInput(std::string&& jsonStr)
     m_adminPort = m_jsonDoc.get<int>("admin_port", 8776);
     m_connectPort = m_jsonDoc.get<int>("connect_port", 8777);
     m_loggingPort = m_jsonDoc.get<int>("logging_port", 8778);
+    m_loggingUdpPort = m_jsonDoc.get<int>("logging_udp_port", 0);
     m_isValid = m_adminPort > 0 && m_connectPort > 0 && m_loggingPort > 0;
 
 
@@ -153,6 +165,12 @@ void Configuration::loadFromInput(std::string&& jsonStr)
     if (m_jsonDoc.get<bool>("immediate_flush", true)) {
         addFlag(Configuration::Flag::IMMEDIATE_FLUSH);
     }
+    if (m_jsonDoc.get<bool>("allow_pipelined_logging", true)) {
+        addFlag(Configuration::Flag::ALLOW_PIPELINED_LOGGING);
+    }
+    if (m_jsonDoc.get<bool>("allow_shm_ring", false)) {
+        addFlag(Configuration::Flag::ALLOW_SHM_RING);
+    }
     if (m_jsonDoc.get<bool>("requires_timestamp", true)) {
         addFlag(Configuration::Flag::REQUIRES_TIMESTAMP);
     } else {
@@ -226,6 +244,9 @@ void Configuration::loadFromInput(std::string&& jsonStr)
             || m_archivedLogCompressedFilename.find("/") != std::string::npos
             || m_archivedLogCompressedFilename.find("\\") != std::string::npos) {
         errorStream << "  Please choose valid default archived_log_compressed_filename" << std::endl;
+    } else if (Utils::compressedArchiveFormat(m_archivedLogCompressedFilename) == Utils::ArchiveFormat::TarZstd
+               && !Utils::isZstdSupported()) {
+        errorStream << "  archived_log_compressed_filename is .tar.zst but residue was built without zstd support" << std::endl;
     }
 
     m_clientAge = m_jsonDoc.get<unsigned int>("client_age", 259200);
@@ -278,6 +299,100 @@ void Configuration::loadFromInput(std::string&& jsonStr)
     if (m_maxItemsInBulk < 5 || m_maxItemsInBulk > 500) {
         errorStream << "  Invalid value for [max_items_in_bulk]. Please choose between 5-500" << std::endl;
     }
+    m_acceptorThreads = m_jsonDoc.get<unsigned int>("acceptor_threads", 1);
+    if (m_acceptorThreads == 0 || m_acceptorThreads > 64) {
+        RLOG(WARNING) << "Invalid value for [acceptor_threads]. Please choose between 1-64. Setting it to default [1]";
+        m_acceptorThreads = 1;
+    }
+    const unsigned int defaultArchiveThreads = std::max(1U, std::thread::hardware_concurrency() / 2);
+    m_archiveThreads = m_jsonDoc.get<unsigned int>("archive_threads", defaultArchiveThreads);
+    if (m_archiveThreads == 0 || m_archiveThreads > 64) {
+        RLOG(WARNING) << "Invalid value for [archive_threads]. Please choose between 1-64. Setting it to default ["
+                      << defaultArchiveThreads << "]";
+        m_archiveThreads = defaultArchiveThreads;
+    }
+    m_archiveNice = m_jsonDoc.get<unsigned int>("archive_nice", 10);
+    if (m_archiveNice > 19) {
+        RLOG(WARNING) << "Invalid value for [archive_nice]. Please choose between 0-19. Setting it to default [10]";
+        m_archiveNice = 10;
+    }
+    m_archiveZstdLevel = m_jsonDoc.get<int>("archive_zstd_level", 3);
+    if (m_archiveZstdLevel < 1 || m_archiveZstdLevel > 19) {
+        RLOG(WARNING) << "Invalid value for [archive_zstd_level]. Please choose between 1-19. Setting it to default [3]";
+        m_archiveZstdLevel = 3;
+    }
+    m_archiveZstdLong = m_jsonDoc.get<bool>("archive_zstd_long", false);
+    unsigned long archiveSegmentSize = m_jsonDoc.get<unsigned long>("archive_segment_size", 0UL);
+    if (archiveSegmentSize > 0 && archiveSegmentSize < MIN_ARCHIVE_SEGMENT_SIZE) {
+        RLOG(WARNING) << "Invalid value for [archive_segment_size]. Minimum is " << MIN_ARCHIVE_SEGMENT_SIZE
+                      << " bytes. Setting it to [" << MIN_ARCHIVE_SEGMENT_SIZE << "]";
+        archiveSegmentSize = MIN_ARCHIVE_SEGMENT_SIZE;
+    }
+    m_archiveSegmentSize = static_cast<std::size_t>(archiveSegmentSize);
+    m_archiveSegmentInterval = m_jsonDoc.get<unsigned int>("archive_segment_interval", 0);
+    if (m_archiveSegmentInterval > 0 && m_archiveSegmentInterval < MIN_ARCHIVE_SEGMENT_INTERVAL) {
+        RLOG(WARNING) << "Invalid value for [archive_segment_interval]. Minimum is " << MIN_ARCHIVE_SEGMENT_INTERVAL
+                      << " seconds. Setting it to [" << MIN_ARCHIVE_SEGMENT_INTERVAL << "]";
+        m_archiveSegmentInterval = MIN_ARCHIVE_SEGMENT_INTERVAL;
+    }
+    m_searchThreads = m_jsonDoc.get<unsigned int>("search_threads", 2);
+    if (m_searchThreads == 0 || m_searchThreads > 64) {
+        RLOG(WARNING) << "Invalid value for [search_threads]. Please choose between 1-64. Setting it to default [2]";
+        m_searchThreads = 2;
+    }
+    m_tailBufferSize = m_jsonDoc.get<unsigned int>("tail_buffer_size", 1000);
+    if (m_tailBufferSize < 10 || m_tailBufferSize > 100000) {
+        RLOG(WARNING) << "Invalid value for [tail_buffer_size]. Please choose between 10-100000. Setting it to default [1000]";
+        m_tailBufferSize = 1000;
+    }
+    m_connectSocket = m_jsonDoc.get<std::string>("connect_socket", "");
+    m_loggingSocket = m_jsonDoc.get<std::string>("logging_socket", "");
+    m_socketMode = m_jsonDoc.get<unsigned int>("socket_mode", static_cast<unsigned int>(S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP));
+    if ((m_socketMode & static_cast<unsigned int>(S_IRUSR | S_IWUSR)) != static_cast<unsigned int>(S_IRUSR | S_IWUSR)) {
+        errorStream << "  Socket mode invalid [" << m_socketMode << "]. User must be able to read and write socket" << std::endl;
+    }
+    JsonDoc jTrustedSocketUsers(m_jsonDoc.getArr("trusted_socket_users"));
+    if (jTrustedSocketUsers.isArray()) {
+        for (const auto& userNode : jTrustedSocketUsers) {
+            JsonDoc j(userNode);
+            std::string user = j.get<std::string>("user", "");
+            if (user.empty()) {
+                errorStream << "  User not provided in trusted_socket_users" << std::endl;
+                continue;
+            }
+            std::unordered_set<std::string> clientIds;
+            JsonDoc jClientIds(j.getArr("client_ids"));
+            if (jClientIds.isArray()) {
+                for (const auto& clientIdNode : jClientIds) {
+                    JsonDoc jClientId(clientIdNode);
+                    std::string clientId = jClientId.as<std::string>("");
+                    if (!clientId.empty()) {
+                        clientIds.insert(clientId);
+                    }
+                }
+            }
+            if (clientIds.empty()) {
+                errorStream << "  No client_ids for trusted socket user [" << user << "]" << std::endl;
+                continue;
+            }
+            struct passwd* userpwd = getpwnam(user.data());
+            if (userpwd == nullptr) {
+                errorStream << "  Trusted socket user does not exist [" << user << "]" << std::endl;
+                endpwent();
+                continue;
+            }
+            m_trustedSocketUids[static_cast<unsigned int>(userpwd->pw_uid)].insert(clientIds.begin(), clientIds.end());
+            endpwent();
+            m_trustedSocketUsers[user].insert(clientIds.begin(), clientIds.end());
+        }
+    }
+    m_maxQueueDepth = m_jsonDoc.get<unsigned int>("max_queue_depth", 0);
+    m_queueResumeDepth = m_jsonDoc.get<unsigned int>("queue_resume_depth", m_maxQueueDepth / 2);
+    if (m_maxQueueDepth > 0 && m_queueResumeDepth >= m_maxQueueDepth) {
+        RLOG(WARNING) << "Invalid value for [queue_resume_depth]. It should be less than [max_queue_depth]. "
+                      << "Setting it to [" << (m_maxQueueDepth / 2) << "]";
+        m_queueResumeDepth = m_maxQueueDepth / 2;
+    }
 
 
     // We load managed loggers before managed clients because
@@ -454,6 +569,42 @@ void Configuration::loadManagedLoggers(const JsonDoc& json, std::stringstream& e
             m_rotationFrequencies.insert(std::make_pair(loggerId, frequency));
         }
 
+        unsigned long maxFileSize = j.get<unsigned long>("max_file_size", 0UL);
+        if (maxFileSize > 0) {
+            if (maxFileSize < MIN_MAX_FILE_SIZE) {
+                RLOG(WARNING) << "Invalid value for [max_file_size] for logger [" << loggerId << "]. Setting it to minimum ["
+                              << MIN_MAX_FILE_SIZE << "]";
+                maxFileSize = MIN_MAX_FILE_SIZE;
+            }
+            m_maxFileSizes.insert(std::make_pair(loggerId, static_cast<std::size_t>(maxFileSize)));
+        }
+
+        ArchiveRetention archiveRetention {
+            static_cast<std::size_t>(j.get<unsigned long>("max_archive_size", 0UL)),
+            static_cast<types::Time>(j.get<unsigned long>("max_archive_age", 0UL)),
+            j.get<unsigned int>("max_archive_count", 0U)
+        };
+        if (archiveRetention.isEnabled()) {
+            m_archiveRetentions.insert(std::make_pair(loggerId, archiveRetention));
+        }
+
+        unsigned long bloomFilterSize = j.get<unsigned long>("bloom_filter_size", 0UL);
+        if (bloomFilterSize > 0) {
+            if (bloomFilterSize < BloomFilter::MIN_SIZE || bloomFilterSize > BloomFilter::MAX_SIZE) {
+                RLOG(WARNING) << "Invalid value for [bloom_filter_size] for logger [" << loggerId << "]. Setting it to ["
+                              << (bloomFilterSize < BloomFilter::MIN_SIZE ? BloomFilter::MIN_SIZE : BloomFilter::MAX_SIZE) << "]";
+                bloomFilterSize = bloomFilterSize < BloomFilter::MIN_SIZE ? BloomFilter::MIN_SIZE : BloomFilter::MAX_SIZE;
+            }
+            float bloomFilterFpRate = j.get<float>("bloom_filter_fp_rate", DEFAULT_BLOOM_FILTER_FP_RATE);
+            if (bloomFilterFpRate <= 0.0f || bloomFilterFpRate > 0.5f) {
+                RLOG(WARNING) << "Invalid value for [bloom_filter_fp_rate] for logger [" << loggerId << "]. Setting it to default ["
+                              << DEFAULT_BLOOM_FILTER_FP_RATE << "]";
+                bloomFilterFpRate = DEFAULT_BLOOM_FILTER_FP_RATE;
+            }
+            m_bloomFilterOptions.insert(std::make_pair(loggerId, BloomFilterOptions { static_cast<std::size_t>(bloomFilterSize),
+                                                                                      bloomFilterFpRate }));
+        }
+
         std::string archivedLogFilename = j.get<std::string>("archived_log_filename", "");
         if (!archivedLogFilename.empty()) {
             m_archivedLogsFilenames.insert(std::make_pair(loggerId, "%logger-" + archivedLogFilename));
@@ -463,6 +614,9 @@ void Configuration::loadManagedLoggers(const JsonDoc& json, std::stringstream& e
         if (!archivedLogCompressedFilename.empty()) {
             if (archivedLogCompressedFilename.find("/") != std::string::npos || archivedLogCompressedFilename.find("\\") != std::string::npos) {
                 errorStream << "  archived_log_compressed_filename contains illegal character (path character). It should be pure filename format." << std::endl;
+            } else if (Utils::compressedArchiveFormat(archivedLogCompressedFilename) == Utils::ArchiveFormat::TarZstd
+                       && !Utils::isZstdSupported()) {
+                errorStream << "  archived_log_compressed_filename for [" << loggerId << "] is .tar.zst but residue was built without zstd support" << std::endl;
             } else {
                 m_archivedLogsCompressedFilenames.insert(std::make_pair(loggerId, archivedLogCompressedFilename));
             }
@@ -883,6 +1037,9 @@ std::string Configuration::exportAsString()
     j.addValue("admin_port", adminPort());
     j.addValue("connect_port", connectPort());
     j.addValue("logging_port", loggingPort());
+    if (loggingUdpPort() > 0) {
+        j.addValue("logging_udp_port", loggingUdpPort());
+    }
     j.addValue("server_key", serverKey());
     if (!m_serverRSAPrivateKeyFile.empty()) {
         j.addValue("server_rsa_private_key", m_serverRSAPrivateKeyFile);
@@ -903,7 +1060,33 @@ std::string Configuration::exportAsString()
     j.addValue("requires_timestamp", hasFlag(Configuration::Flag::REQUIRES_TIMESTAMP));
     j.addValue("compression", hasFlag(Configuration::Flag::COMPRESSION));
     j.addValue("allow_bulk_log_request", hasFlag(Configuration::Flag::ALLOW_BULK_LOG_REQUEST));
+    j.addValue("allow_pipelined_logging", hasFlag(Configuration::Flag::ALLOW_PIPELINED_LOGGING));
+    j.addValue("allow_shm_ring", hasFlag(Configuration::Flag::ALLOW_SHM_RING));
     j.addValue("max_items_in_bulk", maxItemsInBulk());
+    j.addValue("acceptor_threads", acceptorThreads());
+    j.addValue("max_queue_depth", maxQueueDepth());
+    if (!m_connectSocket.empty()) {
+        j.addValue("connect_socket", m_connectSocket);
+    }
+    if (!m_loggingSocket.empty()) {
+        j.addValue("logging_socket", m_loggingSocket);
+    }
+    j.addValue("socket_mode", socketMode());
+    if (!m_trustedSocketUsers.empty()) {
+        j.startArray("trusted_socket_users");
+        for (auto& userPair : m_trustedSocketUsers) {
+            j.startObject();
+            j.addValue("user", userPair.first);
+            j.startArray("client_ids");
+            for (auto& clientId : userPair.second) {
+                j.addValue(clientId);
+            }
+            j.endArray(); // client_ids
+            j.endObject();
+        }
+        j.endArray(); // trusted_socket_users
+    }
+    j.addValue("queue_resume_depth", queueResumeDepth());
     j.addValue("timestamp_validity", timestampValidity());
     j.addValue("client_age", clientAge());
     j.addValue("non_acknowledged_client_age", nonAcknowledgedClientAge());
@@ -912,6 +1095,14 @@ std::string Configuration::exportAsString()
     j.addValue("archived_log_directory", m_archivedLogDirectory);
     j.addValue("archived_log_filename", m_archivedLogFilename);
     j.addValue("archived_log_compressed_filename", m_archivedLogCompressedFilename);
+    j.addValue("archive_threads", archiveThreads());
+    j.addValue("archive_nice", archiveNice());
+    j.addValue("archive_zstd_level", archiveZstdLevel());
+    j.addValue("archive_zstd_long", archiveZstdLong());
+    j.addValue("archive_segment_size", archiveSegmentSize());
+    j.addValue("archive_segment_interval", archiveSegmentInterval());
+    j.addValue("search_threads", searchThreads());
+    j.addValue("tail_buffer_size", tailBufferSize());
 /*
     if (!m_logExtensions.empty()) {
         j.startObject("extensions");
@@ -1007,6 +1198,28 @@ std::string Configuration::exportAsString()
             j.addValue("rotation_freq", frequencyStr);
         }
 
+        if (m_maxFileSizes.find(loggerId) != m_maxFileSizes.end()) {
+            j.addValue("max_file_size", m_maxFileSizes.at(loggerId));
+        }
+
+        if (m_archiveRetentions.find(loggerId) != m_archiveRetentions.end()) {
+            const ArchiveRetention& archiveRetention = m_archiveRetentions.at(loggerId);
+            if (archiveRetention.maxSize > 0) {
+                j.addValue("max_archive_size", archiveRetention.maxSize);
+            }
+            if (archiveRetention.maxAge > 0) {
+                j.addValue("max_archive_age", static_cast<std::size_t>(archiveRetention.maxAge));
+            }
+            if (archiveRetention.maxCount > 0) {
+                j.addValue("max_archive_count", archiveRetention.maxCount);
+            }
+        }
+
+        if (m_bloomFilterOptions.find(loggerId) != m_bloomFilterOptions.end()) {
+            j.addValue("bloom_filter_size", m_bloomFilterOptions.at(loggerId).size);
+            j.addValue("bloom_filter_fp_rate", static_cast<double>(m_bloomFilterOptions.at(loggerId).falsePositiveRate));
+        }
+
         if (m_archivedLogsFilenames.find(loggerId) != m_archivedLogsFilenames.end()) {
             j.addValue("archived_log_filename", m_archivedLogsFilenames.at(loggerId).substr(std::string("%logger-").size()));
         }
@@ -58,6 +58,8 @@ public:
         ENABLE_CLI = 512,
         REQUIRES_TIMESTAMP = 1024,
         ENABLE_DYNAMIC_BUFFER = 2048,
+        ALLOW_PIPELINED_LOGGING = 4096,
+        ALLOW_SHM_RING = 8192,
     };
 
     enum RotationFrequency : types::Time
@@ -82,6 +84,43 @@ public:
     ///
     static const int MAX_BLACKLIST_LOGGERS;
 
+    ///
+    /// \brief Smallest max_file_size allowed for a logger (1MB)
+    ///
+    static const unsigned long MIN_MAX_FILE_SIZE;
+
+    ///
+    /// \brief Smallest archive_segment_size (1MB) and archive_segment_interval (1 minute) allowed
+    ///
+    static const unsigned long MIN_ARCHIVE_SEGMENT_SIZE;
+    static const unsigned int MIN_ARCHIVE_SEGMENT_INTERVAL;
+
+    ///
+    /// \brief Budgets for archives of a logger, 0 means no limit
+    ///
+    struct ArchiveRetention
+    {
+        std::size_t maxSize;
+        types::Time maxAge;
+        unsigned int maxCount;
+
+        inline bool isEnabled() const
+        {
+            return maxSize > 0 || maxAge > 0 || maxCount > 0;
+        }
+    };
+
+    ///
+    /// \brief Token bloom filter kept for each segment (and archive) of a logger, size 0 means disabled
+    ///
+    struct BloomFilterOptions
+    {
+        std::size_t size;
+        float falsePositiveRate;
+    };
+
+    static const float DEFAULT_BLOOM_FILTER_FP_RATE;
+
     Configuration();
     explicit Configuration(const std::string& configurationFile);
 
@@ -164,6 +203,95 @@ public:
         return m_maxItemsInBulk;
     }
 
+    inline int loggingUdpPort() const
+    {
+        return m_loggingUdpPort;
+    }
+
+    inline const std::string& connectSocket() const
+    {
+        return m_connectSocket;
+    }
+
+    inline const std::string& loggingSocket() const
+    {
+        return m_loggingSocket;
+    }
+
+    inline unsigned int socketMode() const
+    {
+        return m_socketMode;
+    }
+
+    inline bool isTrustedSocketUser(unsigned int uid) const
+    {
+        return m_trustedSocketUids.find(uid) != m_trustedSocketUids.end();
+    }
+
+    ///
+    /// \brief Whether peer with this uid may identify itself as this client on trusted session
+    ///
+    inline bool isTrustedSocketClient(unsigned int uid, const std::string& clientId) const
+    {
+        const auto& iter = m_trustedSocketUids.find(uid);
+        return iter != m_trustedSocketUids.end() && iter->second.find(clientId) != iter->second.end();
+    }
+
+    inline unsigned int acceptorThreads() const
+    {
+        return m_acceptorThreads;
+    }
+
+    inline unsigned int archiveThreads() const
+    {
+        return m_archiveThreads;
+    }
+
+    inline unsigned int archiveNice() const
+    {
+        return m_archiveNice;
+    }
+
+    inline int archiveZstdLevel() const
+    {
+        return m_archiveZstdLevel;
+    }
+
+    inline bool archiveZstdLong() const
+    {
+        return m_archiveZstdLong;
+    }
+
+    inline std::size_t archiveSegmentSize() const
+    {
+        return m_archiveSegmentSize;
+    }
+
+    inline unsigned int archiveSegmentInterval() const
+    {
+        return m_archiveSegmentInterval;
+    }
+
+    inline unsigned int searchThreads() const
+    {
+        return m_searchThreads;
+    }
+
+    inline unsigned int tailBufferSize() const
+    {
+        return m_tailBufferSize;
+    }
+
+    inline unsigned int maxQueueDepth() const
+    {
+        return m_maxQueueDepth;
+    }
+
+    inline unsigned int queueResumeDepth() const
+    {
+        return m_queueResumeDepth;
+    }
+
     inline unsigned int nonAcknowledgedClientAge() const
     {
         return m_nonAcknowledgedClientAge;
@@ -280,6 +408,46 @@ public:
     std::string getArchivedLogCompressedFilename(const std::string&) const;
     RotationFrequency getRotationFrequency(const std::string&) const;
 
+    inline const std::unordered_map<std::string, std::size_t>& maxFileSizes() const
+    {
+        return m_maxFileSizes;
+    }
+
+    inline const std::unordered_map<std::string, ArchiveRetention>& archiveRetentions() const
+    {
+        return m_archiveRetentions;
+    }
+
+    inline ArchiveRetention getArchiveRetention(const std::string& loggerId) const
+    {
+        auto iter = m_archiveRetentions.find(loggerId);
+        return iter == m_archiveRetentions.end() ? ArchiveRetention { 0, 0, 0 } : iter->second;
+    }
+
+    inline const std::unordered_map<std::string, BloomFilterOptions>& bloomFilterOptions() const
+    {
+        return m_bloomFilterOptions;
+    }
+
+    inline BloomFilterOptions getBloomFilterOptions(const std::string& loggerId) const
+    {
+        auto iter = m_bloomFilterOptions.find(loggerId);
+        return iter == m_bloomFilterOptions.end() ? BloomFilterOptions { 0, DEFAULT_BLOOM_FILTER_FP_RATE } : iter->second;
+    }
+
+    ///
+    /// \brief Size (in bytes) after which logger is rotated regardless of its rotation frequency.
+    /// This is checked on every write so it is kept cheap. 0 means no limit
+    ///
+    inline std::size_t getMaxFileSize(const std::string& loggerId) const
+    {
+        if (m_maxFileSizes.empty()) {
+            return 0;
+        }
+        auto iter = m_maxFileSizes.find(loggerId);
+        return iter == m_maxFileSizes.end() ? 0 : iter->second;
+    }
+
     bool hasLoggerFlag(const std::string& loggerId, Flag flag) const;
 
     inline std::string managedLoggersEndpoint() const
@@ -319,6 +487,9 @@ private:
     std::unordered_map<std::string, std::string> m_archivedLogsFilenames;
     std::unordered_map<std::string, std::string> m_archivedLogsCompressedFilenames;
     std::unordered_map<std::string, RotationFrequency> m_rotationFrequencies;
+    std::unordered_map<std::string, std::size_t> m_maxFileSizes;
+    std::unordered_map<std::string, ArchiveRetention> m_archiveRetentions;
+    std::unordered_map<std::string, BloomFilterOptions> m_bloomFilterOptions;
     std::unordered_map<std::string, Flag> m_loggerFlags;
     std::unordered_map<std::string, unsigned int> m_keySizes;
     std::unordered_set<std::string> m_blacklist;
@@ -341,6 +512,24 @@ private:
     unsigned int m_dispatchDelay;
     unsigned int m_clientIntegrityTaskInterval;
     unsigned int m_maxItemsInBulk;
+    unsigned int m_maxQueueDepth;
+    unsigned int m_acceptorThreads;
+    unsigned int m_archiveThreads;
+    unsigned int m_archiveNice;
+    int m_archiveZstdLevel;
+    bool m_archiveZstdLong;
+    std::size_t m_archiveSegmentSize;
+    unsigned int m_archiveSegmentInterval;
+    unsigned int m_searchThreads;
+    unsigned int m_tailBufferSize;
+    int m_loggingUdpPort;
+    std::string m_connectSocket;
+    std::string m_loggingSocket;
+    unsigned int m_socketMode;
+    // user -> client IDs and uid -> client IDs
+    std::unordered_map<std::string, std::unordered_set<std::string>> m_trustedSocketUsers;
+    std::unordered_map<unsigned int, std::unordered_set<std::string>> m_trustedSocketUids;
+    unsigned int m_queueResumeDepth;
     unsigned int m_defaultKeySize;
     unsigned int m_fileMode;
 
@@ -25,103 +25,226 @@
 #include "core/configuration.h"
 #include "logging/log.h"
 #include "logging/log-request-handler.h"
+#include "logging/residue-log-dispatcher.h"
+#include "tasks/client-integrity-task.h"
+#include "tasks/task-scheduler.h"
 #include "utils/utils.h"
 
 using namespace residue;
 
 Registry::Registry(Configuration* configuration) :
     m_configuration(configuration),
+    m_logSegmenter(nullptr),
+    m_archiveRetention(nullptr),
+    m_logSearch(nullptr),
+    m_liveTail(nullptr),
     m_clientIntegrityTask(nullptr),
     m_logRequestHandler(nullptr),
     m_autoUpdater(nullptr),
-    m_bytesSent("0"),
-    m_bytesReceived("0")
+    m_udpServer(nullptr),
+    m_taskScheduler(nullptr),
+    m_clientCount(0),
+    m_activeSessionCount(0)
 {
 }
 
 bool Registry::addClient(const Client& client)
 {
     DRVLOG(RV_DEBUG) << "Attempting to add client @" << this;
-    std::lock_guard<std::recursive_mutex> lock(m_mutex);
-    if (clientExists(client.id())) {
-        return false;
+    std::shared_ptr<Client> newClient;
+    {
+        ClientShard& shard = clientShard(client.id());
+        std::lock_guard<std::mutex> lock_(shard.mutex);
+        if (shard.clients.find(client.id()) != shard.clients.end()) {
+            return false;
+        }
+        DRVLOG(RV_DEBUG) << "Adding client @" << this;
+        newClient = std::make_shared<Client>(client);
+        shard.clients.insert(std::make_pair(client.id(), newClient));
+        m_clientCount.fetch_add(1, std::memory_order_relaxed);
     }
-    DRVLOG(RV_DEBUG) << "Adding client @" << this;
-    m_clients.insert(std::make_pair(client.id(), client));
+    // outside shard lock as schedule may need to lock all the shards
+    scheduleExpiry(newClient);
     return true;
 }
 
-bool Registry::updateClient(const Client& client)
+std::shared_ptr<Client> Registry::findClient(const std::string& clientId)
 {
-    DRVLOG(RV_DEBUG) << "Attempting to update client @" << this;
-    std::lock_guard<std::recursive_mutex> lock(m_mutex);
-    const auto& it = m_clients.find(client.id());
-    if (it == m_clients.end()) {
-        return false;
-    }
-    DRVLOG(RV_DEBUG) << "Updating client @" << this;
-    Client* existingClient = &(it->second);
-    existingClient->setKey(client.key());
-    existingClient->setAge(client.age());
-    existingClient->setDateCreated(client.dateCreated());
-    existingClient->setKeySize(client.keySize());
-    existingClient->setAcknowledged(client.acknowledged());
-    existingClient->setRsaPublicKey(client.rsaPublicKey());
+    ClientShard& shard = clientShard(clientId);
+    std::lock_guard<std::mutex> lock_(shard.mutex);
+    const auto& iter = shard.clients.find(clientId);
+    if (iter == shard.clients.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+bool Registry::removeClient(const std::string& clientId)
+{
+    DRVLOG(RV_DEBUG) << "Removing client @" << this;
+    {
+        ClientShard& shard = clientShard(clientId);
+        std::lock_guard<std::mutex> lock_(shard.mutex);
+        if (shard.clients.erase(clientId) == 0) {
+            return false;
+        }
+        m_clientCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    clientRemoved(clientId);
     return true;
 }
 
-Client* Registry::findClient(const std::string& clientId)
+void Registry::clientRemoved(const std::string& clientId)
 {
-    const auto& iter = m_clients.find(clientId);
-    if (iter == m_clients.end()) {
-        return nullptr;
+    if (m_logRequestHandler != nullptr) {
+        m_logRequestHandler->detachRings(clientId);
     }
-    return &iter->second;
 }
 
-void Registry::removeClient(Client* client)
+std::vector<std::shared_ptr<Client>> Registry::clients()
 {
-    DRVLOG(RV_DEBUG) << "Removing client @" << this;
-    std::lock_guard<std::recursive_mutex> lock(m_mutex);
-    if (client != nullptr) {
-        m_clients.erase(client->id());
+    std::vector<std::shared_ptr<Client>> snapshot;
+    snapshot.reserve(clientCount());
+    for (auto& shard : m_clientShards) {
+        std::lock_guard<std::mutex> lock_(shard.mutex);
+        for (const auto& pair : shard.clients) {
+            snapshot.push_back(pair.second);
+        }
+    }
+    return snapshot;
+}
+
+void Registry::scheduleExpiry(const std::shared_ptr<Client>& client)
+{
+    if (client->age() == 0) {
+        // lives forever
+        return;
+    }
+    std::lock_guard<std::mutex> lock_(m_expiryMutex);
+    if (m_clientExpiries.size() > 1024 && m_clientExpiries.size() > clientCount() * 4) {
+        // too many outdated entries (frequently touched clients), rebuild with current expiries
+        std::vector<ClientExpiry> current;
+        current.reserve(clientCount());
+        for (auto& shard : m_clientShards) {
+            std::lock_guard<std::mutex> shardLock(shard.mutex);
+            for (const auto& pair : shard.clients) {
+                if (pair.second->age() > 0 && pair.second != client) {
+                    current.push_back({ pair.second->dateCreated() + pair.second->age(), pair.second });
+                }
+            }
+        }
+        m_clientExpiries = decltype(m_clientExpiries)(std::greater<ClientExpiry>(), std::move(current));
+    }
+    m_clientExpiries.push({ client->dateCreated() + client->age(), client });
+}
+
+std::vector<std::shared_ptr<Client>> Registry::expiredClients(types::Time now)
+{
+    std::vector<std::shared_ptr<Client>> result;
+    std::lock_guard<std::mutex> lock_(m_expiryMutex);
+    while (!m_clientExpiries.empty() && m_clientExpiries.top().expiry < now) {
+        std::shared_ptr<Client> client = m_clientExpiries.top().client.lock();
+        types::Time expiry = m_clientExpiries.top().expiry;
+        m_clientExpiries.pop();
+        if (client == nullptr || client->age() == 0 || client->dateCreated() + client->age() != expiry) {
+            // already removed or touched since (newer entry exists)
+            continue;
+        }
+        result.push_back(client);
     }
+    return result;
+}
+
+void Registry::scheduleBackupKeyRemoval(const std::string& clientId)
+{
+    std::lock_guard<std::mutex> lock_(m_expiryMutex);
+    m_backupKeyClients.push_back(clientId);
+}
+
+std::vector<std::string> Registry::clientsWithBackupKey()
+{
+    std::vector<std::string> result;
+    std::lock_guard<std::mutex> lock_(m_expiryMutex);
+    result.swap(m_backupKeyClients);
+    return result;
 }
 
 void Registry::join(const std::shared_ptr<Session>& session)
 {
-    std::lock_guard<std::recursive_mutex> lock_(m_sessMutex);
-    m_activeSessions.push_back({session, Utils::now()});
+    SessionShard& shard = m_sessionShards[session->serial() % SESSION_SHARDS];
+    std::lock_guard<std::mutex> lock_(shard.mutex);
+    if (shard.sessions.insert(std::make_pair(session->serial(), ActiveSession { session, Utils::now() })).second) {
+        m_activeSessionCount.fetch_add(1, std::memory_order_relaxed);
+    }
 }
 
 void Registry::leave(const std::shared_ptr<Session>& session)
 {
-    std::lock_guard<std::recursive_mutex> lock_(m_sessMutex);
-    auto pos = std::find_if(m_activeSessions.begin(), m_activeSessions.end(),
-                            [&](const ActiveSession& activeSession) {
-        return activeSession.session->id() == session->id();
-    });
-    if (pos != m_activeSessions.end()) {
-        m_activeSessions.erase(pos);
+    SessionShard& shard = m_sessionShards[session->serial() % SESSION_SHARDS];
+    std::lock_guard<std::mutex> lock_(shard.mutex);
+    if (shard.sessions.erase(session->serial()) > 0) {
+        m_activeSessionCount.fetch_sub(1, std::memory_order_relaxed);
     }
 }
 
+std::vector<Registry::ActiveSession> Registry::activeSessions()
+{
+    std::vector<ActiveSession> snapshot;
+    snapshot.reserve(activeSessionCount());
+    for (auto& shard : m_sessionShards) {
+        std::lock_guard<std::mutex> lock_(shard.mutex);
+        for (const auto& pair : shard.sessions) {
+            snapshot.push_back(pair.second);
+        }
+    }
+    return snapshot;
+}
+
 void Registry::reset()
 {
     std::lock_guard<std::recursive_mutex> lock(m_mutex);
-    std::lock_guard<std::recursive_mutex> lockSess(m_sessMutex);
     RLOG(INFO) << "Reloading configurations...";
     reloadConfig();
     RLOG(INFO) << "Resetting clients...";
-    m_clients.clear();
+    std::vector<std::string> removedClients;
+    for (auto& shard : m_clientShards) {
+        std::lock_guard<std::mutex> lock_(shard.mutex);
+        for (const auto& pair : shard.clients) {
+            removedClients.push_back(pair.first);
+        }
+        shard.clients.clear();
+    }
+    m_clientCount = 0;
+    for (const std::string& clientId : removedClients) {
+        clientRemoved(clientId);
+    }
+    {
+        std::lock_guard<std::mutex> lock_(m_expiryMutex);
+        m_clientExpiries = decltype(m_clientExpiries)();
+        m_backupKeyClients.clear();
+    }
     RLOG(INFO) << "Resetting sessions...";
-    m_activeSessions.clear();
-    m_bytesReceived = "0";
-    m_bytesSent = "0";
+    for (auto& shard : m_sessionShards) {
+        std::lock_guard<std::mutex> lock_(shard.mutex);
+        shard.sessions.clear();
+    }
+    m_activeSessionCount = 0;
+    m_bytesReceived.reset();
+    m_bytesSent.reset();
 }
 
 void Registry::reloadConfig()
 {
     m_configuration->reload();
     m_logRequestHandler->addMissingClientProcessors();
+    ResidueLogDispatcher* dispatcher = el::Helpers::logDispatchCallback<ResidueLogDispatcher>("ResidueLogDispatcher");
+    if (dispatcher != nullptr) {
+        // bloom filter options of loggers may have changed
+        dispatcher->invalidateBloomFilters();
+    }
+    if (m_taskScheduler != nullptr && m_clientIntegrityTask != nullptr) {
+        // interval may have changed, reschedule straight away rather than after old interval
+        m_clientIntegrityTask->setInterval(m_configuration->clientIntegrityTaskInterval());
+        m_taskScheduler->schedule(m_clientIntegrityTask);
+    }
 }
@@ -20,7 +20,12 @@
 #ifndef Registry_h
 #define Registry_h
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <queue>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -29,15 +34,22 @@
 #include "core/client.h"
 #include "net/session.h"
 #include "non-copyable.h"
+#include "utils/sharded-counter.h"
 #include "utils/utils.h"
 
 namespace residue {
 
 class Configuration;
 class ClientIntegrityTask;
+class ArchiveRetention;
 class AutoUpdater;
 class LogRotator;
+class LogSegmenter;
 class LogRequestHandler;
+class LogSearch;
+class LiveTail;
+class TaskScheduler;
+class UdpServer;
 
 ///
 /// \brief Registry for client with helper functions
@@ -55,52 +67,135 @@ public:
     explicit Registry(Configuration* configuration);
 
     bool addClient(const Client& client);
-    bool updateClient(const Client& client);
-    Client* findClient(const std::string& clientId);
-    void removeClient(Client* client);
+
+    ///
+    /// \brief Publishes updated copy of the client. Clients in registry are never modified
+    /// in place as they are read by other threads without any lock, instead modifier is
+    /// applied to a copy of current client while its shard is locked (so concurrent updates
+    /// are not lost) and the copy replaces it
+    /// \param modifier Called with the copy, returns false to keep current client as is
+    /// \return Updated client or nullptr if client does not exist or was not updated
+    ///
+    template <typename Modifier>
+    std::shared_ptr<Client> updateClient(const std::string& clientId, Modifier modifier)
+    {
+        std::shared_ptr<Client> updatedClient;
+        {
+            ClientShard& shard = clientShard(clientId);
+            std::lock_guard<std::mutex> lock_(shard.mutex);
+            auto iter = shard.clients.find(clientId);
+            if (iter == shard.clients.end()) {
+                return nullptr;
+            }
+            updatedClient = std::make_shared<Client>(*iter->second);
+            if (!modifier(updatedClient.get())) {
+                return nullptr;
+            }
+            iter->second = updatedClient;
+        }
+        // outside shard lock as schedule may need to lock all the shards
+        scheduleExpiry(updatedClient);
+        return updatedClient;
+    }
+
+    ///
+    /// \brief Finds client by ID. Returned handle keeps client alive even if it is
+    /// removed from registry (e.g, expired) while caller is still using it
+    ///
+    std::shared_ptr<Client> findClient(const std::string& clientId);
+
+    bool removeClient(const std::string& clientId);
+
+    ///
+    /// \brief Removes client only if it is still the same object and predicate holds
+    /// while its shard is locked
+    ///
+    template <typename Predicate>
+    bool removeClientIf(const std::shared_ptr<Client>& client, Predicate pred)
+    {
+        {
+            ClientShard& shard = clientShard(client->id());
+            std::lock_guard<std::mutex> lock_(shard.mutex);
+            auto iter = shard.clients.find(client->id());
+            if (iter == shard.clients.end() || iter->second != client || !pred(client.get())) {
+                return false;
+            }
+            shard.clients.erase(iter);
+            m_clientCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+        clientRemoved(client->id());
+        return true;
+    }
 
     inline Configuration* configuration() const
     {
         return m_configuration;
     }
 
-    inline std::unordered_map<std::string, Client>& clients()
+    ///
+    /// \brief Snapshot of all the clients, see activeSessions()
+    ///
+    std::vector<std::shared_ptr<Client>> clients();
+
+    inline std::size_t clientCount() const
     {
-        return m_clients;
+        return m_clientCount.load(std::memory_order_relaxed);
     }
 
-    inline std::vector<ActiveSession>& activeSessions()
+    ///
+    /// \brief Clients that have expired by specified time. This is only as much work as
+    /// number of expired clients (plus outdated schedules), it does not scan the registry
+    ///
+    std::vector<std::shared_ptr<Client>> expiredClients(types::Time now);
+
+    ///
+    /// \brief Backup key for this client will be removed on next client integrity run
+    ///
+    void scheduleBackupKeyRemoval(const std::string& clientId);
+
+    ///
+    /// \brief IDs of clients that have backup key scheduled for removal, this clears the schedule
+    ///
+    std::vector<std::string> clientsWithBackupKey();
+
+    ///
+    /// \brief Snapshot of active sessions. Shards are locked one at a time only while
+    /// copying so caller can iterate (and take as long as it wants) without holding any lock
+    ///
+    std::vector<ActiveSession> activeSessions();
+
+    inline std::size_t activeSessionCount() const
     {
-        return m_activeSessions;
+        return m_activeSessionCount.load(std::memory_order_relaxed);
     }
 
-    inline bool clientExists(const std::string& clientId) const
+    inline bool clientExists(const std::string& clientId)
     {
-        return m_clients.find(clientId) != m_clients.end();
+        return findClient(clientId) != nullptr;
     }
 
     void join(const std::shared_ptr<Session>& session);
 
     void leave(const std::shared_ptr<Session>& session);
 
-    inline const std::string& bytesReceived() const
+    inline std::uint64_t bytesReceived() const
     {
-        return m_bytesReceived;
+        return m_bytesReceived.value();
     }
 
-    inline const std::string& bytesSent() const
+    inline std::uint64_t bytesSent() const
     {
-        return m_bytesSent;
+        return m_bytesSent.value();
     }
 
-    inline void addBytesReceived(const std::size_t& v)
+    inline void addBytesReceived(std::size_t v)
     {
-        Utils::bigAdd(m_bytesReceived, std::to_string(v));
+        m_bytesReceived.add(v);
     }
 
-    inline void addBytesSent(const std::size_t& v)
+    inline void addBytesSent(std::size_t v)
     {
-        Utils::bigAdd(m_bytesSent, std::to_string(v));
+        m_bytesSent.add(v);
     }
 
     inline std::recursive_mutex& mutex()
@@ -120,6 +215,46 @@ public:
         }
     }
 
+    inline LogSegmenter* logSegmenter()
+    {
+        return m_logSegmenter;
+    }
+
+    inline void setLogSegmenter(LogSegmenter* logSegmenter)
+    {
+        m_logSegmenter = logSegmenter;
+    }
+
+    inline ArchiveRetention* archiveRetention()
+    {
+        return m_archiveRetention;
+    }
+
+    inline void setArchiveRetention(ArchiveRetention* archiveRetention)
+    {
+        m_archiveRetention = archiveRetention;
+    }
+
+    inline LogSearch* logSearch()
+    {
+        return m_logSearch;
+    }
+
+    inline void setLogSearch(LogSearch* logSearch)
+    {
+        m_logSearch = logSearch;
+    }
+
+    inline LiveTail* liveTail()
+    {
+        return m_liveTail;
+    }
+
+    inline void setLiveTail(LiveTail* liveTail)
+    {
+        m_liveTail = liveTail;
+    }
+
     inline ClientIntegrityTask* clientIntegrityTask()
     {
         return m_clientIntegrityTask;
@@ -140,6 +275,26 @@ public:
         m_logRequestHandler = logRequestHandler;
     }
 
+    inline UdpServer* udpServer()
+    {
+        return m_udpServer;
+    }
+
+    inline void setUdpServer(UdpServer* udpServer)
+    {
+        m_udpServer = udpServer;
+    }
+
+    inline TaskScheduler* taskScheduler()
+    {
+        return m_taskScheduler;
+    }
+
+    inline void setTaskScheduler(TaskScheduler* taskScheduler)
+    {
+        m_taskScheduler = taskScheduler;
+    }
+
     inline AutoUpdater* autoUpdater()
     {
         return m_autoUpdater;
@@ -158,18 +313,71 @@ private:
     Configuration* m_configuration;
 
     std::vector<LogRotator*> m_logRotators;
-    std::vector<ActiveSession> m_activeSessions;
+    LogSegmenter* m_logSegmenter;
+    ArchiveRetention* m_archiveRetention;
+    LogSearch* m_logSearch;
+    LiveTail* m_liveTail;
     ClientIntegrityTask* m_clientIntegrityTask;
     LogRequestHandler* m_logRequestHandler;
     AutoUpdater* m_autoUpdater;
-
-    std::unordered_map<std::string, Client> m_clients;
+    UdpServer* m_udpServer;
+    TaskScheduler* m_taskScheduler;
 
     std::recursive_mutex m_mutex;
-    std::recursive_mutex m_sessMutex;
 
-    std::string m_bytesSent;
-    std::string m_bytesReceived;
+    // clients are sharded by hash of ID, lookup on every log packet only locks
+    // one shard for as long as it takes to copy the handle
+    struct ClientShard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Client>> clients;
+    };
+    static const std::size_t CLIENT_SHARDS = 64;
+    ClientShard m_clientShards[CLIENT_SHARDS];
+    std::atomic<std::size_t> m_clientCount;
+
+    inline ClientShard& clientShard(const std::string& clientId)
+    {
+        return m_clientShards[std::hash<std::string>()(clientId) % CLIENT_SHARDS];
+    }
+
+    // min-heap of client expiries (dateCreated + age). Every add/update pushes new
+    // entry, outdated entries (replaced clients) are skipped when they are popped
+    struct ClientExpiry
+    {
+        types::Time expiry;
+        std::weak_ptr<Client> client;
+
+        inline bool operator>(const ClientExpiry& other) const
+        {
+            return expiry > other.expiry;
+        }
+    };
+    std::priority_queue<ClientExpiry, std::vector<ClientExpiry>, std::greater<ClientExpiry>> m_clientExpiries;
+    std::vector<std::string> m_backupKeyClients;
+    std::mutex m_expiryMutex;
+
+    void scheduleExpiry(const std::shared_ptr<Client>& client);
+
+    ///
+    /// \brief Releases resources held for removed client (e.g, shared memory rings).
+    /// Must not be called with shard lock held
+    ///
+    void clientRemoved(const std::string& clientId);
+
+    // sessions are sharded by serial so join/leave only contend within a shard
+    // and cost does not depend on number of active sessions
+    struct SessionShard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::uint64_t, ActiveSession> sessions;
+    };
+    static const std::size_t SESSION_SHARDS = 32;
+    SessionShard m_sessionShards[SESSION_SHARDS];
+    std::atomic<std::size_t> m_activeSessionCount;
+
+    ShardedCounter m_bytesSent;
+    ShardedCounter m_bytesReceived;
 
 };
 }
@@ -23,6 +23,7 @@
 #include "core/request.h"
 #include "crypto/aes.h"
 #include "logging/log.h"
+#include "net/session.h"
 
 using namespace residue;
 
@@ -36,13 +37,14 @@ RequestHandler::RequestHandler(const std::string& name, Registry* registry) :
 DecryptedRequest RequestHandler::decryptRequest(const std::string& requestStr,
                                                 const Request::StatusCode defaultStatus,
                                                 const std::string& key,
-                                                bool ignoreClient)
+                                                bool ignoreClient,
+                                                const std::shared_ptr<Client>& knownClient)
 {
     std::string requestInput(std::move(requestStr));
     std::size_t length = requestInput.size();
     std::size_t pos = requestInput.find_first_of(':');
     bool hasManualKey = !key.empty();
-    Client* existingClient = nullptr;
+    std::shared_ptr<Client> existingClient;
     if (length > 33 && pos == 32) {
 
         std::string iv = requestInput.substr(0, pos);
@@ -56,7 +58,9 @@ DecryptedRequest RequestHandler::decryptRequest(const std::string& requestStr,
         DRVLOG(RV_DEBUG) << "Client: " << clientId;
         DRVLOG(RV_CRAZY) << "IV: " << iv;
 #endif
-        if (!ignoreClient && (existingClient = m_registry->findClient(clientId)) == nullptr) {
+        if (!ignoreClient && knownClient != nullptr && knownClient->id() == clientId) {
+            existingClient = knownClient;
+        } else if (!ignoreClient && (existingClient = m_registry->findClient(clientId)) == nullptr) {
             return { nullptr, requestInput, Request::StatusCode::BAD_REQUEST, "Client not connected yet" };
         }
         std::string requestBase64 = requestInput.substr(pos + 1);
@@ -96,6 +100,42 @@ DecryptedRequest RequestHandler::decryptRequest(const std::string& requestStr,
     return { nullptr, requestInput, defaultStatus, "" };
 }
 
+void RequestHandler::resolveTrustedClient(Request* request, Session* session)
+{
+    std::string clientId;
+    if (session->client() != nullptr) {
+        clientId = session->client()->id();
+    } else if (request->jsonObject().isArray()) {
+        // bulk request - all the items belong to same client
+        for (const auto& item : request->jsonObject()) {
+            JsonDoc j(item);
+            clientId = j.get<std::string>("client_id", "");
+            break;
+        }
+    } else {
+        clientId = request->jsonObject().get<std::string>("client_id", "");
+    }
+    if (clientId.empty()) {
+        // leave status as it is, handler decides whether it needs client or not
+        return;
+    }
+    if (session->peerUid() < 0
+            || !m_registry->configuration()->isTrustedSocketClient(static_cast<unsigned int>(session->peerUid()), clientId)) {
+        RLOG(WARNING) << "Session [" << session->id() << "] (uid " << session->peerUid()
+                      << ") is not trusted for client [" << clientId << "]";
+        return;
+    }
+    std::shared_ptr<Client> client = m_registry->findClient(clientId);
+    if (client == nullptr) {
+        return;
+    }
+    if (session->client() == nullptr) {
+        session->setClient(client);
+    }
+    request->m_client = client;
+    request->m_statusCode = Request::StatusCode::OK;
+}
+
 DecryptedResult RequestHandler::decryptWithKey(const std::string& requestBase64,
                                                std::string& iv,
                                                const std::string& clientId,
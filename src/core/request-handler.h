@@ -47,6 +47,10 @@ struct RawRequest
     std::string ip;
     types::Time dateReceived;
     std::shared_ptr<Session> session;
+
+    // client resolved when request was first received (if any), so it is not
+    // looked up again (and does not disappear) while request is waiting in queue
+    std::shared_ptr<Client> client;
 };
 
 ///
@@ -54,7 +58,7 @@ struct RawRequest
 ///
 struct DecryptedRequest
 {
-    Client* client;
+    std::shared_ptr<Client> client;
     std::string plainRequestStr;
     Request::StatusCode statusCode;
     std::string errorText;
@@ -94,7 +98,8 @@ public:
     DecryptedRequest decryptRequest(const std::string& requestStr,
                                     const Request::StatusCode defaultStatus = Request::StatusCode::BAD_REQUEST,
                                     const std::string& key = "",
-                                    bool ignoreClient = false);
+                                    bool ignoreClient = false,
+                                    const std::shared_ptr<Client>& knownClient = nullptr);
 
     inline const std::string& name() const
     {
@@ -128,7 +133,8 @@ protected:
                        bool decompress = false)
     {
         handle(std::move(rawRequest.data), std::move(rawRequest.ip), std::move(rawRequest.dateReceived),
-               rawRequest.session.get(), request, defaultStatus, tryServerRSAKey, tryServerAESKey, decompress);
+               rawRequest.session.get(), request, defaultStatus, tryServerRSAKey, tryServerAESKey, decompress,
+               rawRequest.client);
     }
 
     ///
@@ -144,7 +150,8 @@ protected:
                        bool decompress = false)
     {
         handle(std::move(rawRequest.data), std::move(rawRequest.ip), std::move(rawRequest.dateReceived),
-               rawRequest.session.get(), request, defaultStatus, tryServerRSAKey, tryServerAESKey, decompress);
+               rawRequest.session.get(), request, defaultStatus, tryServerRSAKey, tryServerAESKey, decompress,
+               rawRequest.client);
     }
 
     ///
@@ -160,12 +167,13 @@ protected:
                 Request::StatusCode defaultStatus = Request::StatusCode::BAD_REQUEST,
                 bool tryServerRSAKey = false,
                 bool tryServerAESKey = false,
-                bool decompress = false)
+                bool decompress = false,
+                const std::shared_ptr<Client>& knownClient = nullptr)
     {
 #ifdef RESIDUE_DEBUG
         DRVLOG(RV_DEBUG) << "Raw request: " << requestStr;
 #endif
-        DecryptedRequest dr = decryptRequest(requestStr, defaultStatus);
+        DecryptedRequest dr = decryptRequest(requestStr, defaultStatus, "", false, knownClient);
 #ifdef RESIDUE_DEV
         DRVLOG(RV_TRACE) << "Decryption finished (b64): " << dr.plainRequestStr;
 #endif
@@ -197,6 +205,11 @@ protected:
         }
         bool result = request->deserialize(std::move(plainRequestStr));
         bool usedRsaKey = false;
+        if (result && request->m_client == nullptr && session != nullptr && session->isTrusted()) {
+            // trusted local peer sends plain requests (no AES), client is identified
+            // once per session using client_id from the first request
+            resolveTrustedClient(request, session);
+        }
         if (!result && tryServerRSAKey && !m_registry->configuration()->serverRSAKey().privateKey.empty()) {
             DRVLOG(RV_INFO) << "Trying with server exchange key...";
             // Try with server RSA key data
@@ -235,6 +248,7 @@ protected:
         }
 
         if (result && !usedRsaKey && tryServerRSAKey && request->m_client == nullptr
+                && (session == nullptr || !session->isTrusted())
                 && !m_registry->configuration()->hasFlag(Configuration::ALLOW_INSECURE_CONNECTION)) {
             // This will only happen when we have plain request
             request->m_errorText = "Plain connections not allowed by the server";
@@ -242,6 +256,11 @@ protected:
         }
     }
 
+    ///
+    /// \brief Sets client for plain request received on trusted session
+    ///
+    void resolveTrustedClient(Request* request, Session* session);
+
     DecryptedResult decryptWithKey(const std::string& requestBase64,
                                    std::string &iv,
                                    const std::string& clientId,
@@ -26,7 +26,6 @@ using namespace residue;
 
 Request::Request(const Configuration* conf) :
     m_isValid(true),
-    m_client(nullptr),
     m_configuration(conf)
 {
 }
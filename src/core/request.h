@@ -20,6 +20,7 @@
 #ifndef Request_h
 #define Request_h
 
+#include <memory>
 #include <string>
 
 #include "core/json-doc.h"
@@ -59,7 +60,7 @@ public:
         return m_jsonDoc;
     }
 
-    inline Client* client() const
+    inline const std::shared_ptr<Client>& client() const
     {
         return m_client;
     }
@@ -104,7 +105,7 @@ public:
         m_dateReceived = dateReceived;
     }
 
-    inline void setClient(Client* client)
+    inline void setClient(const std::shared_ptr<Client>& client)
     {
         m_client = client;
     }
@@ -120,7 +121,7 @@ protected:
     JsonDoc m_jsonDoc;
     bool m_isValid;
 
-    Client* m_client;
+    std::shared_ptr<Client> m_client;
     std::string m_errorText;
     StatusCode m_statusCode;
     std::string m_ipAddr;
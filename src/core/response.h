@@ -20,6 +20,7 @@
 #ifndef Response_h
 #define Response_h
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include "non-copyable.h"
@@ -41,7 +42,12 @@ public:
         INVALID_CLIENT = 2
     };
 
-    static const std::unordered_map<unsigned short, std::string> STANDARD_RESPONSES;
+    ///
+    /// \brief Prebuilt standard responses (including packet delimiter)
+    ///
+    /// These are shared constant buffers that are queued for writing as-is
+    ///
+    static const std::unordered_map<unsigned short, std::shared_ptr<const std::string>> STANDARD_RESPONSES;
 
     Response() = default;
     virtual ~Response() = default;
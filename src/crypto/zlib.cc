@@ -19,6 +19,12 @@
 
 #include "crypto/zlib.h"
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
 #include "logging/log.h"
 
 #ifdef RESIDUE_USE_MINE
@@ -65,3 +71,280 @@ bool ZLib::compressFile(const std::string& gzoutFilename, const std::string& inp
     return false;
 #endif
 }
+
+bool ZLib::decompressGzip(std::FILE* in, std::size_t size,
+                          const std::function<bool(const char*, std::size_t)>& output)
+{
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    // gzip header and trailer
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+        return false;
+    }
+    std::vector<unsigned char> inBuff(64 * 1024);
+    std::vector<unsigned char> outBuff(256 * 1024);
+    std::size_t remaining = size;
+    int ret = Z_OK;
+    bool result = true;
+    while (result && remaining > 0) {
+        std::size_t nRead = std::fread(inBuff.data(), 1, std::min(inBuff.size(), remaining), in);
+        if (nRead == 0) {
+            result = false;
+            break;
+        }
+        remaining -= nRead;
+        zs.next_in = inBuff.data();
+        zs.avail_in = static_cast<uInt>(nRead);
+        bool outputFull = false;
+        // full output buffer means there may be more to flush without any input
+        while (zs.avail_in > 0 || (outputFull && ret != Z_STREAM_END)) {
+            if (ret == Z_STREAM_END) {
+                // next member
+                inflateReset(&zs);
+            }
+            zs.next_out = outBuff.data();
+            zs.avail_out = static_cast<uInt>(outBuff.size());
+            ret = inflate(&zs, Z_NO_FLUSH);
+            if (ret == Z_BUF_ERROR && zs.avail_in == 0) {
+                // nothing was pending, needs more input
+                ret = Z_OK;
+                break;
+            }
+            if (ret != Z_OK && ret != Z_STREAM_END) {
+                result = false;
+                break;
+            }
+            outputFull = zs.avail_out == 0;
+            std::size_t produced = outBuff.size() - zs.avail_out;
+            if (produced > 0 && !output(reinterpret_cast<const char*>(outBuff.data()), produced)) {
+                inflateEnd(&zs);
+                return true;
+            }
+        }
+    }
+    inflateEnd(&zs);
+    return result && ret == Z_STREAM_END;
+}
+
+const std::size_t GzipFileBuffer::BLOCK_SIZE = 128 * 1024;
+
+// deflate window, previous block's tail is used as dictionary for next block
+static const std::size_t kGzipDictionarySize = 32 * 1024;
+
+struct GzipFileBuffer::Block
+{
+    std::string input;
+    std::string dictionary;
+    bool last;
+    std::string output;
+    unsigned long crc;
+    bool successful;
+    bool done;
+};
+
+GzipFileBuffer::GzipFileBuffer(const std::string& filename, unsigned int threads, bool append) :
+    m_file(nullptr),
+    m_failed(false),
+    m_crc(crc32(0L, Z_NULL, 0)),
+    m_size(0),
+    m_stopping(false)
+{
+    m_file = std::fopen(filename.c_str(), append ? "ab" : "wb");
+    if (m_file == nullptr) {
+        RLOG(ERROR) << "Unable to open file for writing [" << filename << "] " << std::strerror(errno);
+        return;
+    }
+    // gzip header: magic, deflate, no flags, no mtime, no extra flags, unix
+    const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+    if (std::fwrite(header, 1, sizeof(header), m_file) != sizeof(header)) {
+        m_failed = true;
+    }
+    m_current.reserve(BLOCK_SIZE);
+    for (unsigned int i = 0; threads > 1 && i < threads; ++i) {
+        m_workers.push_back(std::thread([&]() {
+            work();
+        }));
+    }
+}
+
+GzipFileBuffer::~GzipFileBuffer()
+{
+    close();
+}
+
+GzipFileBuffer::int_type GzipFileBuffer::overflow(int_type ch)
+{
+    if (m_file == nullptr || m_failed) {
+        return traits_type::eof();
+    }
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+    m_current.push_back(traits_type::to_char_type(ch));
+    if (m_current.size() >= BLOCK_SIZE) {
+        submit(false);
+    }
+    return ch;
+}
+
+std::streamsize GzipFileBuffer::xsputn(const char* s, std::streamsize n)
+{
+    if (m_file == nullptr || m_failed || n <= 0) {
+        return 0;
+    }
+    std::size_t remaining = static_cast<std::size_t>(n);
+    while (remaining > 0) {
+        std::size_t len = std::min(remaining, BLOCK_SIZE - m_current.size());
+        m_current.append(s, len);
+        s += len;
+        remaining -= len;
+        if (m_current.size() >= BLOCK_SIZE) {
+            submit(false);
+        }
+    }
+    return n;
+}
+
+void GzipFileBuffer::compressBlock(Block* block)
+{
+    block->crc = crc32(0L, reinterpret_cast<const Bytef*>(block->input.data()), static_cast<uInt>(block->input.size()));
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    // raw deflate, gzip header and trailer are written by us
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        block->successful = false;
+        return;
+    }
+    if (!block->dictionary.empty()) {
+        deflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(block->dictionary.data()),
+                             static_cast<uInt>(block->dictionary.size()));
+    }
+    // sync flush adds empty stored block (5 bytes) so it ends on byte boundary
+    block->output.resize(deflateBound(&zs, static_cast<uLong>(block->input.size())) + 16);
+    zs.next_in = reinterpret_cast<Bytef*>(&block->input[0]);
+    zs.avail_in = static_cast<uInt>(block->input.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&block->output[0]);
+    zs.avail_out = static_cast<uInt>(block->output.size());
+    int ret = deflate(&zs, block->last ? Z_FINISH : Z_SYNC_FLUSH);
+    block->successful = block->last ? ret == Z_STREAM_END : (ret == Z_OK && zs.avail_in == 0);
+    block->output.resize(block->output.size() - zs.avail_out);
+    deflateEnd(&zs);
+}
+
+void GzipFileBuffer::submit(bool last)
+{
+    std::shared_ptr<Block> block = std::make_shared<Block>();
+    block->input.swap(m_current);
+    block->dictionary = m_dictionary;
+    block->last = last;
+    block->done = false;
+    if (block->input.size() >= kGzipDictionarySize) {
+        m_dictionary.assign(block->input, block->input.size() - kGzipDictionarySize, kGzipDictionarySize);
+    } else {
+        m_dictionary.append(block->input);
+        if (m_dictionary.size() > kGzipDictionarySize) {
+            m_dictionary.erase(0, m_dictionary.size() - kGzipDictionarySize);
+        }
+    }
+    m_current.reserve(BLOCK_SIZE);
+
+    if (m_workers.empty()) {
+        compressBlock(block.get());
+        block->done = true;
+        m_inFlight.push_back(block);
+        writeCompleted(0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        m_inFlight.push_back(block);
+        m_jobs.push_back(block);
+    }
+    m_jobsCv.notify_one();
+    // keep workers busy but bound memory to couple of blocks per worker
+    writeCompleted(m_workers.size() * 2);
+}
+
+void GzipFileBuffer::writeCompleted(std::size_t maxInFlight)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_inFlight.empty()) {
+        if (!m_inFlight.front()->done) {
+            if (m_inFlight.size() <= maxInFlight) {
+                break;
+            }
+            m_doneCv.wait(lock);
+            continue;
+        }
+        std::shared_ptr<Block> block = m_inFlight.front();
+        m_inFlight.pop_front();
+        lock.unlock();
+        if (!block->successful) {
+            RLOG(ERROR) << "Error during compression of block";
+            m_failed = true;
+        } else if (!m_failed && std::fwrite(block->output.data(), 1, block->output.size(), m_file) != block->output.size()) {
+            RLOG(ERROR) << "Error writing compressed data " << std::strerror(errno);
+            m_failed = true;
+        }
+        m_crc = crc32_combine(m_crc, block->crc, static_cast<z_off_t>(block->input.size()));
+        m_size += static_cast<unsigned long>(block->input.size());
+        lock.lock();
+    }
+}
+
+void GzipFileBuffer::work()
+{
+    while (true) {
+        std::shared_ptr<Block> block;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobsCv.wait(lock, [&]() {
+                return m_stopping || !m_jobs.empty();
+            });
+            if (m_jobs.empty()) {
+                return;
+            }
+            block = m_jobs.front();
+            m_jobs.pop_front();
+        }
+        compressBlock(block.get());
+        {
+            std::lock_guard<std::mutex> lock_(m_mutex);
+            block->done = true;
+        }
+        m_doneCv.notify_all();
+    }
+}
+
+bool GzipFileBuffer::close()
+{
+    if (m_file == nullptr) {
+        return false;
+    }
+    submit(true);
+    writeCompleted(0);
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        m_stopping = true;
+    }
+    m_jobsCv.notify_all();
+    for (auto& t : m_workers) {
+        t.join();
+    }
+    m_workers.clear();
+
+    // gzip trailer: crc32 and input size (mod 2^32), little endian
+    unsigned char trailer[8];
+    for (int i = 0; i < 4; ++i) {
+        trailer[i] = static_cast<unsigned char>((m_crc >> (8 * i)) & 0xff);
+        trailer[4 + i] = static_cast<unsigned char>((m_size >> (8 * i)) & 0xff);
+    }
+    if (std::fwrite(trailer, 1, sizeof(trailer), m_file) != sizeof(trailer)) {
+        m_failed = true;
+    }
+    if (std::fclose(m_file) != 0) {
+        m_failed = true;
+    }
+    m_file = nullptr;
+    return !m_failed;
+}
@@ -20,7 +20,17 @@
 #ifndef ZLib_h
 #define ZLib_h
 
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <streambuf>
 #include <string>
+#include <thread>
+#include <vector>
+#include "non-copyable.h"
 #include "static-base.h"
 
 namespace residue {
@@ -47,6 +57,75 @@ public:
     ///
     static bool compressFile(const std::string& gzoutFilename, const std::string& inputFile);
 
+    ///
+    /// \brief Inflates gzip member(s) that are in next size bytes of the file. Output is passed
+    /// in chunks, returning false from output stops decompressing
+    ///
+    static bool decompressGzip(std::FILE* in, std::size_t size,
+                               const std::function<bool(const char*, std::size_t)>& output);
+
+};
+
+///
+/// \brief Output stream buffer that writes gzip stream straight to the file
+/// so the data does not need to be written uncompressed first.
+///
+/// Input is split in to blocks that are deflated independently (each primed with
+/// the tail of previous block as dictionary) and written in order, so blocks can be
+/// compressed on multiple threads while output is still a single standard gzip member
+///
+class GzipFileBuffer final : public std::streambuf, NonCopyable
+{
+public:
+    static const std::size_t BLOCK_SIZE;
+
+    ///
+    /// \param threads Number of threads to compress blocks on. If <= 1, blocks are compressed
+    /// on the writing thread
+    /// \param append Adds new gzip member at the end of file instead of overwriting it
+    /// (concatenated members are still a valid gzip file)
+    ///
+    explicit GzipFileBuffer(const std::string& filename, unsigned int threads = 1, bool append = false);
+    virtual ~GzipFileBuffer();
+
+    inline bool isOpen() const
+    {
+        return m_file != nullptr;
+    }
+
+    ///
+    /// \brief Finishes gzip stream and closes the file
+    /// \return False if anything failed to write
+    ///
+    bool close();
+
+protected:
+    virtual int_type overflow(int_type ch) override;
+    virtual std::streamsize xsputn(const char* s, std::streamsize n) override;
+
+private:
+    struct Block;
+
+    std::FILE* m_file;
+    bool m_failed;
+    std::string m_current;
+    std::string m_dictionary;
+    unsigned long m_crc;
+    unsigned long m_size;
+
+    // blocks in order they need to be written, and blocks waiting for a worker
+    std::deque<std::shared_ptr<Block>> m_inFlight;
+    std::deque<std::shared_ptr<Block>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_jobsCv;
+    std::condition_variable m_doneCv;
+    std::vector<std::thread> m_workers;
+    bool m_stopping;
+
+    void submit(bool last);
+    void writeCompleted(std::size_t maxInFlight);
+    void work();
+    static void compressBlock(Block* block);
 };
 }
 
@@ -0,0 +1,177 @@
+//
+//  zstd.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifdef RESIDUE_HAS_ZSTD
+
+#include "crypto/zstd.h"
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "logging/log.h"
+
+using namespace residue;
+
+bool ZStd::decompress(std::FILE* in, std::size_t size,
+                      const std::function<bool(const char*, std::size_t)>& output)
+{
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    if (dctx == nullptr) {
+        return false;
+    }
+    std::vector<char> inBuff(ZSTD_DStreamInSize());
+    std::vector<char> outBuff(ZSTD_DStreamOutSize());
+    std::size_t remaining = size;
+    std::size_t ret = 0;
+    bool result = true;
+    while (result && remaining > 0) {
+        std::size_t nRead = std::fread(inBuff.data(), 1, std::min(inBuff.size(), remaining), in);
+        if (nRead == 0) {
+            result = false;
+            break;
+        }
+        remaining -= nRead;
+        ZSTD_inBuffer input = { inBuff.data(), nRead, 0 };
+        bool outputFull = false;
+        // full output buffer means there may be more to flush without any input
+        while (input.pos < input.size || outputFull) {
+            ZSTD_outBuffer out = { outBuff.data(), outBuff.size(), 0 };
+            ret = ZSTD_decompressStream(dctx, &out, &input);
+            if (ZSTD_isError(ret)) {
+                result = false;
+                break;
+            }
+            outputFull = out.pos == out.size;
+            if (out.pos > 0 && !output(outBuff.data(), out.pos)) {
+                ZSTD_freeDCtx(dctx);
+                return true;
+            }
+        }
+    }
+    ZSTD_freeDCtx(dctx);
+    // 0 when frame is complete
+    return result && ret == 0;
+}
+
+const int ZstdFileBuffer::DEFAULT_LEVEL = 3;
+
+ZstdFileBuffer::ZstdFileBuffer(const std::string& filename, int level, bool longDistance,
+                               unsigned int threads, bool append) :
+    m_file(nullptr),
+    m_cctx(nullptr),
+    m_failed(false),
+    m_in(ZSTD_CStreamInSize()),
+    m_out(ZSTD_CStreamOutSize())
+{
+    m_cctx = ZSTD_createCCtx();
+    if (m_cctx == nullptr) {
+        RLOG(ERROR) << "Unable to create zstd context";
+        return;
+    }
+    ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_checksumFlag, 1);
+    if (longDistance) {
+        ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_enableLongDistanceMatching, 1);
+    }
+    if (threads > 1) {
+        // returns error when libzstd is not built with ZSTD_MULTITHREAD, we just stay single threaded
+        std::size_t result = ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_nbWorkers, static_cast<int>(threads));
+        if (ZSTD_isError(result)) {
+            RVLOG(RV_DEBUG) << "zstd workers unavailable: " << ZSTD_getErrorName(result);
+        }
+    }
+    m_file = std::fopen(filename.c_str(), append ? "ab" : "wb");
+    if (m_file == nullptr) {
+        RLOG(ERROR) << "Unable to open file for writing [" << filename << "] " << std::strerror(errno);
+        return;
+    }
+    setp(m_in.data(), m_in.data() + m_in.size());
+}
+
+ZstdFileBuffer::~ZstdFileBuffer()
+{
+    close();
+    if (m_cctx != nullptr) {
+        ZSTD_freeCCtx(m_cctx);
+        m_cctx = nullptr;
+    }
+}
+
+bool ZstdFileBuffer::compress(bool end)
+{
+    if (m_file == nullptr || m_failed) {
+        return false;
+    }
+    ZSTD_inBuffer input = { pbase(), static_cast<std::size_t>(pptr() - pbase()), 0 };
+    ZSTD_EndDirective mode = end ? ZSTD_e_end : ZSTD_e_continue;
+    bool finished = false;
+    while (!finished) {
+        ZSTD_outBuffer output = { m_out.data(), m_out.size(), 0 };
+        std::size_t remaining = ZSTD_compressStream2(m_cctx, &output, &input, mode);
+        if (ZSTD_isError(remaining)) {
+            RLOG(ERROR) << "zstd compression failed: " << ZSTD_getErrorName(remaining);
+            m_failed = true;
+            return false;
+        }
+        if (output.pos > 0 && std::fwrite(m_out.data(), 1, output.pos, m_file) != output.pos) {
+            m_failed = true;
+            return false;
+        }
+        // in continue mode all input must be consumed, end mode must also flush everything
+        finished = end ? remaining == 0 : input.pos == input.size;
+    }
+    setp(m_in.data(), m_in.data() + m_in.size());
+    return true;
+}
+
+ZstdFileBuffer::int_type ZstdFileBuffer::overflow(int_type ch)
+{
+    if (!compress(false)) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int ZstdFileBuffer::sync()
+{
+    // nothing is flushed mid-frame, it would only hurt the ratio
+    return m_failed ? -1 : 0;
+}
+
+bool ZstdFileBuffer::close()
+{
+    if (m_file == nullptr) {
+        return false;
+    }
+    compress(true);
+    if (std::fclose(m_file) != 0) {
+        m_failed = true;
+    }
+    m_file = nullptr;
+    return !m_failed;
+}
+
+#endif // RESIDUE_HAS_ZSTD
@@ -0,0 +1,100 @@
+//
+//  zstd.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef ZStd_h
+#define ZStd_h
+
+#ifdef RESIDUE_HAS_ZSTD
+
+#include <cstdio>
+#include <functional>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "non-copyable.h"
+#include "static-base.h"
+
+typedef struct ZSTD_CCtx_s ZSTD_CCtx;
+
+namespace residue {
+
+///
+/// \brief Zstandard helpers
+///
+class ZStd final : StaticBase
+{
+public:
+    ///
+    /// \brief Decompresses zstd frame(s) that are in next size bytes of the file (see ZLib::decompressGzip)
+    ///
+    static bool decompress(std::FILE* in, std::size_t size,
+                           const std::function<bool(const char*, std::size_t)>& output);
+};
+
+///
+/// \brief Output stream buffer that writes zstd frame straight to the file
+/// (see GzipFileBuffer for gzip counterpart)
+///
+/// Multi-threading is handed to libzstd (ZSTD_c_nbWorkers) and is silently
+/// ignored if library is built without it
+///
+class ZstdFileBuffer final : public std::streambuf, NonCopyable
+{
+public:
+    static const int DEFAULT_LEVEL;
+
+    ///
+    /// \param level Compression level (1-19)
+    /// \param longDistance Enable long distance matching (larger window for repetitive input like logs)
+    /// \param threads Number of compression workers. If <= 1, compression is done on the writing thread
+    /// \param append Adds new frame at the end of file instead of overwriting it
+    ///
+    ZstdFileBuffer(const std::string& filename, int level = DEFAULT_LEVEL, bool longDistance = false,
+                   unsigned int threads = 1, bool append = false);
+    virtual ~ZstdFileBuffer();
+
+    inline bool isOpen() const
+    {
+        return m_file != nullptr;
+    }
+
+    ///
+    /// \brief Ends zstd frame and closes the file
+    /// \return False if anything failed to write
+    ///
+    bool close();
+
+protected:
+    virtual int_type overflow(int_type ch) override;
+    virtual int sync() override;
+
+private:
+    std::FILE* m_file;
+    ZSTD_CCtx* m_cctx;
+    bool m_failed;
+    std::vector<char> m_in;
+    std::vector<char> m_out;
+
+    bool compress(bool end);
+};
+}
+
+#endif // RESIDUE_HAS_ZSTD
+
+#endif /* ZStd_h */
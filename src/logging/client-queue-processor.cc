@@ -19,19 +19,26 @@
 
 #include "logging/client-queue-processor.h"
 
+#include <algorithm>
+
 #include "core/configuration.h"
 #include "logging/log.h"
 #include "logging/log-request.h"
 #include "logging/user-message.h"
-#include "tasks/client-integrity-task.h"
+#include "net/session.h"
 
 using namespace residue;
 
+const unsigned int ClientQueueProcessor::RING_MIN_POLL_INTERVAL = 1;
+const unsigned int ClientQueueProcessor::RING_MAX_POLL_INTERVAL = 10;
+const unsigned int ClientQueueProcessor::POLL_INTERVAL = 100;
+
 ClientQueueProcessor::ClientQueueProcessor(Registry* registry, const std::string& clientId) :
     RequestHandler("Processor", registry),
     m_clientId(clientId),
     m_enabled(true),
-    m_stopped(true)
+    m_stopped(true),
+    m_ringPollInterval(RING_MIN_POLL_INTERVAL)
 {
     DRVLOG(RV_DEBUG) << "Initialized processor [LogDispatcher<" << m_clientId << ">] @ " << this;
 }
@@ -40,7 +47,9 @@ ClientQueueProcessor::~ClientQueueProcessor()
 {
     RLOG(WARNING) << "~LogDispatcher<" << m_clientId << ">";
     m_stopped = true;
-    m_worker.join();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
 }
 
 void ClientQueueProcessor::start()
@@ -50,16 +59,104 @@ void ClientQueueProcessor::start()
         m_worker = std::thread([&]() {
             el::Helpers::setThreadName("LogDispatcher<" + m_clientId + ">");
             while (!m_stopped) {
+                unsigned int interval = POLL_INTERVAL;
                 if (m_enabled) {
+                    interval = drainRings();
                     processRequestQueue();
                 }
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                resumeSessionsIfDrained();
+                std::this_thread::sleep_for(std::chrono::milliseconds(interval));
             }
         });
         RLOG(INFO) << "Started client processor [LogDispatcher<" << m_clientId << ">]";
     }
 }
 
+bool ClientQueueProcessor::isOverloaded() const
+{
+    const unsigned int maxQueueDepth = m_registry->configuration()->maxQueueDepth();
+    return maxQueueDepth > 0 && m_queue.depth() >= maxQueueDepth;
+}
+
+void ClientQueueProcessor::pauseSession(const std::shared_ptr<Session>& session)
+{
+    RVLOG(RV_WARNING) << "Queue for [" << m_clientId << "] is full (" << m_queue.depth()
+                      << " requests), pausing session [" << session->id() << "]";
+    std::lock_guard<std::mutex> lock(m_pausedSessionsMutex);
+    session->pauseReading();
+    m_pausedSessions.push_back(session);
+}
+
+void ClientQueueProcessor::resumeSessionsIfDrained()
+{
+    std::lock_guard<std::mutex> lock(m_pausedSessionsMutex);
+    if (m_pausedSessions.empty()
+            || m_queue.depth() > m_registry->configuration()->queueResumeDepth()) {
+        return;
+    }
+    RVLOG(RV_INFO) << "Queue for [" << m_clientId << "] drained to " << m_queue.depth()
+                   << " requests, resuming " << m_pausedSessions.size() << " session(s)";
+    for (auto& weakSession : m_pausedSessions) {
+        std::shared_ptr<Session> session = weakSession.lock();
+        if (session) {
+            session->resumeReading();
+        }
+    }
+    m_pausedSessions.clear();
+}
+
+void ClientQueueProcessor::attachRing(std::unique_ptr<ShmRing>&& ring)
+{
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    m_rings.push_back(std::move(ring));
+    m_ringPollInterval = RING_MIN_POLL_INTERVAL;
+}
+
+void ClientQueueProcessor::detachRings(const std::string& clientId)
+{
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [&](const std::unique_ptr<ShmRing>& ring) {
+        if (ring->clientId() != clientId) {
+            return false;
+        }
+        RVLOG(RV_DETAILS) << "Detaching ring [" << ring->name() << "] for client [" << clientId << "]";
+        return true;
+    }), m_rings.end());
+}
+
+unsigned int ClientQueueProcessor::drainRings()
+{
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    if (m_rings.empty()) {
+        return POLL_INTERVAL;
+    }
+    bool found = false;
+    std::vector<std::string> removedClients;
+    for (auto& ring : m_rings) {
+        // current client (registry publishes new client object on every update)
+        std::shared_ptr<Client> client = m_registry->findClient(ring->clientId());
+        if (client == nullptr) {
+            // detached below
+            removedClients.push_back(ring->clientId());
+            continue;
+        }
+        std::string record;
+        // ring is left as is when queue is full, producer sees it full and backs off
+        while (!isOverloaded() && ring->pop(record)) {
+            m_queue.push({ std::move(record), "shm", Utils::now(), nullptr, client });
+            found = true;
+        }
+    }
+    m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [&](const std::unique_ptr<ShmRing>& ring) {
+        return ring->closed()
+                || std::find(removedClients.begin(), removedClients.end(), ring->clientId()) != removedClients.end();
+    }), m_rings.end());
+    // there is no notification from producer so we poll attached rings
+    // often while they are busy and back off while they are empty
+    m_ringPollInterval = found ? RING_MIN_POLL_INTERVAL : std::min(m_ringPollInterval * 2, RING_MAX_POLL_INTERVAL);
+    return m_rings.empty() ? POLL_INTERVAL : m_ringPollInterval;
+}
+
 void ClientQueueProcessor::processRequestQueue()
 {
     bool compressionEnabled = m_registry->configuration()->hasFlag(Configuration::Flag::COMPRESSION);
@@ -75,17 +172,6 @@ void ClientQueueProcessor::processRequestQueue()
     // we take snapshot to prevent potential race conditions (even though we have LoggingQueue that is safe)
     const std::size_t total = m_queue.size();
 
-    const types::Time lastClientIntegrityRun = m_registry->clientIntegrityTask() == nullptr
-            ? 0L : m_registry->clientIntegrityTask()->lastExecution();
-
-    if (total > 0 && m_registry->clientIntegrityTask() != nullptr) {
-        // we pause client integrity task until we clear this queue
-        // so we don't clean a (now) dead client that passed initial validation
-#ifdef RESIDUE_DEV
-        DRVLOG(RV_DEBUG) << "Pausing client integrity task for [" << m_clientId << "]";
-#endif
-        m_registry->clientIntegrityTask()->pauseClient(m_clientId);
-    }
 #ifdef RESIDUE_DEBUG
     DRVLOG_IF(total > 0, RV_CRAZY) << "Items: " << total;
 #endif
@@ -108,6 +194,8 @@ void ClientQueueProcessor::processRequestQueue()
 
         // get another reference to shared pointer for session
         std::shared_ptr<Session> session = rawRequest.session;
+        // client that request was received from (or that owns the ring it was drained from)
+        std::shared_ptr<Client> knownClient = rawRequest.client;
 
         RESIDUE_HIGH_PROFILE_CHECKPOINT_MIS(t_process_item, m_timeTakenByItem, 1, 1);
 
@@ -122,6 +210,12 @@ void ClientQueueProcessor::processRequestQueue()
             continue;
         }
 
+        if (knownClient != nullptr && (request.client() == nullptr || request.client()->id() != knownClient->id())) {
+            RLOG(ERROR) << "Ignoring request for client [" << (request.client() == nullptr ? "" : request.client()->id())
+                        << "] received from client [" << knownClient->id() << "]";
+            continue;
+        }
+
 #ifdef RESIDUE_DEV
         DRVLOG(RV_DEBUG) << "Is bulk? " << request.isBulk();
 #endif
@@ -129,10 +223,10 @@ void ClientQueueProcessor::processRequestQueue()
             if (allowBulkRequests) {
                 // Create bulk request items
                 unsigned int itemCount = 0U;
-                Client* currentClient = request.client();
+                std::shared_ptr<Client> currentClient = request.client();
                 bool forceClientValidation = true;
  #ifdef RESIDUE_DEV
-                DRVLOG(RV_DEBUG) << "Request client: " << request.client();
+                DRVLOG(RV_DEBUG) << "Request client: " << request.client().get();
  #endif
                 for (const auto& js : request.jsonObject()) {
 
@@ -195,29 +289,6 @@ void ClientQueueProcessor::processRequestQueue()
 #endif
     }
 
-    if (m_registry->clientIntegrityTask() != nullptr &&
-            lastClientIntegrityRun < m_registry->clientIntegrityTask()->lastExecution() &&
-            m_queue.backlogEmpty()) {
-        RVLOG(RV_DEBUG) << "Starting client integrity task after queue is processed.";
-        // trigger client integrity task as it was run while this queue was being processed
-        if (!m_registry->clientIntegrityTask()->isExecuting()) {
-            if (m_clientId != Configuration::UNMANAGED_CLIENT_ID) {
-                // Unmanaged clients are special case as CLIENT ID is not real ID
-                // so we execute whole task at next schedule (provided no other unmanaged client)
-                // add more logs to the queue in which case it will be paused again
-            } else {
-                m_registry->clientIntegrityTask()->performCleanup(m_clientId);
-            }
-        }
-    }
-
-    if (total > 0 && m_registry->clientIntegrityTask() != nullptr && m_queue.backlogEmpty()) {
-#ifdef RESIDUE_DEV
-        DRVLOG(RV_DEBUG) << "Resuming client integrity task for [" << m_clientId << "]";
-#endif
-        m_registry->clientIntegrityTask()->resumeClient(m_clientId);
-    }
-
  #ifdef RESIDUE_PROFILING
     RESIDUE_PROFILE_END(t_process_queue, m_timeTaken);
     float timeTakenInSec = static_cast<float>(m_timeTaken / 1000.0f);
@@ -234,7 +305,7 @@ void ClientQueueProcessor::processRequestQueue()
     m_queue.switchContext();
 }
 
-bool ClientQueueProcessor::processRequest(LogRequest* request, Client** clientRef, bool forceCheck, Session *session)
+bool ClientQueueProcessor::processRequest(LogRequest* request, std::shared_ptr<Client>* clientRef, bool forceCheck, Session *session)
 {
 #ifdef RESIDUE_HIGH_RESOLUTION_PROFILING
    types::Time m_timeTakenProcessRequest;
@@ -247,7 +318,7 @@ bool ClientQueueProcessor::processRequest(LogRequest* request, Client** clientRe
                      << (clientRef == nullptr ? "N/A" : *clientRef == nullptr ? "null" : (*clientRef)->id())
                      << ", bypassChecks: " << bypassChecks;
  #endif
-    Client* client = clientRef != nullptr && *clientRef != nullptr ? *clientRef : request->client();
+    const std::shared_ptr<Client>& client = clientRef != nullptr && *clientRef != nullptr ? *clientRef : request->client();
 
     if (client == nullptr) {
         RVLOG(RV_ERROR) << "Invalid request. No client found [" << request->clientId() << "]";
@@ -320,7 +391,7 @@ void ClientQueueProcessor::dispatch(const LogRequest* request)
 
 bool ClientQueueProcessor::isRequestAllowed(const LogRequest* request) const
 {
-    Client* client = request->client();
+    const std::shared_ptr<Client>& client = request->client();
     if (client == nullptr) {
         RLOG(DEBUG) << "Client may have expired";
         return false;
@@ -21,12 +21,16 @@
 #define ClientQueueProcessor_h
 
 #include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "core/json-doc.h"
 #include "core/request-handler.h"
 #include "logging/logging-queue.h"
+#include "net/shm-ring.h"
 
 namespace residue {
 
@@ -71,7 +75,35 @@ public:
     }
 
     bool isRequestAllowed(const LogRequest*) const;
+
+    ///
+    /// \brief Whether queue has reached configured max_queue_depth
+    ///
+    bool isOverloaded() const;
+
+    ///
+    /// \brief Pauses reading from the session until this queue drains
+    /// down to queue_resume_depth
+    ///
+    void pauseSession(const std::shared_ptr<Session>& session);
+
+    ///
+    /// \brief Starts draining shared memory ring in to this queue. Ring is detached
+    /// once producer closes it or owner client is removed (see detachRings())
+    ///
+    void attachRing(std::unique_ptr<ShmRing>&& ring);
+
+    ///
+    /// \brief Detaches (unmaps) all the rings owned by this client
+    ///
+    void detachRings(const std::string& clientId);
 private:
+    // attached rings are polled every RING_MIN_POLL_INTERVAL ms after records were found,
+    // backing off up to RING_MAX_POLL_INTERVAL ms while they are empty
+    static const unsigned int RING_MIN_POLL_INTERVAL;
+    static const unsigned int RING_MAX_POLL_INTERVAL;
+    static const unsigned int POLL_INTERVAL;
+
     std::string m_clientId;
     std::atomic<bool> m_enabled;
     std::atomic<bool> m_stopped;
@@ -79,6 +111,14 @@ private:
     std::thread m_worker;
     JsonDoc m_jsonDocForBulk;
 
+    std::mutex m_pausedSessionsMutex;
+    std::vector<std::weak_ptr<Session>> m_pausedSessions;
+
+    std::mutex m_ringsMutex;
+    // records drained from a ring are only accepted for client that attached it (ShmRing::clientId())
+    std::vector<std::unique_ptr<ShmRing>> m_rings;
+    unsigned int m_ringPollInterval;
+
     friend class Stats;
 
     ////
@@ -91,6 +131,17 @@ private:
     ///
     void processRequestQueue();
 
+    ///
+    /// \brief Resumes reading paused sessions if queue is below low watermark
+    ///
+    void resumeSessionsIfDrained();
+
+    ///
+    /// \brief Moves records from attached rings to the queue
+    /// \return How long (ms) worker should wait before next iteration
+    ///
+    unsigned int drainRings();
+
     ///
     /// \brief Processes single log request
     /// \param clientRef A client reference pointer for fast processing (by skipping upcoming items in the bulk)
@@ -99,7 +150,7 @@ private:
     /// \return True if successfully processed. Also sets client reference pointer accordingly.
     ///
     bool processRequest(LogRequest*,
-                        Client** clientRef,
+                        std::shared_ptr<Client>* clientRef,
                         bool forceCheck,
                         Session* session);
 
@@ -0,0 +1,209 @@
+//
+//  live-tail.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "logging/live-tail.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+#include "core/configuration.h"
+#include "core/registry.h"
+#include "net/session.h"
+#include "utils/utils.h"
+
+using namespace residue;
+
+const std::size_t LiveTail::MAX_SUBSCRIBERS = 32;
+const std::size_t LiveTail::MAX_PENDING_WRITES = 8;
+const unsigned int LiveTail::FLUSH_INTERVAL_MS = 100;
+
+LiveTail::LiveTail(Registry* registry) :
+    m_registry(registry),
+    m_subscriberCount(0),
+    m_running(true)
+{
+    m_flusher = std::thread([&]() {
+        el::Helpers::setThreadName("LiveTail");
+        while (m_running) {
+            {
+                std::unique_lock<std::mutex> lock_(m_flushMutex);
+                m_flushCv.wait_for(lock_, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [&]() { return !m_running; });
+            }
+            if (hasSubscribers()) {
+                flush();
+            }
+        }
+    });
+}
+
+LiveTail::~LiveTail()
+{
+    {
+        std::lock_guard<std::mutex> lock_(m_flushMutex);
+        m_running = false;
+    }
+    m_flushCv.notify_all();
+    m_flusher.join();
+}
+
+bool LiveTail::subscribe(const std::string& loggerId, const std::set<std::string>& levels, const std::string& clientId,
+                         const std::shared_ptr<Session>& session, std::string* errorText)
+{
+    if (el::Loggers::getLogger(loggerId, false) == nullptr) {
+        *errorText = "Logger [" + loggerId + "] not yet registered";
+        return false;
+    }
+    std::shared_ptr<Subscriber> subscriber = std::make_shared<Subscriber>();
+    for (const auto& levelStr : levels) {
+        el::Level level = el::LevelHelper::convertFromString(levelStr.c_str());
+        if (level == el::Level::Unknown) {
+            *errorText = "Unknown level [" + levelStr + "]";
+            return false;
+        }
+        subscriber->levels.insert(level);
+    }
+    subscriber->loggerId = loggerId;
+    subscriber->clientId = clientId;
+    subscriber->session = session;
+    subscriber->sessionId = session->id();
+    subscriber->capacity = m_registry->configuration()->tailBufferSize();
+    subscriber->recentlyDropped = 0;
+    subscriber->sent = 0;
+    subscriber->dropped = 0;
+    // sent before any line
+    subscriber->lines.push_back("Subscribed to [" + loggerId + "]\n");
+
+    {
+        // no logging in this scope as residue logger's lines are published too
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        if (m_subscriberCount >= MAX_SUBSCRIBERS) {
+            *errorText = "Too many subscribers, please try later";
+            return false;
+        }
+        m_subscribers[loggerId].push_back(subscriber);
+        ++m_subscriberCount;
+    }
+    RLOG(INFO) << "Session [" << session->id() << "] subscribed to [" << loggerId << "]";
+    return true;
+}
+
+void LiveTail::unsubscribe(const std::shared_ptr<Subscriber>& subscriber)
+{
+    std::lock_guard<std::mutex> lock_(m_mutex);
+    auto iter = m_subscribers.find(subscriber->loggerId);
+    if (iter == m_subscribers.end()) {
+        return;
+    }
+    auto pos = std::find(iter->second.begin(), iter->second.end(), subscriber);
+    if (pos != iter->second.end()) {
+        iter->second.erase(pos);
+        --m_subscriberCount;
+    }
+    if (iter->second.empty()) {
+        m_subscribers.erase(iter);
+    }
+}
+
+void LiveTail::publish(const std::string& loggerId, el::Level level, const std::string& clientId, const std::string& line)
+{
+    std::lock_guard<std::mutex> lock_(m_mutex);
+    auto iter = m_subscribers.find(loggerId);
+    if (iter == m_subscribers.end()) {
+        return;
+    }
+    for (const auto& subscriber : iter->second) {
+        if ((!subscriber->levels.empty() && subscriber->levels.find(level) == subscriber->levels.end())
+                || (!subscriber->clientId.empty() && subscriber->clientId != clientId)) {
+            continue;
+        }
+        std::lock_guard<std::mutex> subscriberLock(subscriber->mutex);
+        if (subscriber->lines.size() >= subscriber->capacity) {
+            ++subscriber->recentlyDropped;
+            ++subscriber->dropped;
+            continue;
+        }
+        subscriber->lines.push_back(line);
+    }
+}
+
+void LiveTail::flush()
+{
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        for (const auto& pair : m_subscribers) {
+            subscribers.insert(subscribers.end(), pair.second.begin(), pair.second.end());
+        }
+    }
+    for (const auto& subscriber : subscribers) {
+        std::shared_ptr<Session> session = subscriber->session.lock();
+        if (session == nullptr || !session->isConnected()) {
+            RLOG(INFO) << "Session [" << subscriber->sessionId << "] unsubscribed from [" << subscriber->loggerId << "]";
+            unsubscribe(subscriber);
+            continue;
+        }
+        if (session->pendingWrites() >= MAX_PENDING_WRITES) {
+            // slow subscriber, lines stay in its buffer until it catches up
+            continue;
+        }
+        std::deque<std::string> lines;
+        std::size_t dropped;
+        {
+            std::lock_guard<std::mutex> subscriberLock(subscriber->mutex);
+            lines.swap(subscriber->lines);
+            dropped = subscriber->recentlyDropped;
+            subscriber->recentlyDropped = 0;
+        }
+        if (lines.empty() && dropped == 0) {
+            continue;
+        }
+        std::string response;
+        if (dropped > 0) {
+            response.append("=== [residue] ==> ").append(std::to_string(dropped)).append(" line(s) dropped ===\n");
+        }
+        for (const auto& line : lines) {
+            response.append(line);
+        }
+        session->write(response.c_str(), m_registry->configuration()->serverKey().c_str());
+        subscriber->sent += lines.size();
+    }
+}
+
+std::vector<LiveTail::SubscriberInfo> LiveTail::subscribers()
+{
+    std::vector<SubscriberInfo> result;
+    std::lock_guard<std::mutex> lock_(m_mutex);
+    for (const auto& pair : m_subscribers) {
+        for (const auto& subscriber : pair.second) {
+            std::stringstream levels;
+            for (el::Level level : subscriber->levels) {
+                levels << (levels.tellp() > 0 ? "," : "") << el::LevelHelper::convertToString(level);
+            }
+            std::size_t buffered;
+            {
+                std::lock_guard<std::mutex> subscriberLock(subscriber->mutex);
+                buffered = subscriber->lines.size();
+            }
+            result.push_back({ subscriber->loggerId, subscriber->sessionId, subscriber->clientId, levels.str(),
+                               buffered, subscriber->sent, subscriber->dropped });
+        }
+    }
+    return result;
+}
@@ -0,0 +1,128 @@
+//
+//  live-tail.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef LiveTail_h
+#define LiveTail_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "logging/log.h"
+#include "non-copyable.h"
+
+namespace residue {
+
+class Registry;
+class Session;
+
+///
+/// \brief Fans out dispatched lines of a logger to admin sessions subscribed to it. Lines are
+/// buffered per subscriber (up to tail_buffer_size) and sent from separate thread, when subscriber
+/// is slow its buffer fills up and further lines are dropped (and counted) so dispatch never waits
+///
+class LiveTail final : NonCopyable
+{
+public:
+    static const std::size_t MAX_SUBSCRIBERS;
+
+    // lines are kept in buffer while session has this many responses waiting to be sent
+    static const std::size_t MAX_PENDING_WRITES;
+
+    static const unsigned int FLUSH_INTERVAL_MS;
+
+    struct SubscriberInfo
+    {
+        std::string loggerId;
+        std::string sessionId;
+        std::string clientId;
+        std::string levels;
+        std::size_t buffered;
+        std::uint64_t sent;
+        std::uint64_t dropped;
+    };
+
+    explicit LiveTail(Registry* registry);
+    ~LiveTail();
+
+    ///
+    /// \brief Subscribes session to lines of logger, optionally only for levels and lines from client.
+    /// Session is responded with "Subscribed to [<logger>]" followed by lines. Subscription ends when session is closed
+    /// \param levels Lowercase level names, empty for all
+    ///
+    bool subscribe(const std::string& loggerId, const std::set<std::string>& levels, const std::string& clientId,
+                   const std::shared_ptr<Session>& session, std::string* errorText);
+
+    inline bool hasSubscribers() const
+    {
+        return m_subscriberCount.load(std::memory_order_relaxed) > 0;
+    }
+
+    ///
+    /// \brief Called by dispatcher for every line, never blocks on subscribers
+    /// \param clientId Empty for lines that are not from client (e.g, residue logger)
+    ///
+    void publish(const std::string& loggerId, el::Level level, const std::string& clientId, const std::string& line);
+
+    std::vector<SubscriberInfo> subscribers();
+
+private:
+    struct Subscriber
+    {
+        std::string loggerId;
+        std::set<el::Level> levels;
+        std::string clientId;
+        std::weak_ptr<Session> session;
+        std::string sessionId;
+        std::size_t capacity;
+
+        std::mutex mutex;
+        std::deque<std::string> lines;
+        // dropped since last flush, subscriber is told about them with next lines
+        std::size_t recentlyDropped;
+
+        std::atomic<std::uint64_t> sent;
+        std::atomic<std::uint64_t> dropped;
+    };
+
+    Registry* m_registry;
+
+    // logger ID => its subscribers
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Subscriber>>> m_subscribers;
+    std::mutex m_mutex;
+    std::atomic<std::size_t> m_subscriberCount;
+
+    std::thread m_flusher;
+    std::mutex m_flushMutex;
+    std::condition_variable m_flushCv;
+    std::atomic<bool> m_running;
+
+    void flush();
+    void unsubscribe(const std::shared_ptr<Subscriber>& subscriber);
+};
+}
+#endif /* LiveTail_h */
@@ -19,10 +19,12 @@
 
 #include "logging/log-request-handler.h"
 
+#include "core/client.h"
 #include "core/configuration.h"
 #include "logging/client-queue-processor.h"
 #include "logging/log.h"
 #include "logging/log-request.h"
+#include "net/session.h"
 
 using namespace residue;
 
@@ -86,23 +88,76 @@ void LogRequestHandler::handle(RawRequest&& rawRequest)
     // bad request
     if ((!request.isValid() && !request.isBulk())
             || request.statusCode() == Request::StatusCode::BAD_REQUEST) {
-        rawRequest.session->writeStandardResponse(Response::StatusCode::BAD_REQUEST);
+        rawRequest.session->acknowledge(Response::StatusCode::BAD_REQUEST);
         return;
     }
 
     if (request.client() == nullptr) {
         // no way we are able to process this request
-        rawRequest.session->writeStandardResponse(Response::StatusCode::INVALID_CLIENT);
+        rawRequest.session->acknowledge(Response::StatusCode::INVALID_CLIENT);
     } else {
-        rawRequest.session->writeStandardResponse(Response::StatusCode::OK);
+        if (!rawRequest.session->hasAckMode()) {
+            // acknowledgement mode is fixed for the connection from its first log request
+            const Client* client = request.client().get();
+            rawRequest.session->setAckMode(client->ackMode(), client->ackEvery(), client->ackIntervalMs());
+        }
+        rawRequest.session->acknowledge(Response::StatusCode::OK);
 
         // we do not queue up decrypted request here as it gets messy
         // with all the copy constructors and move constructors.
         // Processors run on different thread so it's OK to decrypt it second time
-        if (!request.client()->isManaged()) {
-            m_queueProcessor.find(Configuration::UNMANAGED_CLIENT_ID)->second->handle(std::move(rawRequest));
-        } else {
-            m_queueProcessor.find(request.client()->id())->second->handle(std::move(rawRequest));
+        ClientQueueProcessor* processor = request.client()->isManaged()
+                ? m_queueProcessor.find(request.client()->id())->second.get()
+                : m_queueProcessor.find(Configuration::UNMANAGED_CLIENT_ID)->second.get();
+        std::shared_ptr<Session> session = rawRequest.session;
+        rawRequest.client = request.client();
+        processor->handle(std::move(rawRequest));
+        if (processor->isOverloaded()) {
+            // stop reading from this session until processor catches up,
+            // kernel then throttles the client via TCP window
+            processor->pauseSession(session);
         }
     }
 }
+
+LogRequestHandler::DatagramStatus LogRequestHandler::handleDatagram(RawRequest&& rawRequest)
+{
+    LogRequest request(m_registry->configuration());
+    RequestHandler::handleWithCopy(rawRequest, &request, Request::StatusCode::BAD_REQUEST,
+                           false, false, m_registry->configuration()->hasFlag(Configuration::Flag::COMPRESSION));
+
+    if ((!request.isValid() && !request.isBulk())
+            || request.statusCode() != Request::StatusCode::OK
+            || request.client() == nullptr) {
+        return DatagramStatus::MALFORMED;
+    }
+
+    ClientQueueProcessor* processor = request.client()->isManaged()
+            ? m_queueProcessor.find(request.client()->id())->second.get()
+            : m_queueProcessor.find(Configuration::UNMANAGED_CLIENT_ID)->second.get();
+    if (processor->isOverloaded()) {
+        return DatagramStatus::DROPPED;
+    }
+    rawRequest.client = request.client();
+    processor->handle(std::move(rawRequest));
+    return DatagramStatus::QUEUED;
+}
+
+void LogRequestHandler::attachRing(const std::shared_ptr<Client>& client, std::unique_ptr<ShmRing>&& ring)
+{
+    auto pos = m_queueProcessor.find(client->isManaged() ? client->id() : Configuration::UNMANAGED_CLIENT_ID);
+    if (pos != m_queueProcessor.end()) {
+        pos->second->attachRing(std::move(ring));
+    }
+}
+
+void LogRequestHandler::detachRings(const std::string& clientId)
+{
+    auto pos = m_queueProcessor.find(clientId);
+    if (pos == m_queueProcessor.end()) {
+        pos = m_queueProcessor.find(Configuration::UNMANAGED_CLIENT_ID);
+    }
+    if (pos != m_queueProcessor.end()) {
+        pos->second->detachRings(clientId);
+    }
+}
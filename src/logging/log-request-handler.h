@@ -28,6 +28,9 @@
 
 namespace residue {
 
+class Client;
+class ShmRing;
+
 ///
 /// \brief Handles incoming requests and passes it to correct queue processor
 ///
@@ -49,7 +52,35 @@ public:
     ///
     void addMissingClientProcessors();
 
+    ///
+    /// \brief Result of handling datagram (see handleDatagram())
+    ///
+    enum class DatagramStatus : unsigned short
+    {
+        QUEUED = 0,
+        MALFORMED = 1,
+        DROPPED = 2
+    };
+
     virtual void handle(RawRequest&&);
+
+    ///
+    /// \brief Handles log request received as datagram. Datagrams have no session so
+    /// nothing is responded to, and they are dropped (not paused) if queue is full.
+    /// Only encrypted requests from known clients are accepted
+    ///
+    DatagramStatus handleDatagram(RawRequest&&);
+
+    ///
+    /// \brief Attaches shared memory ring as another source of raw requests
+    /// for processor of the client
+    ///
+    void attachRing(const std::shared_ptr<Client>& client, std::unique_ptr<ShmRing>&& ring);
+
+    ///
+    /// \brief Detaches rings of the client, called when client is removed
+    ///
+    void detachRings(const std::string& clientId);
 private:
     std::unordered_map<std::string, std::unique_ptr<ClientQueueProcessor>> m_queueProcessor;
 
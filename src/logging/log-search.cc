@@ -0,0 +1,619 @@
+//
+//  log-search.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "logging/log-search.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <regex>
+
+#include "core/configuration.h"
+#include "core/registry.h"
+#include "logging/log.h"
+#include "logging/residue-log-dispatcher.h"
+#include "tasks/archive-retention.h"
+#include "tasks/log-segmenter.h"
+#include "utils/archive-index.h"
+#include "utils/bloom-filter.h"
+#include "utils/utils.h"
+
+using namespace residue;
+
+const std::size_t LogSearch::CHUNK_SIZE = 4 * 1024 * 1024; // 4MB
+const std::size_t LogSearch::MAX_ACTIVE_SEARCHES = 4;
+const std::size_t LogSearch::DEFAULT_MAX_RESULTS = 1000;
+const std::size_t LogSearch::MAX_RESULTS_LIMIT = 100000;
+const std::size_t LogSearch::MAX_REGEX_LENGTH = 256;
+const std::size_t LogSearch::MAX_REGEX_LINE_LENGTH = 4096;
+
+static const std::size_t kReadBlockSize = 64 * 1024;
+
+struct LogSearch::Search
+{
+    Query query;
+    std::unique_ptr<std::regex> regex;
+    // hashes of tokens that line must have for text to match (see BloomFilter)
+    std::vector<std::uint64_t> tokens;
+    // as written by %level, e.g, INFO
+    std::vector<std::string> levelNames;
+    std::vector<Chunk> chunks;
+    Output output;
+    Done done;
+    std::chrono::steady_clock::time_point started;
+    std::atomic<bool> stopped;
+    std::atomic<std::size_t> bytesScanned;
+    std::atomic<std::size_t> skippedChunks;
+
+    std::mutex mutex;
+    // matches of chunks that finished before the chunks prior to them
+    std::vector<std::string> results;
+    std::vector<bool> finished;
+    std::size_t nextToOutput;
+    std::size_t remaining;
+    Summary summary;
+
+    bool containsText(const char* line, std::size_t len) const
+    {
+        const char* end = line + len;
+        const char* pos = std::search(line, end, query.text.begin(), query.text.end());
+        if (!query.isWord) {
+            return pos != end;
+        }
+        // text that starts (or ends) with separator is bounded on that side already
+        const bool boundedStart = BloomFilter::isSeparator(query.text.front());
+        const bool boundedEnd = BloomFilter::isSeparator(query.text.back());
+        while (pos != end) {
+            const char* after = pos + query.text.size();
+            if ((boundedStart || pos == line || BloomFilter::isSeparator(*(pos - 1)))
+                    && (boundedEnd || after == end || BloomFilter::isSeparator(*after))) {
+                return true;
+            }
+            pos = std::search(pos + 1, end, query.text.begin(), query.text.end());
+        }
+        return false;
+    }
+
+    bool matches(const char* line, std::size_t len) const
+    {
+        if (!query.text.empty() && regex == nullptr && !containsText(line, len)) {
+            return false;
+        }
+        if (!levelNames.empty() && !LogSearch::hasLevel(std::string(line, len), levelNames)) {
+            return false;
+        }
+        return regex == nullptr || std::regex_search(line, line + std::min(len, MAX_REGEX_LINE_LENGTH), *regex);
+    }
+};
+
+LogSearch::LogSearch(Registry* registry) :
+    m_registry(registry),
+    m_running(true),
+    m_activeSearches(0)
+{
+    const unsigned int threads = registry->configuration()->searchThreads();
+    for (unsigned int i = 0; i < threads; ++i) {
+        m_workers.push_back(std::thread([&]() {
+            el::Helpers::setThreadName("LogSearch");
+            // search must not starve request handlers and dispatch
+            Utils::lowerCurrentThreadPriority(static_cast<int>(m_registry->configuration()->archiveNice()));
+            work();
+        }));
+    }
+}
+
+LogSearch::~LogSearch()
+{
+    {
+        std::lock_guard<std::mutex> lock_(m_jobsMutex);
+        m_running = false;
+    }
+    m_jobsCv.notify_all();
+    for (auto& t : m_workers) {
+        t.join();
+    }
+    // chunks that were not scanned are finished (without scanning) so done is
+    // still called for their searches and callers blocked in run() return
+    for (auto& job : m_jobs) {
+        job.search->stopped = true;
+        scan(job.search, job.index);
+    }
+    m_jobs.clear();
+}
+
+bool LogSearch::hasLevel(const std::string& line, const std::vector<std::string>& levelNames)
+{
+    auto isWordChar = [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    };
+    for (const auto& name : levelNames) {
+        std::size_t pos = line.find(name);
+        while (pos != std::string::npos) {
+            const std::size_t end = pos + name.size();
+            if ((pos == 0 || !isWordChar(line[pos - 1])) && (end == line.size() || !isWordChar(line[end]))) {
+                return true;
+            }
+            pos = line.find(name, pos + 1);
+        }
+    }
+    return false;
+}
+
+void LogSearch::work()
+{
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock_(m_jobsMutex);
+            m_jobsCv.wait(lock_, [&]() { return !m_running || !m_jobs.empty(); });
+            if (!m_running) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        scan(job.search, job.index);
+    }
+}
+
+std::vector<LogSearch::Chunk> LogSearch::buildChunks(const Query& query, const std::vector<std::uint64_t>& tokens,
+                                                     std::size_t* unindexedArchives, std::size_t* skippedChunks) const
+{
+    std::vector<Chunk> chunks;
+    // filters are only read when there are tokens to look for
+    auto bloomFilename = [&](const std::string& filename) -> std::string {
+        std::string bloomFilename = BloomFilter::filterFilename(filename);
+        return !tokens.empty() && Utils::fileExists(bloomFilename.c_str()) ? bloomFilename : "";
+    };
+    auto addFile = [&](const std::string& filename, std::size_t size, const std::string& bloomFilename) {
+        for (std::size_t offset = 0; offset < size; offset += CHUNK_SIZE) {
+            chunks.push_back({ filename, false, false, offset, 0, 0, std::min(CHUNK_SIZE, size - offset), bloomFilename, 0 });
+        }
+    };
+
+    // oldest first, i.e, archives, closed segments and then live file
+    if (m_registry->archiveRetention() != nullptr) {
+        for (const auto& archive : m_registry->archiveRetention()->archives(query.loggerId)) {
+            std::vector<ArchiveFrame> frames;
+            if (!ArchiveIndex::read(archive.filename, &frames)) {
+                ++*unindexedArchives;
+                continue;
+            }
+            const bool zstd = Utils::compressedArchiveFormat(archive.filename) == Utils::ArchiveFormat::TarZstd;
+            const std::string archiveBloomFilename = bloomFilename(archive.filename);
+            for (const auto& frame : frames) {
+                if (ArchiveIndex::overlaps(frame, query.from, query.to)) {
+                    chunks.push_back({ archive.filename, true, zstd, frame.offset, frame.size, frame.skip, frame.length,
+                                       archiveBloomFilename, frame.offset });
+                }
+            }
+        }
+    }
+
+    el::Logger* logger = el::Loggers::getLogger(query.loggerId, false);
+    if (logger == nullptr) {
+        return chunks;
+    }
+    std::vector<std::string> filenames;
+    {
+        std::lock_guard<std::recursive_mutex> l(logger->lock());
+        el::base::type::EnumType lIndex = el::LevelHelper::kMinValid;
+        el::LevelHelper::forEachLevel(&lIndex, [&](void) -> bool {
+            el::Level level = el::LevelHelper::castFromInt(lIndex);
+            std::string levelName(el::LevelHelper::convertToString(level));
+            if (query.levels.empty() || query.levels.find(Utils::toLower(levelName)) != query.levels.end()) {
+                const std::string& filename = logger->typedConfigurations()->filename(level);
+                if (std::find(filenames.begin(), filenames.end(), filename) == filenames.end()) {
+                    filenames.push_back(filename);
+                }
+            }
+            return false;
+        });
+    }
+    ResidueLogDispatcher* dispatcher = el::Helpers::logDispatchCallback<ResidueLogDispatcher>("ResidueLogDispatcher");
+    for (const auto& filename : filenames) {
+        if (m_registry->logSegmenter() != nullptr) {
+            for (const auto& segment : m_registry->logSegmenter()->segments(filename)) {
+                ArchiveFrame range { "", 0, 0, 0, 0, segment.from, segment.to, "" };
+                if (!ArchiveIndex::overlaps(range, query.from, query.to)) {
+                    continue;
+                }
+                // filter is named after segment whether it is compressed or not
+                const std::string segmentBloomFilename = bloomFilename(segment.filename);
+                if (segment.compressedFilename.empty()) {
+                    long size = Utils::fileSize(segment.filename.c_str());
+                    if (size > 0) {
+                        addFile(segment.filename, static_cast<std::size_t>(size), segmentBloomFilename);
+                    }
+                } else {
+                    long size = Utils::fileSize(segment.compressedFilename.c_str());
+                    if (size > 0) {
+                        chunks.push_back({ segment.compressedFilename, true,
+                                           segment.format == Utils::ArchiveFormat::TarZstd,
+                                           0, static_cast<std::size_t>(size), 0, segment.size,
+                                           segmentBloomFilename, 0 });
+                    }
+                }
+            }
+        }
+        struct stat st;
+        bool mayContain = true;
+        {
+            // filter of live file is kept by dispatcher, checked under logger's lock so it
+            // has tokens of all the lines up to the size
+            std::lock_guard<std::recursive_mutex> l(logger->lock());
+            if (::stat(filename.c_str(), &st) != 0 || st.st_size == 0
+                    || (query.from > 0 && static_cast<types::Time>(st.st_mtime) < query.from)) {
+                continue;
+            }
+            if (!tokens.empty() && dispatcher != nullptr) {
+                mayContain = dispatcher->mayContainTokens(filename, tokens);
+            }
+        }
+        if (!mayContain) {
+            *skippedChunks += (static_cast<std::size_t>(st.st_size) + CHUNK_SIZE - 1) / CHUNK_SIZE;
+            continue;
+        }
+        addFile(filename, static_cast<std::size_t>(st.st_size), "");
+    }
+    return chunks;
+}
+
+bool LogSearch::submit(const Query& q, const Output& output, const Done& done, std::string* errorText)
+{
+    if (el::Loggers::getLogger(q.loggerId, false) == nullptr) {
+        *errorText = "Logger [" + q.loggerId + "] not yet registered";
+        return false;
+    }
+    std::shared_ptr<Search> search = std::make_shared<Search>();
+    search->query = q;
+    Query& query = search->query;
+    if (query.maxResults == 0) {
+        query.maxResults = DEFAULT_MAX_RESULTS;
+    }
+    query.maxResults = std::min(query.maxResults, MAX_RESULTS_LIMIT);
+    for (const auto& levelStr : query.levels) {
+        el::Level level = el::LevelHelper::convertFromString(levelStr.c_str());
+        if (level == el::Level::Unknown) {
+            *errorText = "Unknown level [" + levelStr + "]";
+            return false;
+        }
+        search->levelNames.push_back(el::LevelHelper::convertToString(level));
+    }
+    if (query.isRegex && query.isWord) {
+        *errorText = "Whole word search is not supported with regular expression";
+        return false;
+    }
+    if (!query.isRegex && !query.text.empty()) {
+        BloomFilter::tokenize(query.text.data(), query.text.size(), [&](const char* token, std::size_t len) {
+            // unless whole words are searched, tokens at either end of text may be part of longer words
+            const std::size_t pos = static_cast<std::size_t>(token - query.text.data());
+            if (query.isWord || (pos > 0 && pos + len < query.text.size())) {
+                search->tokens.push_back(BloomFilter::hash(token, len));
+            }
+        });
+    }
+    if (query.isRegex && !query.text.empty()) {
+        if (query.text.size() > MAX_REGEX_LENGTH) {
+            *errorText = "Regular expression is too long (maximum " + std::to_string(MAX_REGEX_LENGTH) + " characters)";
+            return false;
+        }
+        if (!isSafeRegex(query.text, errorText)) {
+            return false;
+        }
+        try {
+            search->regex = std::unique_ptr<std::regex>(new std::regex(query.text, std::regex::optimize | std::regex::nosubs));
+        } catch (const std::regex_error& e) {
+            *errorText = std::string("Invalid regular expression: ") + e.what();
+            return false;
+        }
+    }
+    if (m_activeSearches.fetch_add(1) >= MAX_ACTIVE_SEARCHES) {
+        --m_activeSearches;
+        *errorText = "Too many searches running, please try later";
+        return false;
+    }
+
+    search->output = output;
+    search->done = done;
+    search->started = std::chrono::steady_clock::now();
+    search->stopped = false;
+    search->bytesScanned = 0;
+    search->nextToOutput = 0;
+    std::memset(&search->summary, 0, sizeof(search->summary));
+    std::size_t skippedChunks = 0;
+    search->chunks = buildChunks(query, search->tokens, &search->summary.unindexedArchives, &skippedChunks);
+    search->skippedChunks = skippedChunks;
+    search->summary.chunks = search->chunks.size() + skippedChunks;
+    search->summary.skippedChunks = skippedChunks;
+    search->results.resize(search->chunks.size());
+    search->finished.resize(search->chunks.size(), false);
+    search->remaining = search->chunks.size();
+
+    RVLOG(RV_INFO) << "Searching [" << query.loggerId << "] in " << search->chunks.size() << " chunk(s)";
+
+    if (search->chunks.empty()) {
+        --m_activeSearches;
+        done(search->summary);
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock_(m_jobsMutex);
+        for (std::size_t i = 0; i < search->chunks.size(); ++i) {
+            m_jobs.push_back({ search, i });
+        }
+    }
+    m_jobsCv.notify_all();
+    return true;
+}
+
+bool LogSearch::run(const Query& query, const Output& output, Summary* summary, std::string* errorText)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool finished = false;
+    if (!submit(query, output, [&](const Summary& s) {
+                std::lock_guard<std::mutex> lock_(mutex);
+                *summary = s;
+                finished = true;
+                cv.notify_one();
+            }, errorText)) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock_(mutex);
+    cv.wait(lock_, [&]() { return finished; });
+    return true;
+}
+
+void LogSearch::scan(const std::shared_ptr<Search>& search, std::size_t index)
+{
+    if (search->stopped) {
+        finish(search, index, "", false);
+        return;
+    }
+    const Chunk& chunk = search->chunks[index];
+    if (!chunk.bloomFilename.empty()) {
+        BloomFilter filter;
+        // chunk is scanned if filter cannot be read
+        if (BloomFilter::read(chunk.bloomFilename, chunk.bloomKey, &filter) && !filter.mayContainAll(search->tokens)) {
+            ++search->skippedChunks;
+            finish(search, index, "", false);
+            return;
+        }
+    }
+    std::string matches;
+    std::size_t count = 0;
+    std::string carry;
+
+    auto onLine = [&](const char* line, std::size_t len) -> bool {
+        if (search->matches(line, len)) {
+            matches.append(line, len).push_back('\n');
+            if (++count >= search->query.maxResults) {
+                return false;
+            }
+        }
+        return !search->stopped;
+    };
+    // splits data in to lines, partial line is carried to next call
+    auto feed = [&](const char* data, std::size_t len) -> bool {
+        search->bytesScanned += len;
+        std::size_t start = 0;
+        while (start < len) {
+            const char* nl = static_cast<const char*>(std::memchr(data + start, '\n', len - start));
+            if (nl == nullptr) {
+                carry.append(data + start, len - start);
+                break;
+            }
+            const std::size_t end = static_cast<std::size_t>(nl - data);
+            bool cont;
+            if (carry.empty()) {
+                cont = onLine(data + start, end - start);
+            } else {
+                carry.append(data + start, end - start);
+                cont = onLine(carry.data(), carry.size());
+                carry.clear();
+            }
+            if (!cont) {
+                return false;
+            }
+            start = end + 1;
+        }
+        return true;
+    };
+
+    bool failed = false;
+    bool stopped = false;
+    if (chunk.compressed) {
+        std::FILE* in = std::fopen(chunk.filename.c_str(), "rb");
+        if (in == nullptr) {
+            failed = true;
+        } else {
+            ArchiveFrame frame { "", chunk.offset, chunk.size, chunk.skip, chunk.length, 0, 0, "" };
+            failed = !ArchiveIndex::readFrame(in, frame, chunk.zstd, [&](const char* data, std::size_t len) -> bool {
+                stopped = !feed(data, len);
+                return !stopped;
+            });
+            std::fclose(in);
+        }
+    } else {
+        // lines that start in [offset, offset + length) belong to this chunk
+        int fd = ::open(chunk.filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            failed = true;
+        } else {
+            const std::size_t end = chunk.offset + chunk.length;
+            std::size_t pos = chunk.offset;
+            char prev = '\n';
+            bool skipping = chunk.offset > 0 && ::pread(fd, &prev, 1, static_cast<off_t>(chunk.offset - 1)) == 1 && prev != '\n';
+            std::vector<char> buffer(kReadBlockSize);
+            while (!stopped) {
+                ssize_t n = ::pread(fd, buffer.data(), buffer.size(), static_cast<off_t>(pos));
+                if (n < 0) {
+                    failed = true;
+                    break;
+                }
+                if (n == 0) {
+                    break;
+                }
+                const char* data = buffer.data();
+                std::size_t len = static_cast<std::size_t>(n);
+                pos += len;
+                if (skipping) {
+                    // rest of line that previous chunk owns
+                    const char* nl = static_cast<const char*>(std::memchr(data, '\n', len));
+                    if (nl == nullptr) {
+                        if (pos >= end) {
+                            break;
+                        }
+                        continue;
+                    }
+                    len -= static_cast<std::size_t>(nl - data) + 1;
+                    data = nl + 1;
+                    skipping = false;
+                }
+                const std::size_t dataStart = pos - len;
+                if (dataStart >= end) {
+                    if (carry.empty()) {
+                        // next line starts in next chunk
+                        break;
+                    }
+                    // complete the line that started before end
+                    const char* nl = static_cast<const char*>(std::memchr(data, '\n', len));
+                    if (nl != nullptr) {
+                        feed(data, static_cast<std::size_t>(nl - data) + 1);
+                        break;
+                    }
+                } else if (pos > end) {
+                    // last line that starts before end ends at first new line from there
+                    const std::size_t limit = end - dataStart;
+                    const char* nl = static_cast<const char*>(std::memchr(data + limit - 1, '\n', len - limit + 1));
+                    if (nl != nullptr) {
+                        feed(data, static_cast<std::size_t>(nl - data) + 1);
+                        break;
+                    }
+                }
+                stopped = !feed(data, len);
+            }
+            ::close(fd);
+        }
+    }
+    if (!stopped && !carry.empty()) {
+        // last line without new line
+        std::string line;
+        line.swap(carry);
+        onLine(line.data(), line.size());
+    }
+    finish(search, index, std::move(matches), failed);
+}
+
+bool LogSearch::isSafeRegex(const std::string& pattern, std::string* errorText)
+{
+    auto isRepetition = [](char c) {
+        return c == '*' || c == '+' || c == '{';
+    };
+    // whether each open group has repetition or alternation in it
+    std::vector<bool> groups;
+    bool inClass = false;
+    for (std::size_t i = 0; i < pattern.size(); ++i) {
+        const char c = pattern[i];
+        if (c == '\\') {
+            if (i + 1 < pattern.size() && pattern[i + 1] >= '1' && pattern[i + 1] <= '9') {
+                *errorText = "Back references are not supported in regular expression";
+                return false;
+            }
+            ++i;
+        } else if (inClass) {
+            inClass = c != ']';
+        } else if (c == '[') {
+            inClass = true;
+        } else if (c == '(') {
+            groups.push_back(false);
+        } else if (c == ')' && !groups.empty()) {
+            const bool inner = groups.back();
+            const bool repeated = i + 1 < pattern.size() && isRepetition(pattern[i + 1]);
+            groups.pop_back();
+            if (inner && repeated) {
+                *errorText = "Nested repetition (e.g, (a+)+ or (a|b)*) is not supported in regular expression";
+                return false;
+            }
+            if ((inner || repeated) && !groups.empty()) {
+                groups.back() = true;
+            }
+        } else if ((isRepetition(c) || c == '|') && !groups.empty()) {
+            groups.back() = true;
+        }
+    }
+    return true;
+}
+
+void LogSearch::finish(const std::shared_ptr<Search>& search, std::size_t index, std::string&& matches, bool failed)
+{
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock_(search->mutex);
+        search->results[index] = std::move(matches);
+        search->finished[index] = true;
+        if (failed) {
+            ++search->summary.failedChunks;
+        }
+        // output in file order
+        Summary& summary = search->summary;
+        while (search->nextToOutput < search->chunks.size() && search->finished[search->nextToOutput]) {
+            std::string result;
+            result.swap(search->results[search->nextToOutput++]);
+            if (search->stopped || result.empty()) {
+                continue;
+            }
+            std::size_t allowed = search->query.maxResults - summary.matches;
+            std::size_t lines = 0;
+            std::size_t cut = 0;
+            while (cut < result.size() && lines < allowed) {
+                cut = result.find('\n', cut) + 1;
+                ++lines;
+            }
+            result.resize(cut);
+            summary.matches += lines;
+            if (summary.matches >= search->query.maxResults) {
+                summary.truncated = true;
+                search->stopped = true;
+            }
+            if (!search->output(result)) {
+                search->stopped = true;
+            }
+        }
+        last = --search->remaining == 0;
+    }
+    if (last) {
+        Summary& summary = search->summary;
+        summary.bytesScanned = search->bytesScanned;
+        summary.skippedChunks = search->skippedChunks;
+        summary.elapsedMs = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                  std::chrono::steady_clock::now() - search->started).count());
+        RVLOG(RV_INFO) << "Search on [" << search->query.loggerId << "] found " << summary.matches << " match(es) in "
+                       << summary.elapsedMs << "ms";
+        --m_activeSearches;
+        search->done(summary);
+    }
+}
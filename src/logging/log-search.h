@@ -0,0 +1,174 @@
+//
+//  log-search.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef LogSearch_h
+#define LogSearch_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/types.h"
+#include "non-copyable.h"
+
+namespace residue {
+
+class Registry;
+
+///
+/// \brief Searches logs of a logger in live files, closed segments (see LogSegmenter) and indexed
+/// archives (see ArchiveIndex). Files are split in to chunks that are scanned on bounded pool of
+/// search_threads, separate from dispatch and tasks. Chunks that have bloom filter (see bloom_filter_size)
+/// without the tokens of the text are skipped. Matches are passed back in file order
+///
+class LogSearch final : NonCopyable
+{
+public:
+    // live files are scanned in chunks of this many bytes
+    static const std::size_t CHUNK_SIZE;
+
+    // searches running at the same time, further searches are refused
+    static const std::size_t MAX_ACTIVE_SEARCHES;
+
+    static const std::size_t DEFAULT_MAX_RESULTS;
+    static const std::size_t MAX_RESULTS_LIMIT;
+
+    // regular expressions longer than this are refused
+    static const std::size_t MAX_REGEX_LENGTH;
+
+    // only this many bytes of each line are matched against regular expression, std::regex
+    // recurses for each character so longer lines could overflow the stack of search thread
+    static const std::size_t MAX_REGEX_LINE_LENGTH;
+
+    struct Query
+    {
+        std::string loggerId;
+        // 0 for unbounded, time range is checked against segments and archive frames (not lines)
+        types::Time from;
+        types::Time to;
+        // lowercase level names (e.g, info), empty for all
+        std::set<std::string> levels;
+        // substring (or regular expression with isRegex) to look for, empty matches all lines
+        std::string text;
+        bool isRegex;
+        // text only matches as whole words (bounded by whitespace or punctuation), so
+        // all of its tokens can be checked against bloom filters
+        bool isWord;
+        std::size_t maxResults;
+    };
+
+    struct Summary
+    {
+        std::size_t matches;
+        bool truncated;
+        std::size_t chunks;
+        // chunks (out of total chunks) that bloom filter ruled out
+        std::size_t skippedChunks;
+        std::size_t bytesScanned;
+        // archives without index (not segmented) are not searched
+        std::size_t unindexedArchives;
+        std::size_t failedChunks;
+        long elapsedMs;
+    };
+
+    ///
+    /// \brief Receives matched lines (each ending with new line), returns false to stop search
+    ///
+    using Output = std::function<bool(const std::string&)>;
+    using Done = std::function<void(const Summary&)>;
+
+    explicit LogSearch(Registry* registry);
+    ~LogSearch();
+
+    ///
+    /// \brief Queues search, output and done are called from search threads
+    /// \param errorText Reason if search was not queued
+    /// \return False if query is invalid or too many searches are running
+    ///
+    bool submit(const Query& query, const Output& output, const Done& done, std::string* errorText);
+
+    ///
+    /// \brief Same as submit() but blocks until search is done
+    ///
+    bool run(const Query& query, const Output& output, Summary* summary, std::string* errorText);
+
+    ///
+    /// \brief Whether line contains one of the level names as separate word (as written by %level)
+    ///
+    static bool hasLevel(const std::string& line, const std::vector<std::string>& levelNames);
+
+private:
+    struct Chunk
+    {
+        std::string filename;
+        bool compressed;
+        bool zstd;
+        // compressed: frame in file (offset, size, skip and length)
+        // otherwise: byte range [offset, offset + length)
+        std::size_t offset;
+        std::size_t size;
+        std::size_t skip;
+        std::size_t length;
+        // empty if chunk has no bloom filter
+        std::string bloomFilename;
+        std::size_t bloomKey;
+    };
+
+    struct Search;
+
+    ///
+    /// \brief Chunk of search waiting to be scanned
+    ///
+    struct Job
+    {
+        std::shared_ptr<Search> search;
+        std::size_t index;
+    };
+
+    Registry* m_registry;
+    std::vector<std::thread> m_workers;
+    std::deque<Job> m_jobs;
+    std::mutex m_jobsMutex;
+    std::condition_variable m_jobsCv;
+    std::atomic<bool> m_running;
+    std::atomic<std::size_t> m_activeSearches;
+
+    std::vector<Chunk> buildChunks(const Query& query, const std::vector<std::uint64_t>& tokens,
+                                   std::size_t* unindexedArchives, std::size_t* skippedChunks) const;
+    void scan(const std::shared_ptr<Search>& search, std::size_t index);
+    void finish(const std::shared_ptr<Search>& search, std::size_t index, std::string&& matches, bool failed);
+
+    ///
+    /// \brief Checks regular expression can be run by backtracking engine (std::regex) in reasonable
+    /// time, i.e, it has no back references and no repeated group that itself has repetition or
+    /// alternation (e.g, (a+)+ or (a|ab)*) which take exponential time
+    ///
+    static bool isSafeRegex(const std::string& pattern, std::string* errorText);
+    void work();
+};
+}
+#endif /* LogSearch_h */
@@ -23,7 +23,8 @@ using namespace residue;
 
 LoggingQueue::LoggingQueue() :
     m_backlogQueue(&m_queue1),
-    m_dispatchQueue(&m_queue2)
+    m_dispatchQueue(&m_queue2),
+    m_depth(0)
 {
 }
 
@@ -44,5 +45,6 @@ RawRequest LoggingQueue::pull()
 {
     RawRequest rawRequest = m_dispatchQueue->back();
     m_dispatchQueue->pop_back();
+    --m_depth;
     return std::move(rawRequest);
 }
@@ -20,6 +20,7 @@
 #ifndef LoggingQueue_h
 #define LoggingQueue_h
 
+#include <atomic>
 #include <deque>
 #include <mutex>
 
@@ -41,6 +42,7 @@ public:
     {
         std::lock_guard<std::mutex> lock(m_mutex);
         m_backlogQueue->push_front(std::move(rawRequest));
+        ++m_depth;
     }
 
     RawRequest pull();
@@ -65,6 +67,15 @@ public:
         return m_backlogQueue->size();
     }
 
+    ///
+    /// \brief Total number of requests waiting in both backlog and dispatch queue.
+    /// Safe to call from any thread
+    ///
+    inline std::size_t depth() const
+    {
+        return m_depth;
+    }
+
     void switchContext();
 
 private:
@@ -76,6 +87,8 @@ private:
 
     std::deque<RawRequest>* m_backlogQueue;
     std::deque<RawRequest>* m_dispatchQueue;
+
+    std::atomic<std::size_t> m_depth;
 };
 }
 #endif /* LoggingQueue_h */
@@ -21,16 +21,20 @@
 #define ResidueLogDispatcher_h
 
 #include <algorithm>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 
 #include "core/configuration.h"
 #include "extensions/log-extension.h"
 #include "extensions/dispatch-error-extension.h"
+#include "logging/live-tail.h"
 #include "logging/log.h"
 #include "logging/log-request.h"
 #include "logging/user-message.h"
 #include "non-copyable.h"
+#include "tasks/log-rotator.h"
+#include "utils/bloom-filter.h"
 #include "utils/utils.h"
 
 namespace residue {
@@ -54,7 +58,9 @@ public:
     };
 
     ResidueLogDispatcher() :
-        m_configuration(nullptr)
+        m_configuration(nullptr),
+        m_sizeLogRotator(nullptr),
+        m_liveTail(nullptr)
     {
     }
 
@@ -63,6 +69,77 @@ public:
         m_configuration = configuration;
     }
 
+    inline void setSizeLogRotator(SizeLogRotator* sizeLogRotator)
+    {
+        m_sizeLogRotator = sizeLogRotator;
+    }
+
+    inline void setLiveTail(LiveTail* liveTail)
+    {
+        m_liveTail = liveTail;
+    }
+
+    ///
+    /// \brief Forgets bytes written to the file, called once file is truncated (rotated)
+    ///
+    void resetWrittenBytes(const std::string& filename)
+    {
+        std::lock_guard<std::mutex> lock_(m_writtenBytesLock);
+        m_writtenBytes.erase(filename);
+    }
+
+    ///
+    /// \brief Allows files of the logger to request rotation again. Called once requested rotation
+    /// is done, whether or not it succeeded
+    ///
+    void clearRotationRequest(const std::string& loggerId)
+    {
+        std::lock_guard<std::mutex> lock_(m_writtenBytesLock);
+        for (auto& pair : m_writtenBytes) {
+            if (pair.second.loggerId == loggerId) {
+                pair.second.rotationRequested = false;
+            }
+        }
+    }
+
+    ///
+    /// \brief Takes bloom filter of tokens written to the file since it was opened (nullptr if it has none).
+    /// Called under logger's lock when file is swapped (rotated or segmented)
+    ///
+    std::shared_ptr<BloomFilter> takeBloomFilter(const std::string& filename)
+    {
+        std::lock_guard<std::mutex> lock_(m_bloomFiltersLock);
+        auto iter = m_bloomFilters.find(filename);
+        if (iter == m_bloomFilters.end()) {
+            return nullptr;
+        }
+        std::shared_ptr<BloomFilter> filter = std::move(iter->second);
+        m_bloomFilters.erase(iter);
+        return filter;
+    }
+
+    ///
+    /// \brief Live files have no bloom filter until they are swapped (rotated or segmented) again, as filters
+    /// would miss lines (e.g, if they were disabled and enabled again by configuration reload)
+    ///
+    void invalidateBloomFilters()
+    {
+        std::lock_guard<std::mutex> lock_(m_bloomFiltersLock);
+        for (auto& pair : m_bloomFilters) {
+            pair.second = nullptr;
+        }
+    }
+
+    ///
+    /// \brief Whether lines written to the file (since it was opened) may contain all the tokens, true if file has no filter
+    ///
+    bool mayContainTokens(const std::string& filename, const std::vector<std::uint64_t>& hashes)
+    {
+        std::lock_guard<std::mutex> lock_(m_bloomFiltersLock);
+        auto iter = m_bloomFilters.find(filename);
+        return iter == m_bloomFilters.end() || iter->second == nullptr || iter->second->mayContainAll(hashes);
+    }
+
     void handle(const el::LogDispatchData* data) override
     {
         el::LogDispatchCallback::handle(data);
@@ -91,6 +168,7 @@ public:
                             return;
                         }
                     }
+                    addToBloomFilter(data, fn, logLine);
                     fs->write(logLine.c_str(), logLine.size());
                     if (fs->fail()) {
                         RLOG_IF(logger->id() != RESIDUE_LOGGER_ID, ERROR)
@@ -125,6 +203,8 @@ public:
 
                         dispatchDynamicBuffer(fn, fs, logger);
 
+                        checkMaxFileSize(logger->id(), fn, logLine.size());
+
                         if (m_previouslyFailed && logger->id() != RESIDUE_LOGGER_ID) {
                             resetErrorExtensions(); // this resets m_previouslyFailed as well
                         }
@@ -137,6 +217,11 @@ public:
                              << logger->id() << "]";
                 }
             }
+            if (m_liveTail != nullptr && m_liveTail->hasSubscribers()) {
+                const std::string& clientId = logger->id() != RESIDUE_LOGGER_ID ?
+                            static_cast<const UserMessage*>(data->logMessage())->request()->clientId() : "";
+                m_liveTail->publish(logger->id(), level, clientId, logLine);
+            }
 #ifdef RESIDUE_HAS_EXTENSIONS
             if (data->logMessage()->logger()->id() != RESIDUE_LOGGER_ID) {
                 execLogExtensions(data, logLine, successfullyWritten);
@@ -148,7 +233,26 @@ public:
     }
 
 private:
+    ///
+    /// \brief Running count of bytes in the file since it was opened / truncated, so
+    /// max_file_size can be checked without stat'ing the file on every write
+    ///
+    struct WrittenBytes
+    {
+        std::size_t bytes;
+        bool rotationRequested;
+        std::string loggerId;
+    };
+
     Configuration* m_configuration;
+    SizeLogRotator* m_sizeLogRotator;
+    LiveTail* m_liveTail;
+    // map of filename -> WrittenBytes
+    std::unordered_map<std::string, WrittenBytes> m_writtenBytes;
+    std::mutex m_writtenBytesLock;
+    // map of filename -> BloomFilter, nullptr for files that had lines before filter
+    std::unordered_map<std::string, std::shared_ptr<BloomFilter>> m_bloomFilters;
+    std::mutex m_bloomFiltersLock;
     // map of filename -> FailedLogs
     std::unordered_map<std::string, FailedLogs> m_dynamicBuffer;
     std::recursive_mutex m_dynamicBufferLock;
@@ -156,6 +260,44 @@ private:
 
     friend class Stats;
 
+    ///
+    /// \brief Adds tokens of the line, client ID and thread of the request to bloom filter of the file
+    /// (if logger has bloom_filter_size). This is called before line is written
+    ///
+    void addToBloomFilter(const el::LogDispatchData* data, const std::string& filename, const std::string& logLine)
+    {
+        const std::string& loggerId = data->logMessage()->logger()->id();
+        if (loggerId == RESIDUE_LOGGER_ID || m_configuration->bloomFilterOptions().empty()) {
+            return;
+        }
+        const Configuration::BloomFilterOptions options = m_configuration->getBloomFilterOptions(loggerId);
+        if (options.size == 0) {
+            return;
+        }
+        // hashed before lock is taken
+        std::vector<std::uint64_t> hashes;
+        const LogRequest* request = static_cast<const UserMessage*>(data->logMessage())->request();
+        BloomFilter::hashTokens(logLine, &hashes);
+        BloomFilter::hashTokens(request->clientId(), &hashes);
+        BloomFilter::hashTokens(request->threadId(), &hashes);
+        BloomFilter::hashTokens(request->threadName(), &hashes);
+
+        std::lock_guard<std::mutex> lock_(m_bloomFiltersLock);
+        auto iter = m_bloomFilters.find(filename);
+        if (iter == m_bloomFilters.end()) {
+            // lines already in file (e.g, written by previous run) are not in the filter so
+            // file has no filter until it is rotated or segmented
+            std::shared_ptr<BloomFilter> filter;
+            if (Utils::fileSize(filename.c_str()) <= 0) {
+                filter = std::make_shared<BloomFilter>(options.size, options.falsePositiveRate);
+            }
+            iter = m_bloomFilters.insert(std::make_pair(filename, filter)).first;
+        }
+        if (iter->second != nullptr) {
+            iter->second->add(hashes);
+        }
+    }
+
     void execLogExtensions(const el::LogDispatchData* data,
                            const el::base::type::string_t& logLine,
                            bool successfullyWritten)
@@ -219,6 +361,36 @@ private:
         m_previouslyFailed = false;
     }
 
+    void checkMaxFileSize(const std::string& loggerId, const std::string& filename, std::size_t written)
+    {
+        if (m_sizeLogRotator == nullptr) {
+            return;
+        }
+        const std::size_t maxFileSize = m_configuration->getMaxFileSize(loggerId);
+        if (maxFileSize == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock_(m_writtenBytesLock);
+            auto iter = m_writtenBytes.find(filename);
+            if (iter == m_writtenBytes.end()) {
+                // first write since start up (or rotation), only time we look at the file
+                long existing = Utils::fileSize(filename.c_str());
+                iter = m_writtenBytes.insert(std::make_pair(filename, WrittenBytes {
+                                                                static_cast<std::size_t>(std::max(existing, 0L)),
+                                                                false,
+                                                                loggerId
+                                                            })).first;
+            }
+            iter->second.bytes += written;
+            if (iter->second.rotationRequested || iter->second.bytes < maxFileSize) {
+                return;
+            }
+            iter->second.rotationRequested = true;
+        }
+        m_sizeLogRotator->request(loggerId);
+    }
+
     void addToDynamicBuffer(el::Logger* logger, const std::string& filename, const std::string& logLine)
     {
         if (m_configuration->hasFlag(Configuration::ENABLE_DYNAMIC_BUFFER)
@@ -287,6 +459,7 @@ private:
             fs->close();
             fs->open(fn, std::ios::out);
             Utils::updateFilePermissions(fn.data(), logger, m_configuration);
+            resetWrittenBytes(fn);
             if (fs->fail() || !fs->is_open()) {
                 RLOG_IF(logger->id() != RESIDUE_LOGGER_ID, INFO)
                         << "Failed to access file [ " << fn << "]! " << std::strerror(errno);
@@ -41,15 +41,21 @@
 #include "core/residue-exception.h"
 #include "crash-handlers.h"
 #include "crypto/base64.h"
+#include "logging/live-tail.h"
 #include "logging/log-request-handler.h"
+#include "logging/log-search.h"
 #include "logging/log.h"
 #include "logging/residue-log-dispatcher.h"
 #include "logging/user-log-builder.h"
 #include "net/server.h"
+#include "net/udp-server.h"
 #include "setup.h"
 #include "tasks/auto-updater.h"
 #include "tasks/client-integrity-task.h"
+#include "tasks/archive-retention.h"
 #include "tasks/log-rotator.h"
+#include "tasks/log-segmenter.h"
+#include "tasks/task-scheduler.h"
 
 #ifdef RESIDUE_USE_MINE
 #   include "mine/mine.h"
@@ -235,6 +241,15 @@ int main(int argc, char* argv[])
         Registry registry(&config);
         CommandHandler commandHandler(&registry);
 
+        // searches (admin requests and CLI) run on their own bounded pool
+        LogSearch logSearch(&registry);
+        registry.setLogSearch(&logSearch);
+
+        // dispatched lines are fanned out to admin sessions that subscribed to them
+        LiveTail liveTail(&registry);
+        registry.setLiveTail(&liveTail);
+        el::Helpers::logDispatchCallback<ResidueLogDispatcher>("ResidueLogDispatcher")->setLiveTail(&liveTail);
+
         std::vector<std::thread> threads;
 
         // admin server
@@ -249,7 +264,7 @@ int main(int argc, char* argv[])
         threads.push_back(std::thread([&]() {
             el::Helpers::setThreadName("ConnectionHandler");
             ConnectionRequestHandler newConnectionRequestHandler(&registry);
-            Server svr(config.connectPort(), &newConnectionRequestHandler);
+            Server svr(config.connectPort(), &newConnectionRequestHandler, config.acceptorThreads(), config.connectSocket());
             svr.start();
         }));
 
@@ -259,55 +274,84 @@ int main(int argc, char* argv[])
             LogRequestHandler logRequestHandler(&registry);
             logRequestHandler.start(); // Start handling incoming requests
             registry.setLogRequestHandler(&logRequestHandler);
-            Server svr(config.loggingPort(), &logRequestHandler);
+            Server svr(config.loggingPort(), &logRequestHandler, config.acceptorThreads(), config.loggingSocket());
+            std::unique_ptr<UdpServer> udpServer;
+            std::thread udpThread;
+            if (config.loggingUdpPort() > 0) {
+                udpServer = std::unique_ptr<UdpServer>(new UdpServer(config.loggingUdpPort(), &logRequestHandler));
+                registry.setUdpServer(udpServer.get());
+                udpThread = std::thread([&]() {
+                    el::Helpers::setThreadName("UdpLogHandler");
+                    udpServer->start();
+                });
+            }
             svr.start();
+            if (udpThread.joinable()) {
+                udpThread.join();
+            }
         }));
 
-        // client integrity task
+        // tasks (client integrity, log rotators, log segmenter, archive retention and auto updater) share single
+        // scheduler with a worker for each task so long archiving does not hold up other tasks
         threads.push_back(std::thread([&]() {
-            el::Helpers::setThreadName("ClientIntegrityTask");
-            ClientIntegrityTask task(&registry, registry.configuration()->clientIntegrityTaskInterval());
-            registry.setClientIntegrityTask(&task);
-            task.start();
-        }));
+            el::Helpers::setThreadName("TaskScheduler");
+            TaskScheduler scheduler;
+
+            ClientIntegrityTask clientIntegrityTask(&registry, registry.configuration()->clientIntegrityTaskInterval());
+            registry.setClientIntegrityTask(&clientIntegrityTask);
+            scheduler.schedule(&clientIntegrityTask);
+
+            HourlyLogRotator hourlyLogRotator(&registry);
+            SixHoursLogRotator sixHoursLogRotator(&registry);
+            TwelveHoursLogRotator twelveHoursLogRotator(&registry);
+            DailyLogRotator dailyLogRotator(&registry);
+            WeeklyLogRotator weeklyLogRotator(&registry);
+            MonthlyLogRotator monthlyLogRotator(&registry);
+            YearlyLogRotator yearlyLogRotator(&registry);
+            for (LogRotator* rotator : std::vector<LogRotator*> { &hourlyLogRotator, &sixHoursLogRotator,
+                                                                  &twelveHoursLogRotator, &dailyLogRotator,
+                                                                  &weeklyLogRotator, &monthlyLogRotator,
+                                                                  &yearlyLogRotator }) {
+                registry.addLogRotator(rotator);
+                scheduler.schedule(rotator);
+            }
+
+            // closes and compresses segments of live logs so rotation only bundles them
+            LogSegmenter logSegmenter(&registry);
+            registry.setLogSegmenter(&logSegmenter);
+            scheduler.schedule(&logSegmenter);
 
-        // log rotator tasks
+            // archives created before start up are indexed once, rest are added as they are created
+            ArchiveRetention archiveRetention(&registry);
+            archiveRetention.rebuild();
+            registry.setArchiveRetention(&archiveRetention);
+            scheduler.schedule(&archiveRetention);
 
-#define START_LOG_ROTATOR(NAME)\
-        threads.push_back(std::thread([&]() {\
-            el::Helpers::setThreadName(#NAME);\
-            NAME rotator(&registry);\
-            registry.addLogRotator(&rotator);\
-            rotator.start();\
-        }))
+#ifndef RESIDUE_DEV
+            AutoUpdater autoUpdater(&registry, 86400); // run daily
+            registry.setAutoUpdater(&autoUpdater);
+            scheduler.schedule(&autoUpdater);
+#else
+            // AUTO UPDATER INACTIVE IN DEV MODE
+#endif
 
-        START_LOG_ROTATOR(HourlyLogRotator);
-        START_LOG_ROTATOR(SixHoursLogRotator);
-        START_LOG_ROTATOR(TwelveHoursLogRotator);
-        START_LOG_ROTATOR(DailyLogRotator);
-        START_LOG_ROTATOR(WeeklyLogRotator);
-        START_LOG_ROTATOR(MonthlyLogRotator);
-        START_LOG_ROTATOR(YearlyLogRotator);
+            registry.setTaskScheduler(&scheduler);
 
-#undef START_LOG_ROTATOR
+            // rotations for loggers that reach max_file_size are requested by dispatcher
+            // and run on size rotator's own thread
+            SizeLogRotator sizeLogRotator(&registry);
+            el::Helpers::logDispatchCallback<ResidueLogDispatcher>("ResidueLogDispatcher")->setSizeLogRotator(&sizeLogRotator);
 
 #ifndef RESIDUE_DEV
-        // auto updater
-        threads.push_back(std::thread([&]() {
-            el::Helpers::setThreadName("AutoUpdater");
-            AutoUpdater task(&registry, 86400); // run daily
-            registry.setAutoUpdater(&task);
             std::string newVer;
-            if (task.hasNewVersion(&newVer)) {
+            if (autoUpdater.hasNewVersion(&newVer)) {
                 std::cout << "A newer version " << newVer << " is available for download."
                           << " Please visit https://github.com/abumq/residue/releases/tag/" << newVer
                           << std::endl;
             }
-            task.start();
-        }));
-#else
-        // AUTO UPDATER INACTIVE IN DEV MODE
 #endif
+            scheduler.start();
+        }));
 
         if (registry.configuration()->hasFlag(Configuration::Flag::ENABLE_CLI)) {
             signal(SIGINT, interruptHandler); // SIGINT = interrupt
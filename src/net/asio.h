@@ -26,6 +26,9 @@ namespace net = boost::asio;
 namespace residue {
     using error_code = boost::system::error_code;
 }
+#   ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+#       define RESIDUE_HAS_LOCAL_SOCKETS
+#   endif
 #else
 #   include <system_error>
 #   include "asio.hpp"
@@ -33,6 +36,9 @@ namespace net = asio;
 namespace residue {
     using error_code = std::error_code;
 }
+#   ifdef ASIO_HAS_LOCAL_SOCKETS
+#       define RESIDUE_HAS_LOCAL_SOCKETS
+#   endif
 #endif // RESIDUE_BOOST
 
 #endif /* RESIDUE_ASIO_H */
@@ -19,10 +19,20 @@
 
 #include "net/server.h"
 
+#include <cerrno>
+#include <cstring>
 #include <thread>
 
+#ifdef RESIDUE_HAS_LOCAL_SOCKETS
+#   include <sys/socket.h>
+#   include <sys/stat.h>
+#   include <sys/types.h>
+#   include <unistd.h>
+#endif
+
 #include "net/asio.h"
 
+#include "core/configuration.h"
 #include "core/registry.h"
 #include "core/request-handler.h"
 #include "logging/log.h"
@@ -31,32 +41,151 @@
 using namespace residue;
 using net::ip::tcp;
 
-Server::Server(int port, RequestHandler* requestHandler) :
-    m_acceptor(m_ioService, tcp::endpoint(tcp::v4(), port)),
-    m_socket(m_ioService),
+#ifdef SO_REUSEPORT
+using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+Server::Server(int port, RequestHandler* requestHandler, unsigned int acceptors,
+               const std::string& socketPath) :
+    m_socketPath(socketPath),
     m_requestHandler(requestHandler)
 {
-    accept();
+#ifndef SO_REUSEPORT
+    if (acceptors > 1) {
+        RLOG(WARNING) << "SO_REUSEPORT is not supported on this platform, using single acceptor for port " << port;
+        acceptors = 1;
+    }
+#endif
+    if (acceptors == 0) {
+        acceptors = 1;
+    }
+    tcp::endpoint endpoint(tcp::v4(), port);
+    for (unsigned int i = 0; i < acceptors; ++i) {
+        std::unique_ptr<TcpListener> listener(new TcpListener);
+        listener->acceptor.open(endpoint.protocol());
+        listener->acceptor.set_option(tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+        if (acceptors > 1) {
+            listener->acceptor.set_option(reuse_port(true));
+        }
+#endif
+        listener->acceptor.bind(endpoint);
+        listener->acceptor.listen();
+        accept(listener.get());
+        m_listeners.push_back(std::move(listener));
+    }
+    RVLOG_IF(acceptors > 1, RV_INFO) << "Listening on port " << port << " with " << acceptors << " acceptors";
+
+    if (!m_socketPath.empty()) {
+#ifdef RESIDUE_HAS_LOCAL_SOCKETS
+        // remove stale socket file from previous run otherwise bind fails
+        ::unlink(m_socketPath.c_str());
+        m_localListener = std::unique_ptr<LocalListener>(new LocalListener);
+        net::local::stream_protocol::endpoint localEndpoint(m_socketPath);
+        m_localListener->acceptor.open(localEndpoint.protocol());
+        m_localListener->acceptor.bind(localEndpoint);
+        // socket file is created with umask, set mode explicitly as
+        // connecting to socket requires write permission on it
+        const unsigned int socketMode = m_requestHandler->registry()->configuration()->socketMode();
+        if (::chmod(m_socketPath.c_str(), static_cast<mode_t>(socketMode)) != 0) {
+            RLOG(WARNING) << "Failed to set mode [" << socketMode << "] on local socket " << m_socketPath
+                          << ": " << std::strerror(errno);
+        }
+        m_localListener->acceptor.listen();
+        accept(m_localListener.get());
+        RVLOG(RV_INFO) << "Listening on local socket " << m_socketPath;
+#else
+        RLOG(WARNING) << "Local sockets are not supported on this platform, ignoring [" << m_socketPath << "]";
+#endif
+    }
 }
 
 Server::~Server()
 {
-    if (m_socket.is_open()) {
-        m_socket.close();
+    for (auto& listener : m_listeners) {
+        if (listener->socket.is_open()) {
+            listener->socket.close();
+        }
+    }
+#ifdef RESIDUE_HAS_LOCAL_SOCKETS
+    if (m_localListener) {
+        ::unlink(m_socketPath.c_str());
     }
+#endif
 }
 
-void Server::accept()
+void Server::accept(TcpListener* listener)
 {
-    m_acceptor.async_accept(m_socket, [this](residue::error_code ec) {
+    listener->acceptor.async_accept(listener->socket, [this, listener](residue::error_code ec) {
         if (!ec) {
-            std::make_shared<Session>(std::move(m_socket), m_requestHandler)->start();
+            residue::error_code endpointEc;
+            const std::string remoteAddress = listener->socket.remote_endpoint(endpointEc).address().to_string();
+            std::make_shared<Session>(Session::Socket(std::move(listener->socket)),
+                                      m_requestHandler, remoteAddress)->start();
         }
-        accept();
+        accept(listener);
     });
 }
 
+#ifdef RESIDUE_HAS_LOCAL_SOCKETS
+void Server::accept(LocalListener* listener)
+{
+    listener->acceptor.async_accept(listener->socket, [this, listener](residue::error_code ec) {
+        if (!ec) {
+            bool trusted = false;
+            int uid = -1;
+#if defined(SO_PEERCRED)
+            struct ucred cred;
+            socklen_t len = sizeof(cred);
+            if (::getsockopt(listener->socket.native_handle(), SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0) {
+                uid = static_cast<int>(cred.uid);
+            }
+#else
+            uid_t peerUid;
+            gid_t peerGid;
+            if (::getpeereid(listener->socket.native_handle(), &peerUid, &peerGid) == 0) {
+                uid = static_cast<int>(peerUid);
+            }
+#endif
+            if (uid >= 0) {
+                trusted = m_requestHandler->registry()->configuration()->isTrustedSocketUser(static_cast<unsigned int>(uid));
+            }
+            auto session = std::make_shared<Session>(Session::Socket(std::move(listener->socket)),
+                                                     m_requestHandler, "unix:" + std::to_string(uid));
+            session->setTrusted(trusted);
+            session->setPeerUid(uid);
+            RVLOG(RV_DETAILS) << "Local session [" << session->id() << "] from uid " << uid
+                              << (trusted ? " (trusted)" : "");
+            session->start();
+        }
+        accept(listener);
+    });
+}
+#endif
+
 void Server::start()
 {
-    m_ioService.run();
+    std::vector<net::io_service*> services;
+    for (auto& listener : m_listeners) {
+        services.push_back(&listener->ioService);
+    }
+#ifdef RESIDUE_HAS_LOCAL_SOCKETS
+    if (m_localListener) {
+        services.push_back(&m_localListener->ioService);
+    }
+#endif
+    // first io service runs on the caller's thread
+    std::vector<std::thread> threads;
+    const std::string threadName = el::Helpers::getThreadName();
+    for (std::size_t i = 1; i < services.size(); ++i) {
+        net::io_service* ioService = services[i];
+        threads.push_back(std::thread([ioService, threadName, i]() {
+            el::Helpers::setThreadName(threadName + "#" + std::to_string(i));
+            ioService->run();
+        }));
+    }
+    services.front()->run();
+    for (auto& t : threads) {
+        t.join();
+    }
 }
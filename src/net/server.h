@@ -20,6 +20,10 @@
 #ifndef Server_h
 #define Server_h
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "net/asio.h"
 #include "non-copyable.h"
 
@@ -33,20 +37,54 @@ class RequestHandler;
 /// \brief Server containing abstract request handler that determines request
 /// handler at constructor time and calls the handler with new session
 ///
+/// Server may listen on same port with multiple acceptors (using SO_REUSEPORT)
+/// each with it's own io service and thread so kernel balances incoming connections.
+/// It can optionally listen on local (unix domain) socket for co-located clients
+///
 class Server final : NonCopyable
 {
 public:
-    Server(int port, RequestHandler* requestHandler);
+    Server(int port, RequestHandler* requestHandler, unsigned int acceptors = 1,
+           const std::string& socketPath = "");
     ~Server();
 
+    ///
+    /// \brief Runs all the acceptors. Blocks until all of them are stopped
+    ///
     void start();
 
 private:
-    void accept();
+    ///
+    /// \brief Single acceptor with it's own io service
+    ///
+    template <typename Protocol>
+    struct Listener
+    {
+        net::io_service ioService;
+        typename Protocol::acceptor acceptor;
+        typename Protocol::socket socket;
+
+        Listener() :
+            acceptor(ioService),
+            socket(ioService)
+        {
+        }
+    };
+
+    using TcpListener = Listener<tcp>;
+
+    void accept(TcpListener* listener);
+
+    std::vector<std::unique_ptr<TcpListener>> m_listeners;
+
+#ifdef RESIDUE_HAS_LOCAL_SOCKETS
+    using LocalListener = Listener<net::local::stream_protocol>;
+
+    void accept(LocalListener* listener);
 
-    net::io_service m_ioService;
-    tcp::acceptor m_acceptor;
-    tcp::socket m_socket;
+    std::unique_ptr<LocalListener> m_localListener;
+#endif
+    std::string m_socketPath;
 
     RequestHandler* m_requestHandler;
 };
@@ -36,13 +36,30 @@ using namespace residue;
 const std::string Session::PACKET_DELIMITER = "\r\n\r\n";
 const std::size_t Session::PACKET_DELIMITER_SIZE = Session::PACKET_DELIMITER.size();
 
-Session::Session(tcp::socket&& socket,
-                 RequestHandler* requestHandler) :
+static std::atomic<std::uint64_t> s_nextSerial(1);
+
+Session::Session(Socket&& socket,
+                 RequestHandler* requestHandler,
+                 const std::string& remoteAddress) :
+    m_serial(s_nextSerial.fetch_add(1, std::memory_order_relaxed)),
     m_socket(std::move(socket)),
+    m_remoteAddress(remoteAddress),
+    m_trusted(false),
+    m_peerUid(-1),
     m_requestHandler(requestHandler),
-    m_client(nullptr),
-    m_bytesSent("0"),
-    m_bytesReceived("0")
+    m_readPaused(false),
+    m_connected(true),
+    m_bytesSent(0),
+    m_bytesReceived(0),
+    m_writing(false),
+    m_hasAckMode(false),
+    m_ackMode(Client::AckMode::PER_PACKET),
+    m_ackEvery(0),
+    m_ackIntervalMs(0),
+    m_ackTimer(m_socket.get_io_service()),
+    m_ackTimerArmed(false),
+    m_ackSequence(0),
+    m_lastAckedSequence(0)
 {
     m_id = m_requestHandler->name()[0] + Utils::generateRandomString(16, true);
     DRVLOG(RV_DEBUG) << "New session " << m_id;
@@ -76,9 +93,11 @@ void Session::read()
                              << (numOfBytes - Session::PACKET_DELIMITER_SIZE) // ignore package delimiter
                              << " bytes";
 #endif
-            std::istream is(&m_streamBuffer);
-            std::string buffer((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
-            buffer.erase(numOfBytes - Session::PACKET_DELIMITER_SIZE);
+            // stream buffer may already hold subsequent (pipelined) packets
+            // so we only take this packet out of it and leave the rest for next read
+            auto begin = net::buffers_begin(m_streamBuffer.data());
+            std::string buffer(begin, begin + (numOfBytes - Session::PACKET_DELIMITER_SIZE));
+            m_streamBuffer.consume(numOfBytes);
             //RESIDUE_HIGH_PROFILE_CHECKPOINT(t_read, m_timeTaken, 1, 1);
             sendToHandler(std::move(buffer));
             //RESIDUE_HIGH_PROFILE_CHECKPOINT(t_read, m_timeTaken, 2, 1);
@@ -86,18 +105,37 @@ void Session::read()
 #ifdef RESIDUE_DEV
                 DRVLOG(RV_TRACE) << "Adding bytes";
 #endif
-                Utils::bigAdd(m_bytesReceived, std::to_string(numOfBytes));
+                m_bytesReceived.fetch_add(numOfBytes, std::memory_order_relaxed);
                 m_requestHandler->registry()->addBytesReceived(numOfBytes);
             }
+            // responses (if any) are queued by now, we re-arm read only once per packet
+            // unless handler asked us to hold off (see resumeReading())
+            if (!m_readPaused) {
+                read();
+            }
         } else {
 #ifdef RESIDUE_DEBUG
             DRVLOG_IF(ec != net::error::eof, RV_DEBUG) << "Error: " << ec.message();
 #endif
+            m_connected = false;
             m_requestHandler->registry()->leave(shared_from_this());
         }
     });
 }
 
+void Session::resumeReading()
+{
+    auto self(shared_from_this());
+    // re-arm on session's own io thread so we never have two reads outstanding.
+    // If socket was closed meanwhile the read fails and session leaves registry
+    m_socket.get_io_service().post([this, self]() {
+        if (m_readPaused) {
+            m_readPaused = false;
+            read();
+        }
+    });
+}
+
 void Session::sendToHandler(std::string&& data)
 {
 #ifdef RESIDUE_DEBUG
@@ -105,28 +143,34 @@ void Session::sendToHandler(std::string&& data)
 #endif
     RawRequest req {
         std::move(data),
-        m_socket.remote_endpoint().address().to_string(),
+        m_remoteAddress,
         Utils::now(),
-        shared_from_this()
+        shared_from_this(),
+        nullptr
     };
     m_requestHandler->handle(std::move(req));
 }
 
 void Session::close()
 {
-    if (m_socket.is_open()) {
+    m_connected = false;
+    auto self(shared_from_this());
+    m_socket.get_io_service().dispatch([this, self]() {
+        residue::error_code ec;
+        m_ackTimer.cancel(ec);
+        if (m_socket.is_open()) {
 #ifdef RESIDUE_DEBUG
-        DRVLOG(RV_DEBUG) << "Closing session...";
+            DRVLOG(RV_DEBUG) << "Closing session...";
 #endif
-        m_socket.close();
-    }
+            m_socket.close(ec);
+        }
+    });
 }
 
 void Session::write(const char* data,
                     const char* key)
 {
-    std::string result = AES::encrypt(data, key);
-    write(result.c_str(), result.size());
+    queueWrite(std::make_shared<const std::string>(AES::encrypt(data, key)));
 }
 
 void Session::write(const char* data,
@@ -141,42 +185,147 @@ void Session::write(const char* data,
 #else // use ripe
         std::string base64Encoded = Base64::encode(encryptedData) + Session::PACKET_DELIMITER;
 #endif
-        write(base64Encoded.c_str(), base64Encoded.size());
+        queueWrite(std::make_shared<const std::string>(std::move(base64Encoded)));
     } catch (const std::exception& e) {
         RLOG(ERROR) << "PUBLIC KEY:" << std::endl << publicEncryptionKey;
         RLOG(ERROR) << "DATA:" << std::endl << data;
-        std::string err = std::string(e.what()) + Session::PACKET_DELIMITER;
-        write(err.c_str(), err.size());
+        queueWrite(std::make_shared<const std::string>(std::string(e.what()) + Session::PACKET_DELIMITER));
     }
 }
 
 void Session::writeStandardResponse(const Response::StatusCode& r)
 {
-    std::string s(Response::STANDARD_RESPONSES.at(static_cast<unsigned short>(r)));
-    write(s.c_str(), s.length());
+    // standard responses are prebuilt, we only share the reference
+    std::shared_ptr<const std::string> response = Response::STANDARD_RESPONSES.at(static_cast<unsigned short>(r));
+    queueWrite(std::move(response));
 }
 
 void Session::write(const std::string& s)
 {
-    write((s + Session::PACKET_DELIMITER).c_str(),
-          s.size() + Session::PACKET_DELIMITER_SIZE);
+    queueWrite(std::make_shared<const std::string>(s + Session::PACKET_DELIMITER));
 }
 
-void Session::write(const char* data,
-                    std::size_t length)
+void Session::setAckMode(Client::AckMode ackMode, unsigned int ackEvery, unsigned int ackIntervalMs)
+{
+    m_ackMode = ackMode;
+    m_ackEvery = ackEvery;
+    m_ackIntervalMs = ackIntervalMs;
+    m_hasAckMode = true;
+}
+
+void Session::acknowledge(const Response::StatusCode& r)
+{
+    switch (m_ackMode) {
+    case Client::AckMode::NONE:
+        // fire-and-forget, client only hears about failed requests
+        if (r != Response::StatusCode::OK) {
+            writeStandardResponse(r);
+        }
+        break;
+    case Client::AckMode::CUMULATIVE:
+        ++m_ackSequence;
+        if (r == Response::StatusCode::OK) {
+            acknowledgeCumulative();
+        } else {
+            // everything before this packet is acknowledged first so
+            // client knows exactly which packet failed
+            if (m_ackSequence - 1 > m_lastAckedSequence) {
+                m_lastAckedSequence = m_ackSequence - 1;
+                queueWrite(buildCumulativeAck(Response::StatusCode::OK, m_lastAckedSequence));
+            }
+            m_lastAckedSequence = m_ackSequence;
+            queueWrite(buildCumulativeAck(r, m_ackSequence));
+        }
+        break;
+    case Client::AckMode::PER_PACKET:
+    default:
+        writeStandardResponse(r);
+    }
+}
+
+void Session::acknowledgeCumulative()
+{
+    if (m_ackEvery > 0 && m_ackSequence - m_lastAckedSequence >= m_ackEvery) {
+        sendCumulativeAck();
+    } else if (m_ackIntervalMs > 0 && !m_ackTimerArmed) {
+        m_ackTimerArmed = true;
+        m_ackTimer.expires_from_now(std::chrono::milliseconds(m_ackIntervalMs));
+        auto self(shared_from_this());
+        m_ackTimer.async_wait([this, self](residue::error_code ec) {
+            m_ackTimerArmed = false;
+            if (!ec) {
+                sendCumulativeAck();
+            }
+        });
+    }
+}
+
+void Session::sendCumulativeAck()
+{
+    if (m_ackSequence == m_lastAckedSequence) {
+        return;
+    }
+    m_lastAckedSequence = m_ackSequence;
+    queueWrite(buildCumulativeAck(Response::StatusCode::OK, m_ackSequence));
+}
+
+std::shared_ptr<const std::string> Session::buildCumulativeAck(const Response::StatusCode& r,
+                                                               unsigned long long sequence)
+{
+    return std::make_shared<const std::string>("{\"r\":" + std::to_string(static_cast<unsigned short>(r))
+                                               + ",\"seq\":" + std::to_string(sequence) + "}"
+                                               + Session::PACKET_DELIMITER);
+}
+
+void Session::queueWrite(std::shared_ptr<const std::string>&& packet)
 {
-    auto self(shared_from_this());
     if (m_requestHandler->registry()->configuration()->hasFlag(Configuration::ENABLE_CLI)) {
-        Utils::bigAdd(m_bytesSent, std::to_string(length));
-        m_requestHandler->registry()->addBytesSent(length);
+        m_bytesSent.fetch_add(packet->size(), std::memory_order_relaxed);
+        m_requestHandler->registry()->addBytesSent(packet->size());
     }
 
 #ifdef RESIDUE_DEBUG
-    DRVLOG(RV_DEBUG_2) << "Sending " << data;
+    DRVLOG(RV_DEBUG_2) << "Sending " << *packet;
 #endif
-    net::async_write(m_socket, net::buffer(data, length),
-                     [&, self](residue::error_code ec, std::size_t) {
+
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        m_pendingWrites.push_back(std::move(packet));
+        if (m_writing) {
+            // picked up by completion of current write
+            return;
+        }
+        m_writing = true;
+    }
+    // packets are queued from processor, search and live tail threads as well
+    // but socket is only touched from session's own io thread (runs inline if we are on it)
+    auto self(shared_from_this());
+    m_socket.get_io_service().dispatch([this, self]() {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        flushWriteQueue();
+    });
+}
+
+void Session::flushWriteQueue()
+{
+    // Only one write is outstanding at a time, everything queued
+    // since last write is sent together as single scatter-gather write
+    m_writesInFlight.assign(std::make_move_iterator(m_pendingWrites.begin()),
+                            std::make_move_iterator(m_pendingWrites.end()));
+    m_pendingWrites.clear();
+
+    std::vector<net::const_buffer> buffers;
+    buffers.reserve(m_writesInFlight.size());
+    for (const auto& packet : m_writesInFlight) {
+        buffers.push_back(net::buffer(*packet));
+    }
+
+    auto self(shared_from_this());
+    net::async_write(m_socket, buffers,
+                     [this, self](residue::error_code ec, std::size_t) {
         // for 'self' - see https://www.youtube.com/watch?v=D-lTwGJRx0o?t=40m
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        m_writesInFlight.clear();
         if (ec) {
 #ifdef RESIDUE_DEBUG
             DRVLOG(RV_DEBUG) << "Failed to send. " << ec.message();
@@ -185,7 +334,14 @@ void Session::write(const char* data,
             // auto destroy socket if needed
             // do not close here
             // https://github.com/abumq/residue/issues/79
+            m_pendingWrites.clear();
+            m_writing = false;
+            return;
+        }
+        if (m_pendingWrites.empty()) {
+            m_writing = false;
+        } else {
+            flushWriteQueue();
         }
     });
-    read();
 }
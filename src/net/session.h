@@ -20,15 +20,20 @@
 #ifndef Session_h
 #define Session_h
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "net/asio.h"
+#include "core/client.h"
 #include "core/response.h"
 
-using net::ip::tcp;
-
 namespace residue {
 class RequestHandler;
 class Registry;
-class Client;
 
 ///
 /// \brief Session object with each connection
@@ -37,10 +42,15 @@ class Session final : public std::enable_shared_from_this<Session>
 {
 public:
 
+    ///
+    /// \brief Session socket can either be TCP or local (unix domain) socket
+    ///
+    using Socket = net::generic::stream_protocol::socket;
+
     static const std::string PACKET_DELIMITER;
     static const std::size_t PACKET_DELIMITER_SIZE;
 
-    Session(tcp::socket&& socket, RequestHandler* requestHandler);
+    Session(Socket&& socket, RequestHandler* requestHandler, const std::string& remoteAddress);
     ~Session();
 
     ///
@@ -68,53 +78,187 @@ public:
     ///
     void write(const std::string& s);
 
+    ///
+    /// \brief Fixes acknowledgement mode of this session. Mode is taken from client when first
+    /// log request is received on the session, so re-negotiating it with another CONNECT
+    /// only applies to new sessions. Must be called from session's io thread
+    ///
+    void setAckMode(Client::AckMode ackMode, unsigned int ackEvery, unsigned int ackIntervalMs);
+
+    inline bool hasAckMode() const
+    {
+        return m_hasAckMode;
+    }
+
+    ///
+    /// \brief Responds to a log packet according to acknowledgement mode of the session.
+    ///
+    /// In cumulative mode every packet (failed or not) counts towards sequence, everything
+    /// received so far is acknowledged once every <ackEvery> packets or after <ackIntervalMs>
+    /// milliseconds, whichever comes first (0 disables either). Failed packet is responded to
+    /// straight away with its sequence. Must be called from session's io thread
+    ///
+    void acknowledge(const Response::StatusCode& r);
+
+    ///
+    /// \brief Builds cumulative acknowledgement packet {"r":<r>,"seq":<sequence>}
+    ///
+    static std::shared_ptr<const std::string> buildCumulativeAck(const Response::StatusCode& r,
+                                                                 unsigned long long sequence);
+
     inline const std::string& id() const
     {
         return m_id;
     }
 
-    inline void setClient(Client* client)
+    ///
+    /// \brief Unique numeric ID of the session (within this process), used
+    /// to key session in registry
+    ///
+    inline std::uint64_t serial() const
+    {
+        return m_serial;
+    }
+
+    ///
+    /// \brief Sets client for this session. Client handle is set and read atomically
+    /// as it is set from io thread and read from queue processors
+    ///
+    inline void setClient(const std::shared_ptr<Client>& client)
     {
-        m_client = client;
+        std::atomic_store(&m_client, client);
     }
 
-    inline const Client* client() const
+    inline std::shared_ptr<Client> client() const
     {
-        return m_client;
+        return std::atomic_load(&m_client);
     }
 
     ///
     /// \brief Returns socket by const reference
     ///
-    inline const tcp::socket& socket() const
+    inline const Socket& socket() const
     {
         return m_socket;
     }
 
-    inline const std::string& bytesReceived() const
+    ///
+    /// \brief False once session is closed or peer disconnected. Unlike socket().is_open()
+    /// this is safe to check from any thread
+    ///
+    inline bool isConnected() const
+    {
+        return m_connected;
+    }
+
+    inline const std::string& remoteAddress() const
+    {
+        return m_remoteAddress;
+    }
+
+    ///
+    /// \brief Trusted sessions are local sessions from peers that are trusted by their
+    /// credentials (see trusted_socket_users) and are allowed to send plain requests
+    /// for the clients that their user is trusted for
+    ///
+    inline bool isTrusted() const
+    {
+        return m_trusted;
+    }
+
+    inline void setTrusted(bool trusted)
     {
-        return m_bytesReceived;
+        m_trusted = trusted;
     }
 
-    inline const std::string& bytesSent() const
+    ///
+    /// \brief User ID of the peer process for local sessions, -1 otherwise
+    ///
+    inline int peerUid() const
+    {
+        return m_peerUid;
+    }
+
+    inline void setPeerUid(int peerUid)
+    {
+        m_peerUid = peerUid;
+    }
+
+    inline std::uint64_t bytesReceived() const
+    {
+        return m_bytesReceived.load(std::memory_order_relaxed);
+    }
+
+    inline std::uint64_t bytesSent() const
+    {
+        return m_bytesSent.load(std::memory_order_relaxed);
+    }
+
+    ///
+    /// \brief Stops reading from socket once current packet is handled so TCP
+    /// window pushes back on the client. Must be called from request handler
+    ///
+    inline void pauseReading()
+    {
+        m_readPaused = true;
+    }
+
+    ///
+    /// \brief Re-arms reading if it was paused. Safe to call from any thread
+    ///
+    void resumeReading();
+
+    inline bool readPaused() const
+    {
+        return m_readPaused;
+    }
+
+    ///
+    /// \brief Number of packets queued or being written to socket
+    ///
+    inline std::size_t pendingWrites()
     {
-        return m_bytesSent;
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        return m_pendingWrites.size() + m_writesInFlight.size();
     }
 
     ///
-    /// \brief close session
+    /// \brief close session (on session's io thread)
     ///
     void close();
 private:
     std::string m_id;
-    tcp::socket m_socket;
+    std::uint64_t m_serial;
+    Socket m_socket;
+    std::string m_remoteAddress;
+    bool m_trusted;
+    int m_peerUid;
     RequestHandler* m_requestHandler;
-    Client* m_client;
+    std::shared_ptr<Client> m_client;
     std::string m_name;
     net::streambuf m_streamBuffer;
+    std::atomic<bool> m_readPaused;
+    std::atomic<bool> m_connected;
+
+    std::atomic<std::uint64_t> m_bytesSent;
+    std::atomic<std::uint64_t> m_bytesReceived;
+
+    // Outbound queue - packets are owned by the queue (or are static standard
+    // responses) so they outlive the asynchronous write regardless of the caller
+    std::mutex m_writeMutex;
+    std::deque<std::shared_ptr<const std::string>> m_pendingWrites;
+    std::vector<std::shared_ptr<const std::string>> m_writesInFlight;
+    bool m_writing;
 
-    std::string m_bytesSent;
-    std::string m_bytesReceived;
+    // Acknowledgement state, only touched from session's io thread
+    bool m_hasAckMode;
+    Client::AckMode m_ackMode;
+    unsigned int m_ackEvery;
+    unsigned int m_ackIntervalMs;
+    net::steady_timer m_ackTimer;
+    bool m_ackTimerArmed;
+    unsigned long long m_ackSequence;
+    unsigned long long m_lastAckedSequence;
 
     ///
     /// \brief Read incoming data and calls sendToHandler on the packet
@@ -122,9 +266,26 @@ private:
     void read();
 
     ///
-    /// \brief Write plain data to the client
+    /// \brief Queue already formatted packet for writing to the client. Safe to call from any thread
+    ///
+    void queueWrite(std::shared_ptr<const std::string>&& packet);
+
+    ///
+    /// \brief Writes all the pending packets in single scatter-gather write.
+    /// Must run on session's io thread with m_writeMutex held and m_writing set
+    ///
+    void flushWriteQueue();
+
+    ///
+    /// \brief Acknowledges successful packet (already counted) in cumulative mode
+    ///
+    void acknowledgeCumulative();
+
+    ///
+    /// \brief Writes cumulative acknowledgement for all the packets received so far
+    /// (no-op if nothing new was received since last acknowledgement)
     ///
-    void write(const char* data, std::size_t length);
+    void sendCumulativeAck();
 
     ///
     /// \brief Send the packet bytes to the handler
@@ -0,0 +1,228 @@
+//
+//  shm-ring.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "net/shm-ring.h"
+
+#include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+
+#include "core/residue-exception.h"
+#include "logging/log.h"
+
+using namespace residue;
+
+const char ShmRing::MAGIC[8] = { 'R', 'E', 'S', 'R', 'I', 'N', 'G', '\0' };
+const std::uint32_t ShmRing::VERSION = 1;
+const std::uint64_t ShmRing::MIN_CAPACITY = 64 * 1024;
+const std::uint64_t ShmRing::MAX_CAPACITY = 256 * 1024 * 1024;
+
+// layout is shared with client libraries, see docs/CONNECTIVITY.md
+static_assert(offsetof(ShmRing::Header, head) == 64, "Invalid ring header layout");
+static_assert(offsetof(ShmRing::Header, tail) == 128, "Invalid ring header layout");
+static_assert(sizeof(ShmRing::Header) == 192, "Invalid ring header size");
+
+namespace {
+
+// set while current thread accesses a segment, see ShmRing::guarded
+thread_local sigjmp_buf* t_segmentAccess = nullptr;
+struct sigaction s_previousBusAction;
+std::once_flag s_busHandlerInstalled;
+
+void onBusError(int sig, siginfo_t* info, void* context)
+{
+    if (t_segmentAccess != nullptr) {
+        siglongjmp(*t_segmentAccess, 1);
+    }
+    // fault is not from a ring, leave it to previous handler (e.g, crash handler)
+    if ((s_previousBusAction.sa_flags & SA_SIGINFO) != 0) {
+        s_previousBusAction.sa_sigaction(sig, info, context);
+    } else if (s_previousBusAction.sa_handler != SIG_DFL && s_previousBusAction.sa_handler != SIG_IGN) {
+        s_previousBusAction.sa_handler(sig);
+    } else {
+        // faulting instruction is run again with default action
+        ::signal(sig, SIG_DFL);
+    }
+}
+
+void installBusHandler()
+{
+    std::call_once(s_busHandlerInstalled, []() {
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_sigaction = onBusError;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        ::sigaction(SIGBUS, &action, &s_previousBusAction);
+    });
+}
+
+}
+
+template <typename Func>
+bool ShmRing::guarded(Func&& func)
+{
+    sigjmp_buf segmentAccess;
+    if (sigsetjmp(segmentAccess, 1) != 0) {
+        t_segmentAccess = nullptr;
+        m_corrupted = true;
+        RLOG(ERROR) << "Ring [" << m_name << "] was truncated by client, detaching";
+        return false;
+    }
+    t_segmentAccess = &segmentAccess;
+    func();
+    t_segmentAccess = nullptr;
+    return true;
+}
+
+ShmRing::ShmRing(const std::string& name, const std::string& clientId, int ownerUid) :
+    m_name(name),
+    m_clientId(clientId),
+    m_segment(MAP_FAILED),
+    m_segmentSize(0),
+    m_header(nullptr),
+    m_data(nullptr),
+    m_capacity(0),
+    m_corrupted(false)
+{
+    if (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos) {
+        throw ResidueException("Invalid ring name [" + name + "]");
+    }
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        throw ResidueException("Unable to open ring [" + name + "]: " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        const int err = errno;
+        ::close(fd);
+        throw ResidueException("Unable to stat ring [" + name + "]: " + std::strerror(err));
+    }
+    if (ownerUid < 0 || st.st_uid != static_cast<uid_t>(ownerUid) || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        // segment of another user (or one that others can write) may be ring of another producer
+        ::close(fd);
+        throw ResidueException("Ring [" + name + "] must be owned by client user and not writable by group or others");
+    }
+    if (st.st_size < static_cast<off_t>(sizeof(Header) + MIN_CAPACITY)) {
+        ::close(fd);
+        throw ResidueException("Ring [" + name + "] is too small");
+    }
+    m_segmentSize = static_cast<std::size_t>(st.st_size);
+    m_segment = ::mmap(nullptr, m_segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m_segment == MAP_FAILED) {
+        throw ResidueException("Unable to map ring [" + name + "]: " + std::strerror(errno));
+    }
+    m_header = static_cast<Header*>(m_segment);
+    m_data = static_cast<char*>(m_segment) + sizeof(Header);
+
+    installBusHandler();
+    bool validHeader = false;
+    guarded([&]() {
+        m_capacity = m_header->capacity;
+        validHeader = std::memcmp(m_header->magic, MAGIC, sizeof(MAGIC)) == 0
+                && m_header->version == VERSION;
+    });
+    const bool validCapacity = m_capacity >= MIN_CAPACITY && m_capacity <= MAX_CAPACITY
+            && (m_capacity & (m_capacity - 1)) == 0
+            && sizeof(Header) + m_capacity <= m_segmentSize;
+    if (m_corrupted
+            || !validHeader
+            || !validCapacity
+            || !m_header->head.is_lock_free()) {
+        ::munmap(m_segment, m_segmentSize);
+        throw ResidueException("Ring [" + name + "] has invalid header");
+    }
+    RLOG(INFO) << "Attached ring [" << m_name << "] for client [" << m_clientId << "] with capacity " << m_capacity << " bytes";
+}
+
+ShmRing::~ShmRing()
+{
+    if (m_segment != MAP_FAILED) {
+        ::munmap(m_segment, m_segmentSize);
+    }
+    RVLOG(RV_INFO) << "Detached ring [" << m_name << "]";
+}
+
+void ShmRing::copyOut(std::uint64_t position, char* dest, std::size_t len) const
+{
+    const std::size_t offset = static_cast<std::size_t>(position & (m_capacity - 1));
+    const std::size_t firstPart = std::min(len, static_cast<std::size_t>(m_capacity) - offset);
+    std::memcpy(dest, m_data + offset, firstPart);
+    if (firstPart < len) {
+        std::memcpy(dest + firstPart, m_data, len - firstPart);
+    }
+}
+
+bool ShmRing::closed()
+{
+    bool open = false;
+    if (!m_corrupted) {
+        guarded([&]() {
+            open = m_header->state.load(std::memory_order_acquire) == static_cast<std::uint32_t>(State::OPEN);
+        });
+    }
+    return m_corrupted || !open;
+}
+
+bool ShmRing::pop(std::string& output)
+{
+    if (m_corrupted) {
+        return false;
+    }
+    std::uint64_t tail = 0;
+    std::uint64_t head = 0;
+    std::uint32_t len = 0;
+    const bool accessible = guarded([&]() {
+        tail = m_header->tail.load(std::memory_order_relaxed);
+        head = m_header->head.load(std::memory_order_acquire);
+        if (head - tail >= sizeof(len)) {
+            copyOut(tail, reinterpret_cast<char*>(&len), sizeof(len));
+        }
+    });
+    const std::uint64_t available = head - tail;
+    if (!accessible || available < sizeof(len)) {
+        return false;
+    }
+    if (len == 0 || available > m_capacity || len > m_capacity - sizeof(len)) {
+        // producer is misbehaving, we stop reading from this ring
+        RLOG(ERROR) << "Ring [" << m_name << "] is corrupted, detaching";
+        m_corrupted = true;
+        return false;
+    }
+    if (available < sizeof(len) + len) {
+        // record not fully published yet
+        return false;
+    }
+    output.resize(len);
+    char* dest = &output[0];
+    return guarded([&]() {
+        copyOut(tail + sizeof(len), dest, len);
+        m_header->tail.store(tail + sizeof(len) + len, std::memory_order_release);
+    });
+}
@@ -0,0 +1,122 @@
+//
+//  shm-ring.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef ShmRing_h
+#define ShmRing_h
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "non-copyable.h"
+
+namespace residue {
+
+///
+/// \brief Single-producer single-consumer byte ring in shared memory (POSIX shm)
+///
+/// Segment is created by the client (producer) and attached by the server (consumer)
+/// after client requests it through connect port. Each record is 4-byte length
+/// (host byte order) followed by the packet, exactly as it would be sent over the
+/// logging port but without packet delimiter. Records may wrap around the end of
+/// the data region.
+///
+/// Producer publishes by advancing head after copying the record; server advances
+/// tail once record is copied out. Both are monotonically increasing byte counters.
+///
+class ShmRing final : NonCopyable
+{
+public:
+    static const char MAGIC[8];
+    static const std::uint32_t VERSION;
+    static const std::uint64_t MIN_CAPACITY;
+    static const std::uint64_t MAX_CAPACITY;
+
+    enum class State : std::uint32_t
+    {
+        OPEN = 1,
+        CLOSED = 2
+    };
+
+    ///
+    /// \brief Layout of the beginning of the segment, data region follows it
+    ///
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::atomic<std::uint32_t> state;
+        std::uint64_t capacity;
+        alignas(64) std::atomic<std::uint64_t> head;
+        alignas(64) std::atomic<std::uint64_t> tail;
+    };
+
+    ///
+    /// \brief Maps existing segment
+    /// \param ownerUid User that segment must be owned by (peer of the local session)
+    /// \throws ResidueException if segment does not exist, is not owned by ownerUid, is writable
+    /// by group or others or is invalid
+    ///
+    ShmRing(const std::string& name, const std::string& clientId, int ownerUid);
+    ~ShmRing();
+
+    ///
+    /// \brief Copies next record (if any) in to output
+    /// \return False if there is no complete record
+    ///
+    bool pop(std::string& output);
+
+    ///
+    /// \brief Whether producer closed the ring or ring got corrupted (including when producer
+    /// truncated the segment after it was mapped)
+    ///
+    bool closed();
+
+    inline const std::string& name() const
+    {
+        return m_name;
+    }
+
+    inline const std::string& clientId() const
+    {
+        return m_clientId;
+    }
+
+private:
+    std::string m_name;
+    std::string m_clientId;
+    void* m_segment;
+    std::size_t m_segmentSize;
+    Header* m_header;
+    char* m_data;
+    std::uint64_t m_capacity;
+    bool m_corrupted;
+
+    void copyOut(std::uint64_t position, char* dest, std::size_t len) const;
+
+    ///
+    /// \brief Runs func that reads or writes the segment, if segment was truncated by producer
+    /// (SIGBUS) ring is marked corrupted instead of crashing the server
+    /// \return False if segment could not be accessed
+    ///
+    template <typename Func>
+    bool guarded(Func&& func);
+};
+}
+#endif /* ShmRing_h */
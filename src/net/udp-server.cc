@@ -0,0 +1,90 @@
+//
+//  udp-server.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "net/udp-server.h"
+
+#include "core/request-handler.h"
+#include "logging/log.h"
+#include "logging/log-request-handler.h"
+#include "net/session.h"
+#include "utils/utils.h"
+
+using namespace residue;
+using net::ip::udp;
+
+UdpServer::UdpServer(int port, LogRequestHandler* logRequestHandler) :
+    m_socket(m_ioService, udp::endpoint(udp::v4(), port)),
+    m_logRequestHandler(logRequestHandler),
+    m_received(0),
+    m_dropped(0),
+    m_malformed(0)
+{
+    // larger kernel buffer absorbs bursts while we are handling previous datagram
+    residue::error_code ec;
+    m_socket.set_option(net::socket_base::receive_buffer_size(4 * 1024 * 1024), ec);
+    RVLOG(RV_INFO) << "Listening for datagrams on port " << port;
+    receive();
+}
+
+std::string UdpServer::requestData(const char* datagram, std::size_t size)
+{
+    std::string data(datagram, size);
+    if (data.size() >= Session::PACKET_DELIMITER_SIZE
+            && data.compare(data.size() - Session::PACKET_DELIMITER_SIZE,
+                            Session::PACKET_DELIMITER_SIZE, Session::PACKET_DELIMITER) == 0) {
+        data.erase(data.size() - Session::PACKET_DELIMITER_SIZE);
+    }
+    return data;
+}
+
+void UdpServer::receive()
+{
+    m_socket.async_receive_from(net::buffer(m_buffer), m_remoteEndpoint,
+                                [this](residue::error_code ec, std::size_t numOfBytes) {
+        if (!ec && numOfBytes > 0) {
+            m_received.fetch_add(1, std::memory_order_relaxed);
+            RawRequest req {
+                requestData(m_buffer.data(), numOfBytes),
+                m_remoteEndpoint.address().to_string(),
+                Utils::now(),
+                nullptr,
+                nullptr
+            };
+            switch (m_logRequestHandler->handleDatagram(std::move(req))) {
+            case LogRequestHandler::DatagramStatus::MALFORMED:
+                m_malformed.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case LogRequestHandler::DatagramStatus::DROPPED:
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                break;
+            default:
+                break;
+            }
+        }
+#ifdef RESIDUE_DEBUG
+        DRVLOG_IF(ec, RV_DEBUG) << "Failed to receive datagram. " << ec.message();
+#endif
+        receive();
+    });
+}
+
+void UdpServer::start()
+{
+    m_ioService.run();
+}
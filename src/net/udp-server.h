@@ -0,0 +1,87 @@
+//
+//  udp-server.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef UdpServer_h
+#define UdpServer_h
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "net/asio.h"
+#include "non-copyable.h"
+
+namespace residue {
+
+class LogRequestHandler;
+
+///
+/// \brief Datagram listener for log requests where loss is acceptable
+///
+/// Each datagram is single log request (or small bulk) in the same encrypted
+/// format as logging port. There is no session, no response and no
+/// retransmission - datagrams are dropped if client's queue is full
+///
+class UdpServer final : NonCopyable
+{
+public:
+    static const std::size_t MAX_DATAGRAM_SIZE = 65507;
+
+    UdpServer(int port, LogRequestHandler* logRequestHandler);
+
+    ///
+    /// \brief Request carried by datagram, i.e, datagram without trailing packet delimiter
+    /// (delimiter is optional for datagrams)
+    ///
+    static std::string requestData(const char* datagram, std::size_t size);
+
+    void start();
+
+    inline std::uint64_t received() const
+    {
+        return m_received.load(std::memory_order_relaxed);
+    }
+
+    inline std::uint64_t dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    inline std::uint64_t malformed() const
+    {
+        return m_malformed.load(std::memory_order_relaxed);
+    }
+
+private:
+    void receive();
+
+    net::io_service m_ioService;
+    net::ip::udp::socket m_socket;
+    net::ip::udp::endpoint m_remoteEndpoint;
+    std::array<char, MAX_DATAGRAM_SIZE> m_buffer;
+
+    LogRequestHandler* m_logRequestHandler;
+
+    std::atomic<std::uint64_t> m_received;
+    std::atomic<std::uint64_t> m_dropped;
+    std::atomic<std::uint64_t> m_malformed;
+};
+}
+#endif /* UdpServer_h */
@@ -161,6 +161,7 @@ int Setup::setup()
     config.m_connectPort = 8777;
     config.m_loggingPort = 8778;
     config.m_fileMode = static_cast<unsigned int>(S_IRUSR | S_IWUSR | S_IRGRP);
+    config.m_socketMode = static_cast<unsigned int>(S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
     config.m_defaultKeySize = 256;
     config.addFlag(Configuration::ENABLE_CLI);
     config.addFlag(Configuration::ALLOW_INSECURE_CONNECTION);
@@ -175,6 +176,18 @@ int Setup::setup()
     config.m_clientIntegrityTaskInterval = 300;
     config.m_clientAge = 3600;
     config.m_dispatchDelay = 1;
+    config.m_acceptorThreads = 1;
+    config.m_maxQueueDepth = 0;
+    config.m_queueResumeDepth = 0;
+    config.m_loggingUdpPort = 0;
+    config.m_archiveThreads = 2;
+    config.m_archiveNice = 10;
+    config.m_archiveZstdLevel = 3;
+    config.m_archiveZstdLong = false;
+    config.m_archiveSegmentSize = 0;
+    config.m_archiveSegmentInterval = 0;
+    config.m_searchThreads = 2;
+    config.m_tailBufferSize = 1000;
 
     config.m_archivedLogDirectory = "%original/archives/";
     config.m_archivedLogCompressedFilename = "%logger.%wday.tar.gz";
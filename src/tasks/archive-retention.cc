@@ -0,0 +1,343 @@
+//
+//  archive-retention.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "tasks/archive-retention.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+#include "core/configuration.h"
+#include "core/registry.h"
+#include "logging/log.h"
+#include "utils/archive-index.h"
+#include "utils/bloom-filter.h"
+
+using namespace residue;
+
+static bool isDigits(const char* value, std::size_t width)
+{
+    return std::all_of(value, value + width, [](char c) { return std::isdigit(static_cast<unsigned char>(c)); });
+}
+
+static bool isOneOf(const char* value, std::initializer_list<const char*> list)
+{
+    return std::any_of(list.begin(), list.end(), [&](const char* item) { return std::strncmp(value, item, 3) == 0; });
+}
+
+///
+/// \brief Time based format specifier and values it resolves to (see LogRotator::createRotateTarget())
+///
+struct TimeSpecifier
+{
+    const char* specifier;
+    std::size_t width;
+    bool (*matches)(const char* value);
+};
+
+static const TimeSpecifier kTimeSpecifiers[] = {
+    { "%min", 2, [](const char* v) { return isDigits(v, 2); } },
+    { "%hour", 2, [](const char* v) { return isDigits(v, 2); } },
+    { "%wday", 3, [](const char* v) { return isOneOf(v, { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" }); } },
+    { "%day", 2, [](const char* v) { return isDigits(v, 2); } },
+    { "%month", 3, [](const char* v) {
+          return isOneOf(v, { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" });
+      } },
+    { "%quarter", 2, [](const char* v) { return v[0] == 'Q' && v[1] >= '1' && v[1] <= '4'; } },
+    { "%year", 4, [](const char* v) { return isDigits(v, 4); } },
+};
+
+// each time based format specifier only matches what it resolves to, e.g, %hour
+// is two digits, so archives of other loggers sharing the directory (and prefix) are not matched
+static bool matchesPattern(const std::string& str, const std::string& pattern)
+{
+    std::size_t s = 0;
+    std::size_t p = 0;
+    while (p < pattern.size()) {
+        const TimeSpecifier* timeSpecifier = nullptr;
+        if (pattern[p] == '%') {
+            for (const auto& t : kTimeSpecifiers) {
+                if (pattern.compare(p, std::strlen(t.specifier), t.specifier) == 0) {
+                    timeSpecifier = &t;
+                    break;
+                }
+            }
+        }
+        if (timeSpecifier != nullptr) {
+            if (str.size() - s < timeSpecifier->width || !timeSpecifier->matches(str.c_str() + s)) {
+                return false;
+            }
+            s += timeSpecifier->width;
+            p += std::strlen(timeSpecifier->specifier);
+        } else if (s < str.size() && pattern[p] == str[s]) {
+            ++p;
+            ++s;
+        } else {
+            return false;
+        }
+    }
+    return s == str.size();
+}
+
+ArchiveRetention::ArchiveRetention(Registry* registry) :
+    Task("ArchiveRetention", registry, CHECK_INTERVAL)
+{
+}
+
+bool ArchiveRetention::matchesArchivePattern(const std::string& filename, const std::string& pattern)
+{
+    if (matchesPattern(filename, pattern)) {
+        return true;
+    }
+    // archives rotated for max_file_size have sequence (see LogRotator::sequencedFilename)
+    std::size_t start = filename.find_last_of('/');
+    for (std::size_t i = (start == std::string::npos ? 0 : start + 1); i < filename.size(); ++i) {
+        if (filename[i] != '.') {
+            continue;
+        }
+        std::size_t end = i + 1;
+        while (end < filename.size() && std::isdigit(static_cast<unsigned char>(filename[end]))) {
+            ++end;
+        }
+        if (end > i + 1 && (end == filename.size() || filename[end] == '.')
+                && matchesPattern(filename.substr(0, i) + filename.substr(end), pattern)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string ArchiveRetention::archivePattern(const std::string& loggerId, const std::string& directory,
+                                             const std::string& compressedFilename, const std::string& originalDir)
+{
+    // same as LogRotator::createRotateTarget() but time based format specifiers
+    // are left for matchesArchivePattern()
+    std::string pattern = directory;
+    std::string filename = compressedFilename;
+    Utils::replaceAll(pattern, "%logger", loggerId);
+    Utils::replaceAll(filename, "%logger", loggerId);
+    Utils::replaceAll(pattern, "%original", originalDir);
+    Utils::replaceAll(pattern, "%level", "");
+    pattern.append(el::base::consts::kFilePathSeparator).append(filename);
+    Utils::replaceAll(pattern, "//", "/");
+    return pattern;
+}
+
+std::vector<ArchiveRetention::Archive> ArchiveRetention::findArchives(const std::string& pattern)
+{
+    std::vector<Archive> archives;
+    // walk from deepest directory that has no format specifier
+    std::size_t specifier = std::min(pattern.find('%'), pattern.find_last_of('/'));
+    std::size_t rootEnd = pattern.find_last_of('/', specifier);
+    if (rootEnd == std::string::npos) {
+        return archives;
+    }
+    const std::string root = rootEnd == 0 ? "/" : pattern.substr(0, rootEnd);
+    const long maxDepth = std::count(pattern.begin() + rootEnd + 1, pattern.end(), '/');
+
+    std::function<void(const std::string&, long)> walk = [&](const std::string& dirname, long depth) {
+        DIR* dir = opendir(dirname.c_str());
+        if (dir == nullptr) {
+            return;
+        }
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            std::string path = (dirname == "/" ? "" : dirname) + "/" + entry->d_name;
+            struct stat st;
+            if (::stat(path.c_str(), &st) != 0) {
+                continue;
+            }
+            if (S_ISDIR(st.st_mode)) {
+                if (depth < maxDepth) {
+                    walk(path, depth + 1);
+                }
+            } else if (S_ISREG(st.st_mode) && matchesArchivePattern(path, pattern)) {
+                archives.push_back({ path, static_cast<std::size_t>(st.st_size), static_cast<types::Time>(st.st_mtime) });
+            }
+        }
+        closedir(dir);
+    };
+    walk(root, 0);
+    return archives;
+}
+
+std::unordered_set<std::string> ArchiveRetention::archivePatterns(const Configuration* configuration,
+                                                                  const std::string& loggerId)
+{
+    std::unordered_set<std::string> patterns;
+    el::Logger* logger = el::Loggers::getLogger(loggerId, false);
+    if (logger == nullptr) {
+        return patterns;
+    }
+    std::unordered_set<std::string> originalDirs;
+    {
+        std::lock_guard<std::recursive_mutex> l(logger->lock());
+        el::base::type::EnumType lIndex = el::LevelHelper::kMinValid;
+        el::LevelHelper::forEachLevel(&lIndex, [&](void) -> bool {
+            const std::string& fn = logger->typedConfigurations()->filename(el::LevelHelper::castFromInt(lIndex));
+            originalDirs.insert(el::base::utils::File::extractPathFromFilename(fn));
+            return false;
+        });
+    }
+
+    const std::string directory = configuration->getArchivedLogDirectory(loggerId);
+    const std::string compressedFilename = configuration->getArchivedLogCompressedFilename(loggerId);
+    for (const auto& originalDir : originalDirs) {
+        patterns.insert(archivePattern(loggerId, directory, compressedFilename, originalDir));
+    }
+    return patterns;
+}
+
+std::vector<ArchiveRetention::Archive> ArchiveRetention::findLoggerArchives(const std::string& loggerId) const
+{
+    std::vector<Archive> archives;
+    for (const auto& pattern : archivePatterns(m_registry->configuration(), loggerId)) {
+        std::vector<Archive> found = findArchives(pattern);
+        archives.insert(archives.end(), found.begin(), found.end());
+    }
+    std::sort(archives.begin(), archives.end(), [](const Archive& a, const Archive& b) {
+        return a.created < b.created;
+    });
+    return archives;
+}
+
+ArchiveRetention::Index& ArchiveRetention::index(const std::string& loggerId)
+{
+    auto iter = m_indexes.find(loggerId);
+    if (iter != m_indexes.end()) {
+        return iter->second;
+    }
+    Index& index = m_indexes[loggerId];
+    index.totalSize = 0;
+    for (const auto& archive : findLoggerArchives(loggerId)) {
+        if (index.byFilename.find(archive.filename) != index.byFilename.end()) {
+            continue;
+        }
+        index.archives.push_back(archive);
+        index.byFilename.insert(std::make_pair(archive.filename, std::prev(index.archives.end())));
+        index.totalSize += archive.size;
+    }
+    return index;
+}
+
+std::vector<ArchiveRetention::Archive> ArchiveRetention::archives(const std::string& loggerId)
+{
+    if (!m_registry->configuration()->getArchiveRetention(loggerId).isEnabled()) {
+        // not tracked as they are created
+        return findLoggerArchives(loggerId);
+    }
+    std::lock_guard<std::mutex> lock_(m_mutex);
+    const Index& index = this->index(loggerId);
+    return std::vector<Archive>(index.archives.begin(), index.archives.end());
+}
+
+void ArchiveRetention::rebuild()
+{
+    for (const auto& pair : m_registry->configuration()->archiveRetentions()) {
+        {
+            std::lock_guard<std::mutex> lock_(m_mutex);
+            m_indexes.erase(pair.first);
+            const Index& index = this->index(pair.first);
+            RLOG(INFO) << "Found " << index.archives.size() << " archive(s) for logger [" << pair.first << "] ("
+                       << Utils::bytesToHumanReadable(static_cast<long>(index.totalSize)) << ")";
+        }
+        enforce(pair.first);
+    }
+}
+
+void ArchiveRetention::add(const std::string& loggerId, const std::string& archiveFilename)
+{
+    if (!m_registry->configuration()->getArchiveRetention(loggerId).isEnabled()) {
+        return;
+    }
+    long size = Utils::fileSize(archiveFilename.c_str());
+    if (size < 0) {
+        // moved by post_archive extension
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        Index& index = this->index(loggerId);
+        auto iter = index.byFilename.find(archiveFilename);
+        if (iter != index.byFilename.end()) {
+            // overwritten, e.g, same day next week
+            index.totalSize -= iter->second->size;
+            index.archives.erase(iter->second);
+            index.byFilename.erase(iter);
+        }
+        index.archives.push_back({ archiveFilename, static_cast<std::size_t>(size), Utils::now() });
+        index.byFilename.insert(std::make_pair(archiveFilename, std::prev(index.archives.end())));
+        index.totalSize += static_cast<std::size_t>(size);
+    }
+    enforce(loggerId);
+}
+
+void ArchiveRetention::enforce(const std::string& loggerId)
+{
+    const Configuration::ArchiveRetention retention = m_registry->configuration()->getArchiveRetention(loggerId);
+    if (!retention.isEnabled()) {
+        return;
+    }
+    const types::Time now = Utils::now();
+    std::vector<Archive> expired;
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        Index& index = this->index(loggerId);
+        // latest archive is always kept
+        while (index.archives.size() > 1) {
+            const Archive& oldest = index.archives.front();
+            if ((retention.maxCount == 0 || index.archives.size() <= retention.maxCount)
+                    && (retention.maxSize == 0 || index.totalSize <= retention.maxSize)
+                    && (retention.maxAge == 0 || now < oldest.created || now - oldest.created <= retention.maxAge)) {
+                break;
+            }
+            expired.push_back(oldest);
+            index.totalSize -= oldest.size;
+            index.byFilename.erase(oldest.filename);
+            index.archives.pop_front();
+        }
+    }
+    for (const auto& archive : expired) {
+        if (::remove(archive.filename.c_str()) != 0 && errno != ENOENT) {
+            RLOG(ERROR) << "Failed to remove archive [" << archive.filename << "] " << std::strerror(errno);
+            continue;
+        }
+        ::remove(ArchiveIndex::indexFilename(archive.filename).c_str());
+        ::remove(BloomFilter::filterFilename(archive.filename).c_str());
+        RLOG(INFO) << "Removed archive [" << archive.filename << "] (" << Utils::bytesToHumanReadable(static_cast<long>(archive.size))
+                   << ") for logger [" << loggerId << "] as per retention";
+    }
+}
+
+void ArchiveRetention::execute()
+{
+    // size and count are enforced as archives are added, this is for age
+    for (const auto& pair : m_registry->configuration()->archiveRetentions()) {
+        enforce(pair.first);
+    }
+}
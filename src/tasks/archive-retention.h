@@ -0,0 +1,118 @@
+//
+//  archive-retention.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef ArchiveRetention_h
+#define ArchiveRetention_h
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "tasks/task.h"
+
+namespace residue {
+
+class Configuration;
+class Registry;
+
+///
+/// \brief Removes oldest archives of loggers that are over their max_archive_size, max_archive_age
+/// or max_archive_count. Archives are tracked in memory as they are created, archives created before
+/// server started are found once by matching archive directory and filename of the logger
+///
+class ArchiveRetention final : public Task
+{
+public:
+    static const unsigned int CHECK_INTERVAL = 3600;
+
+    struct Archive
+    {
+        std::string filename;
+        std::size_t size;
+        types::Time created;
+    };
+
+    explicit ArchiveRetention(Registry* registry);
+
+    ///
+    /// \brief Indexes existing archives of all the loggers with retention and enforces it
+    ///
+    void rebuild();
+
+    ///
+    /// \brief Adds newly created archive to logger's index and enforces retention
+    ///
+    void add(const std::string& loggerId, const std::string& archiveFilename);
+
+    ///
+    /// \brief Archives of logger, oldest first
+    ///
+    std::vector<Archive> archives(const std::string& loggerId);
+
+    ///
+    /// \brief Whether filename matches the pattern, where each time based format specifier (e.g, %hour)
+    /// only matches values it resolves to (e.g, two digits). Sequence number added to archive name
+    /// (e.g, mylogs.2.tar.gz) is ignored
+    ///
+    static bool matchesArchivePattern(const std::string& filename, const std::string& pattern);
+
+    ///
+    /// \brief Pattern of archive path for logger (see archived_log_directory and archived_log_compressed_filename)
+    /// \param originalDir Directory of log file for %original
+    ///
+    static std::string archivePattern(const std::string& loggerId, const std::string& directory,
+                                      const std::string& compressedFilename, const std::string& originalDir);
+
+    ///
+    /// \brief Archive patterns of registered logger, one for each directory of its log files
+    ///
+    static std::unordered_set<std::string> archivePatterns(const Configuration* configuration, const std::string& loggerId);
+
+    ///
+    /// \brief Archives that match the pattern, in no particular order
+    ///
+    static std::vector<Archive> findArchives(const std::string& pattern);
+
+protected:
+    virtual void execute() override;
+
+private:
+    struct Index
+    {
+        // oldest first
+        std::list<Archive> archives;
+        std::unordered_map<std::string, std::list<Archive>::iterator> byFilename;
+        std::size_t totalSize;
+    };
+
+    std::unordered_map<std::string, Index> m_indexes;
+    std::mutex m_mutex;
+
+    ///
+    /// \brief Caller must hold m_mutex
+    ///
+    Index& index(const std::string& loggerId);
+
+    std::vector<Archive> findLoggerArchives(const std::string& loggerId) const;
+    void enforce(const std::string& loggerId);
+};
+}
+#endif /* ArchiveRetention_h */
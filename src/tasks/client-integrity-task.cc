@@ -34,65 +34,27 @@ ClientIntegrityTask::ClientIntegrityTask(Registry* registry,
 {
 }
 
-void ClientIntegrityTask::performCleanup(const std::string& clientId)
+void ClientIntegrityTask::execute()
 {
-    auto iter = m_registry->clients().find(clientId);
-    if (iter == m_registry->clients().end()) {
-        // This is possible in case of "unknown"
-        return;
-    }
-    Client* client = &(iter->second);
-    if (!client->isAlive()) {
-        // Do not use m_registry.removeClient, instead,
-        // manually remove as we need to manually increment
-        // iterator as erase invalidates it
-        std::lock_guard<std::recursive_mutex> lock(m_registry->mutex());
-        m_registry->clients().erase(iter);
-    } else {
-        if (!client->backupKey().empty()) {
-            RVLOG(RV_WARNING) << "Removing backup key for [" << client->id() << "]";
-            client->setBackupKey("");
+    // Requests that are still in queues hold their own handle to the client
+    // so removing it from registry does not invalidate them. Those requests
+    // are validated against date received and are still processed
+    for (const auto& client : m_registry->expiredClients(Utils::now())) {
+        if (m_registry->removeClientIf(client, [](const Client* c) { return !c->isAlive(); })) {
+            RLOG(INFO) << "Client [" << client->id() << "] expired";
         }
     }
-}
-
-void ClientIntegrityTask::execute()
-{
-    auto* list = &(m_registry->clients());
-    for (auto clientIter = list->begin(); clientIter != list->end();) {
-        Client* client = &(clientIter->second);
-        if (!client->isAlive()) {
-
-            std::lock_guard<std::mutex> pausedClientsLock(m_mutex);
-            auto pos = m_pausedClients.find(client->id());
-            if (pos == m_pausedClients.end()) {
 
-                // here we check for unmanaged clients
-                // we may be removing a "paused" unmanaged client
-                // as m_pausedClients for unmanaged client will be "unknown"
-                if (!client->isManaged() && m_pausedClients.find(Configuration::UNMANAGED_CLIENT_ID) != m_pausedClients.end()) {
-                    // yes we are surely removing a paused unmanaged client
-                    // that we shouldn't do
-                    RLOG(INFO) << "Unmanaged client [" << client->id() << "] expired - Paused removal";
-                    ++clientIter; // skip and move on
-                } else {
-                    RLOG(INFO) << "Client [" << client->id() << "] expired";
-                    // Do not use m_registry.removeClient, instead,
-                    // manually remove as we need to manually increment
-                    // iterator as erase invalidates it
-                    std::lock_guard<std::recursive_mutex> lock(m_registry->mutex());
-                    m_registry->clients().erase(clientIter++);
-                }
-            } else {
-                RLOG(INFO) << "Client [" << client->id() << "] expired - Paused removal";
-                ++clientIter; // skip and move on
+    for (const auto& clientId : m_registry->clientsWithBackupKey()) {
+        std::shared_ptr<Client> client = m_registry->updateClient(clientId, [](Client* c) {
+            if (!c->isAlive() || c->backupKey().empty()) {
+                return false;
             }
-        } else {
-            if (!client->backupKey().empty()) {
-                RVLOG(RV_WARNING) << "Removing backup key for [" << client->id() << "]";
-                client->setBackupKey("");
-            }
-            ++clientIter;
+            c->setBackupKey("");
+            return true;
+        });
+        if (client != nullptr) {
+            RVLOG(RV_WARNING) << "Removing backup key for [" << client->id() << "]";
         }
     }
 
@@ -20,8 +20,6 @@
 #ifndef ClientIntegrityTask_h
 #define ClientIntegrityTask_h
 
-#include <unordered_set>
-#include <mutex>
 #include "tasks/task.h"
 
 namespace residue {
@@ -36,33 +34,8 @@ class ClientIntegrityTask final : public Task
 {
 public:
     ClientIntegrityTask(Registry* registry, unsigned int interval);
-
-    ///
-    /// \brief Perform forceful clean up for specified client
-    ///
-    void performCleanup(const std::string&);
-
-    inline void pauseClient(const std::string& clientId)
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_pausedClients.find(clientId) == m_pausedClients.end()) {
-            m_pausedClients.insert(clientId);
-        }
-    }
-
-    inline void resumeClient(const std::string& clientId)
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto pos = m_pausedClients.find(clientId);
-        if (pos != m_pausedClients.end()) {
-            m_pausedClients.erase(pos);
-        }
-    }
 protected:
     virtual void execute() override;
-private:
-    std::unordered_set<std::string> m_pausedClients;
-    std::mutex m_mutex;
 };
 }
 #endif /* ClientIntegrityTask_h */
@@ -19,19 +19,27 @@
 
 #include "tasks/log-rotator.h"
 
-#include <cmath>
+#include <cstring>
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iterator>
+#include <mutex>
 #include <set>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 
 #include "core/registry.h"
 #include "core/residue-exception.h"
-#include "crypto/zlib.h"
 #include "extensions/pre-archive-extension.h"
 #include "extensions/post-archive-extension.h"
 #include "logging/log.h"
+#include "logging/residue-log-dispatcher.h"
+#include "tasks/archive-retention.h"
+#include "tasks/log-segmenter.h"
+#include "utils/bloom-filter.h"
 #include "utils/utils.h"
 
 using namespace residue;
@@ -39,6 +47,9 @@ using namespace residue;
 static const char* kDaysAbbrev[7]                   =      { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
 static const char* kMonthsAbbrev[12]                =      { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
 
+// archive extensions are shared by all the rotators and archiving threads
+static std::mutex s_archiveExtensionsMutex;
+
 
 LogRotator::LogRotator(const std::string& name,
                        Registry* registry,
@@ -65,12 +76,38 @@ void LogRotator::execute()
 
 void LogRotator::archiveRotatedItems()
 {
-    RVLOG_IF(!m_archiveItems.empty(), RV_DETAILS) << "Archiving rotated logs... [Total loggers: " << m_archiveItems.size() << "]";
-    for (auto& item : m_archiveItems) {
-        std::thread t([&]() {
-            el::Helpers::setThreadName(name() + "::LogArchiver");
-            archiveAndCompress(item.loggerId, item.archiveFilename, item.files);
-        });
+    if (m_archiveItems.empty()) {
+        return;
+    }
+    const std::size_t total = m_archiveItems.size();
+    const std::size_t threadCount = std::min<std::size_t>(total, m_registry->configuration()->archiveThreads());
+    const int niceness = static_cast<int>(m_registry->configuration()->archiveNice());
+    // threads that are not needed for archiving loggers in parallel compress blocks
+    // of the same archive instead, e.g, single big logger gets all the threads
+    const unsigned int compressThreads = std::max(1U, static_cast<unsigned int>(m_registry->configuration()->archiveThreads() / threadCount));
+    RVLOG(RV_DETAILS) << "Archiving rotated logs... [Total loggers: " << total << ", threads: " << threadCount
+                      << " x " << compressThreads << "]";
+
+    // bounded pool, each thread picks next item until all are done
+    std::atomic<std::size_t> nextItem(0);
+    std::atomic<std::size_t> completed(0);
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        threads.push_back(std::thread([&, i]() {
+            el::Helpers::setThreadName(name() + "::LogArchiver#" + std::to_string(i));
+            Utils::lowerCurrentThreadPriority(niceness);
+            std::size_t idx;
+            while ((idx = nextItem.fetch_add(1)) < total) {
+                const ArchiveItem& item = m_archiveItems[idx];
+                types::Time started = Utils::now();
+                archiveAndCompress(item.loggerId, item.archiveFilename, item.files, item.segments, item.bloomFilters, compressThreads);
+                RLOG(INFO) << "Archived [" << (completed.fetch_add(1) + 1) << "/" << total << "] logger ["
+                           << item.loggerId << "] in " << (Utils::now() - started) << "s";
+            }
+        }));
+    }
+    for (auto& t : threads) {
         t.join();
     }
     m_archiveItems.clear();
@@ -96,7 +133,7 @@ LogRotator::RotateTarget LogRotator::createRotateTarget(const std::string& logge
     int currentDay = local_tm.tm_mday;
     std::string currentWDay = kDaysAbbrev[local_tm.tm_wday];
     std::string currentMonth = kMonthsAbbrev[local_tm.tm_mon];
-    std::string currentQuarter = "Q" + std::to_string(std::ceil((local_tm.tm_mon + 1) / 3));
+    std::string currentQuarter = "Q" + std::to_string(local_tm.tm_mon / 3 + 1);
     std::string currentYear = std::to_string(local_tm.tm_year + 1900);
 
     std::string currentHourStr = currentHour < 10 ?
@@ -148,18 +185,27 @@ LogRotator::RotateTarget LogRotator::createRotateTarget(const std::string& logge
 
     if (logger != nullptr) {
 
-        //=========================== [ NOTE ]===============================
-        //
-        // Be careful, do not log here using residue logger until this scope
-        //
-        //===================================================================
+        // only filenames are read under logger's lock, everything else is resolved
+        // without blocking the dispatch
+        std::string globalFilename;
+        std::vector<std::pair<std::string, std::string>> levelFilenames; // level identifier => filename
+        {
+            std::lock_guard<std::recursive_mutex> l(logger->lock());
+            globalFilename = logger->typedConfigurations()->filename(el::Level::Global);
+            el::base::type::EnumType lIndex = el::LevelHelper::kMinValid;
+            el::LevelHelper::forEachLevel(&lIndex, [&](void) -> bool {
+                el::Level level = el::LevelHelper::castFromInt(lIndex);
+                std::string levelIdentifier(el::LevelHelper::convertToString(level));
+                Utils::toLower(levelIdentifier);
+                levelFilenames.push_back(std::make_pair(levelIdentifier, logger->typedConfigurations()->filename(level)));
+                return false;
+            });
+        }
 
         std::unordered_set<std::string> fileByLevel;
 
         std::unordered_map<std::string, std::set<std::string>> levelsInFilename;
 
-        std::lock_guard<std::recursive_mutex> l(logger->lock());
-
         // mv fnInfo -> mylogs-17-00-19-Feb-info.log
         // mv fnError -> mylogs-17-00-19-Feb-error.log
         //
@@ -172,14 +218,9 @@ LogRotator::RotateTarget LogRotator::createRotateTarget(const std::string& logge
         // mv fnDebug (consequently fnTrace) to mylogs-17-00-19-Feb-debug.log
         // mv fnWarning (consequently fnVerbose) to mylogs-17-00-19-Feb-warning-verbose.log
 
-        const std::string globalFilename = logger->typedConfigurations()->filename(el::Level::Global);
-
-        el::base::type::EnumType lIndex = el::LevelHelper::kMinValid;
-        el::LevelHelper::forEachLevel(&lIndex, [&](void) -> bool {
-            el::Level level = el::LevelHelper::castFromInt(lIndex);
-            std::string levelIdentifier(el::LevelHelper::convertToString(level));
-            Utils::toLower(levelIdentifier);
-            std::string filename = logger->typedConfigurations()->filename(level);
+        for (const auto& levelFilename : levelFilenames) {
+            const std::string& levelIdentifier = levelFilename.first;
+            const std::string& filename = levelFilename.second;
             DRVLOG_IF(loggerId != RESIDUE_LOGGER_ID, RV_DEBUG) << "FSR: level [" << levelIdentifier << "] => [" << filename << "]";
 
             fileByLevel.insert(filename);
@@ -189,8 +230,7 @@ LogRotator::RotateTarget LogRotator::createRotateTarget(const std::string& logge
             } else {
                 levelsInFilename[filename].insert(customIdentifier);
             }
-            return false;
-        });
+        }
 
         items.reserve(fileByLevel.size());
 
@@ -241,90 +281,281 @@ LogRotator::RotateTarget LogRotator::createRotateTarget(const std::string& logge
     return { initDestinationDir, archiveFilename, items };
 }
 
-void LogRotator::rotate(const std::string& loggerId)
+std::string LogRotator::sequencedFilename(const std::string& filename, unsigned int sequence)
+{
+    if (sequence == 0) {
+        return filename;
+    }
+    std::size_t pos = std::string::npos;
+    for (const char* ext : { ".tar.gz", ".tar.zst" }) {
+        if (Utils::endsWith(filename, ext)) {
+            pos = filename.size() - std::strlen(ext);
+            break;
+        }
+    }
+    if (pos == std::string::npos) {
+        pos = filename.find_last_of('.');
+    }
+    if (pos == std::string::npos || pos == 0) {
+        return filename + "." + std::to_string(sequence);
+    }
+    return filename.substr(0, pos) + "." + std::to_string(sequence) + filename.substr(pos);
+}
+
+void LogRotator::applyNextSequence(RotateTarget* rotateTarget, unsigned int firstSequence)
+{
+    // first sequence where neither archive nor any of rotated files exist (previous
+    // archive may have failed and left rotated files behind)
+    auto isAvailable = [&](unsigned int sequence) -> bool {
+        std::string archivePath = rotateTarget->destinationDir + el::base::consts::kFilePathSeparator
+                + sequencedFilename(rotateTarget->archiveFilename, sequence);
+        if (Utils::fileExists(archivePath.c_str())) {
+            return false;
+        }
+        for (const auto& item : rotateTarget->items) {
+            std::string path = item.destinationDir + sequencedFilename(item.targetFilename, sequence);
+            if (Utils::fileExists(path.c_str())) {
+                return false;
+            }
+        }
+        return true;
+    };
+    unsigned int sequence = firstSequence;
+    while (!isAvailable(sequence)) {
+        ++sequence;
+    }
+    rotateTarget->archiveFilename = sequencedFilename(rotateTarget->archiveFilename, sequence);
+    for (auto& item : rotateTarget->items) {
+        item.targetFilename = sequencedFilename(item.targetFilename, sequence);
+    }
+}
+
+bool LogRotator::prepareSwap(FileSwap* swap, const el::Logger* logger, const Configuration* conf)
+{
+    // rotators and segmenter can prepare swaps for same file at the same time
+    swap->replacement = swap->sourceFilename + ".rotating-" + Utils::generateRandomString(6);
+    std::ofstream replacementStream(swap->replacement, std::ios::out | std::ios::trunc);
+    if (!replacementStream.is_open()) {
+        RLOG_IF(logger->id() != RESIDUE_LOGGER_ID, ERROR) << "Failed to create [" << swap->replacement << "] for log rotation "
+                                                          << std::strerror(errno);
+        return false;
+    }
+    replacementStream.close();
+    Utils::updateFilePermissions(swap->replacement.c_str(), logger, conf);
+    return true;
+}
+
+void LogRotator::swapFiles(el::Logger* logger, std::vector<FileSwap>* swaps, std::vector<std::string>* errors,
+                           bool resetWrittenBytes)
+{
+    std::unordered_set<std::string> swappedFilenames;
+    ResidueLogDispatcher* dispatcher = el::Helpers::logDispatchCallback<ResidueLogDispatcher>("ResidueLogDispatcher");
+    for (auto& swap : *swaps) {
+        if (::rename(swap.sourceFilename.c_str(), swap.destination.c_str()) != 0) {
+            errors->push_back("Error moving file [" + swap.sourceFilename + "] to ["
+                              + swap.destination + "] " + std::strerror(errno));
+            continue;
+        }
+        swap.swapped = true;
+        swappedFilenames.insert(swap.sourceFilename);
+        if (dispatcher != nullptr) {
+            swap.bloomFilter = dispatcher->takeBloomFilter(swap.sourceFilename);
+        }
+        if (::rename(swap.replacement.c_str(), swap.sourceFilename.c_str()) != 0) {
+            // stream will create it on reopen (without ownership)
+            errors->push_back("Error moving file [" + swap.replacement + "] to ["
+                              + swap.sourceFilename + "] " + std::strerror(errno));
+        }
+    }
+
+    // streams still point to moved files, reopen them on new (empty) files.
+    // Buffered lines are flushed in to moved files as they are closed
+
+    std::unordered_set<std::string> doneList;
+    el::base::type::EnumType lIndex = el::LevelHelper::kMinValid;
+    el::LevelHelper::forEachLevel(&lIndex, [&](void) -> bool {
+        el::Level level = el::LevelHelper::castFromInt(lIndex);
+        const std::string& fn = logger->typedConfigurations()->filename(level);
+        if (swappedFilenames.find(fn) == swappedFilenames.end() || !doneList.insert(fn).second) {
+            return false;
+        }
+        el::base::type::fstream_t* fs = logger->typedConfigurations()->fileStream(level);
+        if (fs != nullptr && fs->is_open()) {
+            fs->close();
+            fs->open(fn, std::fstream::out | std::fstream::app);
+        }
+        if (resetWrittenBytes && dispatcher != nullptr) {
+            dispatcher->resetWrittenBytes(fn);
+        }
+        return false;
+    });
+}
+
+void LogRotator::cleanUpSwaps(const std::vector<FileSwap>& swaps)
+{
+    for (const auto& swap : swaps) {
+        if (!swap.swapped) {
+            ::remove(swap.replacement.c_str());
+        }
+    }
+}
+
+bool LogRotator::writeBloomFilter(const FileSwap& swap, const el::Logger* logger, const Configuration* conf)
+{
+    if (!swap.swapped) {
+        return false;
+    }
+    std::shared_ptr<BloomFilter> bloomFilter = swap.bloomFilter;
+    if (bloomFilter == nullptr) {
+        // file had lines before its filter was started (e.g, server started or configuration reloaded)
+        const Configuration::BloomFilterOptions options = conf->getBloomFilterOptions(logger->id());
+        if (options.size == 0 || logger->id() == RESIDUE_LOGGER_ID) {
+            return false;
+        }
+        bloomFilter = BloomFilter::build(swap.destination, options.size, options.falsePositiveRate);
+        if (bloomFilter == nullptr) {
+            return false;
+        }
+        RVLOG(RV_DETAILS) << "Built bloom filter of [" << swap.destination << "] from its content";
+    }
+    const std::string filename = BloomFilter::filterFilename(swap.destination);
+    if (!BloomFilter::write(filename, { { 0, bloomFilter.get() } })) {
+        // search scans the file instead
+        ::remove(filename.c_str());
+        return false;
+    }
+    Utils::updateFilePermissions(filename.c_str(), logger, conf);
+    return true;
+}
+
+void LogRotator::rotate(const std::string& loggerId, bool withSequence)
 {
 #ifdef RESIDUE_PROFILING
     types::Time m_timeTaken;
     RESIDUE_PROFILE_START(t_rotation);
 #endif
 
-    const RotateTarget rotateTarget = createRotateTarget(loggerId);
+    RotateTarget rotateTarget = createRotateTarget(loggerId);
+    applyNextSequence(&rotateTarget, withSequence ? 1 : 0);
 
     std::unordered_map<std::string, std::string> files;
     el::Logger* logger = el::Loggers::getLogger(loggerId, false);
 
+    Utils::CompressedSegments segments;
+    std::unordered_map<std::string, std::string> bloomFilters;
+
     if (logger != nullptr) {
 
-        //=========================== [ NOTE ]===============================
-        //
-        // Be careful, do not log here using residue logger until this scope
-        //
-        //===================================================================
+        // Anything that can be slow (directories, stat, creating replacement files and
+        // setting their ownership) is done before we lock the logger so dispatch is only
+        // paused for renames and reopening the streams
 
-        std::lock_guard<std::recursive_mutex> l(logger->lock());
+        const Configuration* conf = m_registry->configuration();
+        LogSegmenter* segmenter = m_registry->logSegmenter();
 
-        // Create backups
+        std::vector<FileSwap> swaps;
+        std::vector<std::string> targetFilenames;
+        swaps.reserve(rotateTarget.items.size());
 
         for (const auto& backItem : rotateTarget.items) {
 
             if (!Utils::fileExists(backItem.destinationDir.c_str())) {
                 if (!Utils::createPath(backItem.destinationDir.c_str())) {
                     RLOG_IF(loggerId != RESIDUE_LOGGER_ID, ERROR) << "Failed to create path for log rotation: " << backItem.destinationDir;
+                    cleanUpSwaps(swaps);
                     return;
                 }
             }
             std::string fullDestinationPath = backItem.destinationDir + backItem.targetFilename;
             long fsize = Utils::fileSize(backItem.sourceFilename.c_str());
-            if (fsize > 0) {
-                RVLOG_IF(loggerId != RESIDUE_LOGGER_ID, RV_DETAILS) << "Rotating [" << backItem.sourceFilename
-                                                                    << "] => [" << fullDestinationPath
-                                                                    << "] (" << Utils::bytesToHumanReadable(fsize) << ")";
-                if (::rename(backItem.sourceFilename.c_str(), fullDestinationPath.c_str()) == 0) {
-                    files.insert(std::make_pair(fullDestinationPath, backItem.targetFilename));
-                } else {
-                    RLOG_IF(loggerId != RESIDUE_LOGGER_ID, ERROR) << "Error moving file ["
-                                                                  << backItem.sourceFilename << "] to ["
-                                                                  << fullDestinationPath << "] " << std::strerror(errno);
-                }
-            } else {
+            // file may be empty because it was just segmented
+            if (fsize <= 0 && (segmenter == nullptr || !segmenter->hasSegments(backItem.sourceFilename))) {
                 RVLOG_IF(loggerId != RESIDUE_LOGGER_ID, RV_DETAILS) << "Ignoring rotating empty file " << backItem.sourceFilename;
+                continue;
             }
+            FileSwap swap { backItem.sourceFilename, fullDestinationPath, "", false, nullptr };
+            if (!prepareSwap(&swap, logger, conf)) {
+                continue;
+            }
+
+            RVLOG_IF(loggerId != RESIDUE_LOGGER_ID, RV_DETAILS) << "Rotating [" << backItem.sourceFilename
+                                                                << "] => [" << fullDestinationPath
+                                                                << "] (" << Utils::bytesToHumanReadable(fsize) << ")";
+            swaps.push_back(swap);
+            targetFilenames.push_back(backItem.targetFilename);
         }
 
-        // Truncate log files
+        // errors are logged once lock is released
+        std::vector<std::string> errors;
+        std::vector<std::vector<std::shared_ptr<LogSegmenter::Segment>>> takenSegments(swaps.size());
 
-        std::unordered_set<std::string> doneList;
-        auto closeAndTrunc = [&](el::base::type::fstream_t* fs, const std::string& fn) {
-            if (doneList.find(fn) != doneList.end()) {
-                return;
-            }
-            if (fs && fs->is_open() && !fs->fail()) {
-                fs->close();
-                fs->open(fn, std::fstream::out | std::fstream::trunc);
-                Utils::updateFilePermissions(fn.data(), logger, m_registry->configuration());
+        {
+            //=========================== [ NOTE ]===============================
+            //
+            // Be careful, do not log here using residue logger until this scope
+            //
+            //===================================================================
+
+            std::lock_guard<std::recursive_mutex> l(logger->lock());
+
+            swapFiles(logger, &swaps, &errors, true);
+
+            // segments closed so far belong to this rotation
+            for (std::size_t i = 0; segmenter != nullptr && i < swaps.size(); ++i) {
+                if (swaps[i].swapped) {
+                    takenSegments[i] = segmenter->takeSegments(swaps[i].sourceFilename);
+                }
             }
-            doneList.insert(fn);
-        };
 
+        } // scope for logger lock
 
-        el::base::type::EnumType lIndex = el::LevelHelper::kMinValid;
-        el::LevelHelper::forEachLevel(&lIndex, [&](void) -> bool {
-            el::Level level = el::LevelHelper::castFromInt(lIndex);
-            closeAndTrunc(logger->typedConfigurations()->fileStream(level), logger->typedConfigurations()->filename(level));
-            return false;
-        });
+        cleanUpSwaps(swaps);
+        for (const auto& error : errors) {
+            RLOG_IF(loggerId != RESIDUE_LOGGER_ID, ERROR) << error;
+        }
 
-    } // scope for logger lock
+        const Utils::ArchiveFormat format = Utils::compressedArchiveFormat(rotateTarget.archiveFilename);
+        for (std::size_t i = 0; i < swaps.size(); ++i) {
+            if (!swaps[i].swapped) {
+                continue;
+            }
+            files.insert(std::make_pair(swaps[i].destination, targetFilenames[i]));
+            if (writeBloomFilter(swaps[i], logger, conf)) {
+                bloomFilters.insert(std::make_pair(swaps[i].destination, BloomFilter::filterFilename(swaps[i].destination)));
+            }
+            if (takenSegments[i].empty()) {
+                continue;
+            }
+            std::vector<Utils::CompressedSegment> compressedSegments;
+            if (segmenter->compressTaken(loggerId, swaps[i].sourceFilename, takenSegments[i], format, &compressedSegments)) {
+                segments.insert(std::make_pair(swaps[i].destination, compressedSegments));
+                for (const auto& segment : takenSegments[i]) {
+                    std::string filterFilename = BloomFilter::filterFilename(segment->filename);
+                    if (Utils::fileExists(filterFilename.c_str())) {
+                        bloomFilters.insert(std::make_pair(segment->compressedFilename, filterFilename));
+                    }
+                }
+            } else {
+                RLOG_IF(loggerId != RESIDUE_LOGGER_ID, ERROR) << "Segments of [" << swaps[i].sourceFilename
+                                                              << "] are not archived, they are left for next rotation";
+                segmenter->restoreSegments(swaps[i].sourceFilename, std::move(takenSegments[i]));
+            }
+        }
+    }
 
 #ifdef RESIDUE_PROFILING
     RESIDUE_PROFILE_END(t_rotation, m_timeTaken);
     float timeTakenInSec = static_cast<float>(m_timeTaken / 1000.0f);
     DRVLOG_IF(loggerId != RESIDUE_LOGGER_ID, RV_DEBUG) << "Took " << timeTakenInSec << " s rotate logs for logger [" << loggerId << "] (" << files.size() << " files)";
 #endif
-    m_archiveItems.push_back({loggerId, rotateTarget.destinationDir + el::base::consts::kFilePathSeparator + rotateTarget.archiveFilename, files});
+    m_archiveItems.push_back({loggerId, rotateTarget.destinationDir + el::base::consts::kFilePathSeparator + rotateTarget.archiveFilename, files, segments, bloomFilters});
 }
 
-void LogRotator::archiveAndCompress(const std::string& loggerId, const std::string& archiveFilename, const std::unordered_map<std::string, std::string>& files) {
+void LogRotator::archiveAndCompress(const std::string& loggerId, const std::string& archiveFilename,
+                                    const std::unordered_map<std::string, std::string>& files,
+                                    const Utils::CompressedSegments& segments,
+                                    const std::unordered_map<std::string, std::string>& bloomFilters,
+                                    unsigned int compressThreads) {
     if (files.empty()) {
         RLOG(INFO) << "No file to archive for [" << loggerId << "]";
         return;
@@ -341,6 +572,9 @@ void LogRotator::archiveAndCompress(const std::string& loggerId, const std::stri
             files
         };
         bool continueProcess = true;
+        // extensions skip (rather than wait) when they are already running so
+        // they are triggered one archive at a time
+        std::lock_guard<std::mutex> lock_(s_archiveExtensionsMutex);
         for (auto& ext : m_registry->configuration()->preArchiveExtensions()) {
             auto extResult = ext->trigger(&d);
             continueProcess = continueProcess && extResult.continueProcess;
@@ -355,9 +589,25 @@ void LogRotator::archiveAndCompress(const std::string& loggerId, const std::stri
     // compress files after logger's lock is released
     RVLOG(RV_DETAILS) << "Compressing rotated files for logger [" << loggerId << "] to [" << archiveFilename << "]";
 
-    std::string tmpTar = archiveFilename + ".tar";
-    if (!Utils::archiveFiles(tmpTar, files)) {
-        RLOG(ERROR) << "Failed to archive rotated log for logger [" << loggerId << "]. Destination name: [" << archiveFilename + ".tar" << "]";
+    const Configuration* conf = m_registry->configuration();
+    const Utils::ArchiveFormat format = Utils::compressedArchiveFormat(archiveFilename);
+    // with segments most of the data is already compressed and only copied in, and
+    // archive can be indexed by time range of segments
+    std::vector<ArchiveFrame> frames;
+    bool archived = segments.empty() ?
+                Utils::archiveFiles(archiveFilename, files, format, compressThreads,
+                                    conf->archiveZstdLevel(), conf->archiveZstdLong()) :
+                Utils::archiveFilesWithSegments(archiveFilename, files, segments, format, compressThreads,
+                                                conf->archiveZstdLevel(), conf->archiveZstdLong(), &frames);
+    // index and filters of previous archive with same name
+    ::remove(ArchiveIndex::indexFilename(archiveFilename).c_str());
+    ::remove(BloomFilter::filterFilename(archiveFilename).c_str());
+    if (!archived) {
+        RLOG(ERROR) << "Failed to archive rotated log for logger [" << loggerId << "]. Destination name: [" << archiveFilename << "]";
+        // rotated files are left as they are so nothing is lost
+        if (::remove(archiveFilename.c_str()) != 0 && errno != ENOENT) {
+            RLOG(WARNING) << "Failed to remove incomplete archive: " << std::strerror(errno);
+        }
         return;
     }
 
@@ -367,32 +617,68 @@ void LogRotator::archiveAndCompress(const std::string& loggerId, const std::stri
             RLOG(ERROR) << "Error removing file [" << f.first << "] " << std::strerror(errno);
         }
     }
+    for (auto& s : segments) {
+        for (auto& segment : s.second) {
+            if (::remove(segment.filename.c_str()) != 0) {
+                RLOG(ERROR) << "Error removing segment [" << segment.filename << "] " << std::strerror(errno);
+            }
+        }
+    }
 
-    bool compressSuccessful = ZLib::compressFile(archiveFilename, tmpTar); // nothrow func
+    if (!frames.empty() && !ArchiveIndex::write(archiveFilename, frames)) {
+        RLOG(WARNING) << "Failed to write index for [" << archiveFilename << "]";
+        ::remove(ArchiveIndex::indexFilename(archiveFilename).c_str());
+        frames.clear();
+    }
+
+    // filters of rotated files and segments are combined for archive, keyed by frame
+    bool hasBloomFilters = false;
+    if (!frames.empty() && !bloomFilters.empty()) {
+        std::vector<BloomFilter> filters(frames.size());
+        std::vector<std::pair<std::size_t, const BloomFilter*>> keyedFilters;
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            auto iter = bloomFilters.find(frames[i].source);
+            if (iter != bloomFilters.end() && BloomFilter::read(iter->second, 0, &filters[i])) {
+                keyedFilters.push_back(std::make_pair(frames[i].offset, &filters[i]));
+            }
+        }
+        if (!keyedFilters.empty()) {
+            hasBloomFilters = BloomFilter::write(BloomFilter::filterFilename(archiveFilename), keyedFilters);
+            if (!hasBloomFilters) {
+                RLOG(WARNING) << "Failed to write bloom filters for [" << archiveFilename << "]";
+                ::remove(BloomFilter::filterFilename(archiveFilename).c_str());
+            }
+        }
+    }
+    for (const auto& pair : bloomFilters) {
+        ::remove(pair.second.c_str());
+    }
 
     const el::Logger* logger = el::Loggers::getLogger(loggerId, false);
     if (logger != nullptr) {
         RVLOG(RV_DETAILS) << "Updating permissions for " << archiveFilename << " against logger [" << loggerId << "]";
         Utils::updateFilePermissions(archiveFilename.data(), logger, m_registry->configuration());
-    }
-
-    if (compressSuccessful) {
-        if (::remove(tmpTar.c_str()) != 0) {
-            RLOG(WARNING) << "Compressed file successfully but failed to remove tar: " << std::strerror(errno);
+        if (!frames.empty()) {
+            Utils::updateFilePermissions(ArchiveIndex::indexFilename(archiveFilename).c_str(), logger, m_registry->configuration());
         }
+        if (hasBloomFilters) {
+            Utils::updateFilePermissions(BloomFilter::filterFilename(archiveFilename).c_str(), logger, m_registry->configuration());
+        }
+    }
 
-        if (!m_registry->configuration()->postArchiveExtensions().empty()) {
-            PostArchiveExtension::Data d {
-                loggerId,
-                archiveFilename
-            };
-            for (auto& ext : m_registry->configuration()->postArchiveExtensions()) {
-                ext->trigger(&d);
-            }
+    if (!m_registry->configuration()->postArchiveExtensions().empty()) {
+        PostArchiveExtension::Data d {
+            loggerId,
+            archiveFilename
+        };
+        std::lock_guard<std::mutex> lock_(s_archiveExtensionsMutex);
+        for (auto& ext : m_registry->configuration()->postArchiveExtensions()) {
+            ext->trigger(&d);
         }
+    }
 
-    } else {
-        RLOG(ERROR) << "Failed to compress rotated log for logger [" << loggerId << "]. Destination name: [" << archiveFilename + "]";
+    if (m_registry->archiveRetention() != nullptr) {
+        m_registry->archiveRetention()->add(loggerId, archiveFilename);
     }
 }
 
@@ -566,3 +852,84 @@ types::Time YearlyLogRotator::calculateRoundOff(types::Time now) const
 
     return (secsToNextMidnight + (daysToNextMonth * 86400) + (monthsToNextYear * 28 * 86400) + (extraDays * 86400)) - 1;
 }
+
+const std::chrono::milliseconds SizeLogRotator::RETRY_INTERVAL = std::chrono::milliseconds(500);
+
+SizeLogRotator::SizeLogRotator(Registry* registry) :
+    LogRotator("SizeLogRotator", registry, Configuration::RotationFrequency::NEVER),
+    m_stopped(false)
+{
+    m_worker = std::thread([&]() {
+        el::Helpers::setThreadName("SizeLogRotator");
+        std::unique_lock<std::mutex> lock_(m_pendingMutex);
+        while (true) {
+            m_pendingCv.wait(lock_, [&]() { return m_stopped || !m_pending.empty(); });
+            if (m_stopped) {
+                break;
+            }
+            lock_.unlock();
+            bool ran = run();
+            lock_.lock();
+            if (!ran) {
+                m_pendingCv.wait_for(lock_, RETRY_INTERVAL, [&]() { return m_stopped; });
+            }
+        }
+    });
+}
+
+SizeLogRotator::~SizeLogRotator()
+{
+    {
+        std::lock_guard<std::mutex> lock_(m_pendingMutex);
+        m_stopped = true;
+    }
+    m_pendingCv.notify_one();
+    m_worker.join();
+}
+
+void SizeLogRotator::request(const std::string& loggerId)
+{
+    {
+        std::lock_guard<std::mutex> lock_(m_pendingMutex);
+        if (!m_pending.insert(loggerId).second) {
+            return;
+        }
+    }
+    m_pendingCv.notify_one();
+}
+
+bool SizeLogRotator::run()
+{
+    ExecutionGuard guard(this);
+    if (!guard.acquired()) {
+        return false;
+    }
+    m_lastExecution = Utils::now();
+    execute();
+    return true;
+}
+
+void SizeLogRotator::execute()
+{
+    ResidueLogDispatcher* dispatcher = el::Helpers::logDispatchCallback<ResidueLogDispatcher>("ResidueLogDispatcher");
+    while (true) {
+        std::string loggerId;
+        {
+            std::lock_guard<std::mutex> lock_(m_pendingMutex);
+            if (m_pending.empty()) {
+                break;
+            }
+            loggerId = *m_pending.begin();
+            m_pending.erase(m_pending.begin());
+        }
+        RLOG_IF(loggerId != RESIDUE_LOGGER_ID, INFO) << "Logger [" << loggerId << "] reached max_file_size, rotating...";
+        rotate(loggerId, true);
+        // successful swap has already reset written bytes. If rotation failed, it is requested again
+        // on next write instead of never being requested
+        if (dispatcher != nullptr) {
+            dispatcher->clearRotationRequest(loggerId);
+        }
+    }
+
+    archiveRotatedItems();
+}
@@ -20,6 +20,11 @@
 #ifndef LogRotator_h
 #define LogRotator_h
 
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -28,6 +33,7 @@
 
 namespace residue {
 
+class BloomFilter;
 class Registry;
 
 ///
@@ -41,6 +47,10 @@ public:
         std::string loggerId;
         std::string archiveFilename;
         std::unordered_map<std::string, std::string> files;
+        // compressed segments (see LogSegmenter) that precede rotated files
+        Utils::CompressedSegments segments;
+        // rotated file or compressed segment => its bloom filter (sidecar)
+        std::unordered_map<std::string, std::string> bloomFilters;
     };
 
     struct BackupItem
@@ -57,6 +67,19 @@ public:
         std::vector<BackupItem> items;
     };
 
+    ///
+    /// \brief Log file that is moved to destination and replaced by new empty file
+    ///
+    struct FileSwap
+    {
+        std::string sourceFilename;
+        std::string destination;
+        std::string replacement;
+        bool swapped;
+        // tokens written to source until it was swapped, if logger has bloom filter
+        std::shared_ptr<BloomFilter> bloomFilter;
+    };
+
     LogRotator(const std::string& name,
                Registry* registry,
                Configuration::RotationFrequency freq);
@@ -67,8 +90,49 @@ public:
         return m_frequency;
     }
 
-    void rotate(const std::string& loggerId);
+    ///
+    /// \param withSequence Always adds sequence number to rotated and archive filenames (size
+    /// based rotation). Otherwise sequence is only added if rotated files or archive from same
+    /// period already exist, so rotating more than once in same period does not overwrite previous one
+    ///
+    void rotate(const std::string& loggerId, bool withSequence = false);
     void archiveRotatedItems();
+
+    ///
+    /// \brief Inserts sequence before extension, e.g, mylogs.tar.gz => mylogs.2.tar.gz
+    ///
+    static std::string sequencedFilename(const std::string& filename, unsigned int sequence);
+
+    ///
+    /// \brief Applies first sequence (starting from firstSequence, 0 being no sequence) where neither
+    /// archive nor any of rotated files exist
+    ///
+    static void applyNextSequence(RotateTarget* rotateTarget, unsigned int firstSequence);
+
+    ///
+    /// \brief Creates empty replacement file (with permissions) for the swap. This is
+    /// done before logger is locked
+    ///
+    static bool prepareSwap(FileSwap* swap, const el::Logger* logger, const Configuration* conf);
+
+    ///
+    /// \brief Moves files to their destination, replacements in their place and reopens logger's streams.
+    /// Caller must hold logger's lock. Errors are added to the list to be logged once lock is released
+    ///
+    static void swapFiles(el::Logger* logger, std::vector<FileSwap>* swaps, std::vector<std::string>* errors,
+                          bool resetWrittenBytes);
+
+    ///
+    /// \brief Removes replacements that were not used
+    ///
+    static void cleanUpSwaps(const std::vector<FileSwap>& swaps);
+
+    ///
+    /// \brief Writes bloom filter of swapped file next to its destination (<destination>.bloom), filter is
+    /// built from destination if swap has none (i.e, file had lines before its filter was started)
+    /// \return False if logger has no bloom filter or it could not be written
+    ///
+    static bool writeBloomFilter(const FileSwap& swap, const el::Logger* logger, const Configuration* conf);
 protected:
     virtual void execute() override;
 
@@ -81,7 +145,10 @@ private:
 
     void archiveAndCompress(const std::string&,
                             const std::string&,
-                            const std::unordered_map<std::string, std::string>&);
+                            const std::unordered_map<std::string, std::string>&,
+                            const Utils::CompressedSegments&,
+                            const std::unordered_map<std::string, std::string>& bloomFilters,
+                            unsigned int compressThreads = 1);
 };
 
 #define DECL_LOG_ROTATOR(ID, NAME, FREQ)\
@@ -105,5 +172,41 @@ DECL_LOG_ROTATOR("YearlyLogRotator", YearlyLogRotator, YEARLY);
 
 #undef DECL_LOG_ROTATOR
 
+///
+/// \brief Rotates loggers that have grown beyond their max_file_size. This is not scheduled,
+/// dispatcher requests rotation and it is run on rotator's own thread so archiving large
+/// files does not hold up task scheduler's workers (e.g, client integrity task)
+///
+class SizeLogRotator final : public LogRotator
+{
+public:
+    explicit SizeLogRotator(Registry* registry);
+    ~SizeLogRotator();
+
+    ///
+    /// \brief Queues logger for rotation, does nothing if it is already queued
+    ///
+    void request(const std::string& loggerId);
+
+protected:
+    virtual void execute() override;
+
+private:
+    // wait before retrying when rotator is already executing (e.g, rotate command)
+    static const std::chrono::milliseconds RETRY_INTERVAL;
+
+    std::unordered_set<std::string> m_pending;
+    std::mutex m_pendingMutex;
+    std::condition_variable m_pendingCv;
+    bool m_stopped;
+    std::thread m_worker;
+
+    ///
+    /// \brief Rotates pending loggers
+    /// \return False if rotator is already executing, pending loggers are kept
+    ///
+    bool run();
+};
+
 }
 #endif /* LogRotator_h */
@@ -0,0 +1,403 @@
+//
+//  log-segmenter.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "tasks/log-segmenter.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+
+#include "core/configuration.h"
+#include "core/registry.h"
+#include "logging/log.h"
+#include "tasks/log-rotator.h"
+
+using namespace residue;
+
+static bool isDigits(const std::string& str)
+{
+    return !str.empty() && std::all_of(str.begin(), str.end(), ::isdigit);
+}
+
+LogSegmenter::LogSegmenter(Registry* registry) :
+    Task("LogSegmenter", registry, CHECK_INTERVAL),
+    m_stopped(false)
+{
+    m_compressor = std::thread([&]() {
+        el::Helpers::setThreadName(name() + "::Compressor");
+        std::unique_lock<std::mutex> lock_(m_pendingMutex);
+        while (true) {
+            m_pendingCv.wait(lock_, [&]() { return m_stopped || !m_pending.empty(); });
+            if (m_stopped) {
+                break;
+            }
+            std::vector<PendingSegment> pending;
+            pending.swap(m_pending);
+            lock_.unlock();
+            Utils::lowerCurrentThreadPriority(static_cast<int>(m_registry->configuration()->archiveNice()));
+            for (const auto& item : pending) {
+                // compress() does nothing for segments that are already compressed in the format
+                compress(std::get<0>(item), std::get<1>(item).get(), std::get<2>(item));
+            }
+            lock_.lock();
+        }
+    });
+}
+
+LogSegmenter::~LogSegmenter()
+{
+    {
+        std::lock_guard<std::mutex> lock_(m_pendingMutex);
+        m_stopped = true;
+    }
+    m_pendingCv.notify_one();
+    m_compressor.join();
+}
+
+std::string LogSegmenter::segmentFilename(const std::string& filename, unsigned int sequence)
+{
+    return filename + ".segment-" + std::to_string(sequence);
+}
+
+LogSegmenter::FileSegments& LogSegmenter::fileSegments(const std::string& filename)
+{
+    auto iter = m_files.find(filename);
+    if (iter != m_files.end()) {
+        return iter->second;
+    }
+    FileSegments& fileSegments = m_files[filename];
+    fileSegments.openedAt = Utils::now();
+    fileSegments.dataSince = 0;
+    fileSegments.nextSequence = 1;
+
+    // segments left by previous run (e.g, server restarted before rotation)
+    // are still part of this file
+    std::size_t pos = filename.find_last_of(el::base::consts::kFilePathSeparator);
+    std::string dirname = pos == std::string::npos ? "." : (pos == 0 ? "/" : filename.substr(0, pos));
+    std::string prefix = (pos == std::string::npos ? filename : filename.substr(pos + 1)) + ".segment-";
+
+    DIR* dir = opendir(dirname.c_str());
+    if (dir == nullptr) {
+        return fileSegments;
+    }
+    std::map<unsigned int, std::shared_ptr<Segment>> found;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name(entry->d_name);
+        if (!Utils::startsWith(name, prefix)) {
+            continue;
+        }
+        // <seq> or <seq>.<size>.<gz|zst>
+        std::string rest = name.substr(prefix.size());
+        std::size_t dot = rest.find('.');
+        std::string sequenceStr = rest.substr(0, dot);
+        if (!isDigits(sequenceStr)) {
+            continue;
+        }
+        unsigned int sequence = static_cast<unsigned int>(std::stoul(sequenceStr));
+        std::shared_ptr<Segment>& segment = found[sequence];
+        if (segment == nullptr) {
+            segment = std::make_shared<Segment>(Segment { sequence, segmentFilename(filename, sequence), "",
+                                                          Utils::ArchiveFormat::Tar, 0, 0, 0 });
+        }
+        if (dot == std::string::npos) {
+            continue;
+        }
+        std::string compressedPart = rest.substr(dot + 1);
+        std::size_t extPos = compressedPart.find('.');
+        std::string sizeStr = compressedPart.substr(0, extPos);
+        if (!isDigits(sizeStr) || extPos == std::string::npos) {
+            continue;
+        }
+        Utils::ArchiveFormat format = Utils::ArchiveFormat::Tar;
+        if (compressedPart.substr(extPos) == Utils::compressedExtension(Utils::ArchiveFormat::TarGz)) {
+            format = Utils::ArchiveFormat::TarGz;
+        } else if (compressedPart.substr(extPos) == Utils::compressedExtension(Utils::ArchiveFormat::TarZstd)) {
+            format = Utils::ArchiveFormat::TarZstd;
+        } else {
+            continue;
+        }
+        segment->compressedFilename = segment->filename + rest.substr(dot);
+        segment->format = format;
+        segment->size = static_cast<std::size_t>(std::stoull(sizeStr));
+    }
+    closedir(dir);
+
+    for (auto& pair : found) {
+        std::shared_ptr<Segment>& segment = pair.second;
+        struct stat st;
+        if (::stat(segment->filename.c_str(), &st) == 0) {
+            // uncompressed segment is only removed after compression is complete
+            if (!segment->compressedFilename.empty()) {
+                ::remove(segment->compressedFilename.c_str());
+                segment->compressedFilename.clear();
+                segment->format = Utils::ArchiveFormat::Tar;
+            }
+        } else if (segment->compressedFilename.empty() || ::stat(segment->compressedFilename.c_str(), &st) != 0) {
+            continue;
+        }
+        // closed around last write, opened when previous was closed
+        segment->from = fileSegments.dataSince;
+        segment->to = static_cast<types::Time>(st.st_mtime);
+        fileSegments.dataSince = segment->to;
+        fileSegments.segments.push_back(segment);
+        fileSegments.nextSequence = pair.first + 1;
+    }
+    return fileSegments;
+}
+
+bool LogSegmenter::hasSegments(const std::string& filename)
+{
+    std::lock_guard<std::mutex> lock_(m_filesMutex);
+    return !fileSegments(filename).segments.empty();
+}
+
+std::vector<std::shared_ptr<LogSegmenter::Segment>> LogSegmenter::takeSegments(const std::string& filename)
+{
+    std::vector<std::shared_ptr<Segment>> segments;
+    std::lock_guard<std::mutex> lock_(m_filesMutex);
+    auto iter = m_files.find(filename);
+    if (iter != m_files.end()) {
+        segments.swap(iter->second.segments);
+        // file was just rotated
+        iter->second.openedAt = Utils::now();
+        iter->second.dataSince = iter->second.openedAt;
+    }
+    return segments;
+}
+
+void LogSegmenter::restoreSegments(const std::string& filename, std::vector<std::shared_ptr<Segment>>&& segments)
+{
+    std::lock_guard<std::mutex> lock_(m_filesMutex);
+    FileSegments& fileSegments = m_files[filename];
+    segments.insert(segments.end(), fileSegments.segments.begin(), fileSegments.segments.end());
+    fileSegments.segments.swap(segments);
+}
+
+std::vector<LogSegmenter::Segment> LogSegmenter::segments(const std::string& filename)
+{
+    std::vector<Segment> segments;
+    std::lock_guard<std::mutex> lock_(m_filesMutex);
+    auto iter = m_files.find(filename);
+    if (iter != m_files.end()) {
+        for (const auto& segment : iter->second.segments) {
+            segments.push_back(*segment);
+        }
+    }
+    return segments;
+}
+
+bool LogSegmenter::compressTaken(const std::string& loggerId, const std::string& filename,
+                                 const std::vector<std::shared_ptr<Segment>>& segments,
+                                 Utils::ArchiveFormat format,
+                                 std::vector<Utils::CompressedSegment>* compressedSegments)
+{
+    for (const auto& segment : segments) {
+        if (!compress(loggerId, segment.get(), format)) {
+            return false;
+        }
+        compressedSegments->push_back({ segment->compressedFilename, segment->size, segment->from, segment->to });
+    }
+    RVLOG_IF(loggerId != RESIDUE_LOGGER_ID, RV_DETAILS) << "Bundling " << segments.size() << " segment(s) of [" << filename << "]";
+    return true;
+}
+
+bool LogSegmenter::compress(const std::string& loggerId, Segment* segment, Utils::ArchiveFormat format)
+{
+    std::lock_guard<std::mutex> lock_(m_compressMutex);
+    std::string previousCompressedFilename;
+    if (!segment->compressedFilename.empty()) {
+        if (segment->format == format) {
+            return true;
+        }
+        // archive format was changed (config reload) after segment was compressed, we
+        // restore raw segment and compress it again
+        RVLOG_IF(loggerId != RESIDUE_LOGGER_ID, RV_DETAILS) << "Recompressing segment [" << segment->compressedFilename << "]";
+        if (!Utils::decompressFile(segment->filename, segment->compressedFilename, segment->format)) {
+            RLOG_IF(loggerId != RESIDUE_LOGGER_ID, ERROR) << "Failed to decompress segment [" << segment->compressedFilename << "]";
+            ::remove(segment->filename.c_str());
+            return false;
+        }
+        previousCompressedFilename = segment->compressedFilename;
+    }
+    long size = Utils::fileSize(segment->filename.c_str());
+    if (size < 0) {
+        RLOG_IF(loggerId != RESIDUE_LOGGER_ID, ERROR) << "Segment [" << segment->filename << "] not found";
+        return false;
+    }
+    const Configuration* conf = m_registry->configuration();
+    std::string compressedFilename = segment->filename + "." + std::to_string(size) + Utils::compressedExtension(format);
+    if (!Utils::compressFile(compressedFilename, segment->filename, format,
+                             conf->archiveZstdLevel(), conf->archiveZstdLong())) {
+        RLOG_IF(loggerId != RESIDUE_LOGGER_ID, ERROR) << "Failed to compress segment [" << segment->filename << "]";
+        ::remove(compressedFilename.c_str());
+        if (!previousCompressedFilename.empty()) {
+            // segment is still in its previous format
+            ::remove(segment->filename.c_str());
+        }
+        return false;
+    }
+    el::Logger* logger = el::Loggers::getLogger(loggerId, false);
+    if (logger != nullptr) {
+        Utils::updateFilePermissions(compressedFilename.c_str(), logger, conf);
+    }
+    {
+        // before raw segment is removed so copies from segments() always have existing file
+        std::lock_guard<std::mutex> lock_(m_filesMutex);
+        segment->size = static_cast<std::size_t>(size);
+        segment->format = format;
+        segment->compressedFilename = compressedFilename;
+    }
+    if (::remove(segment->filename.c_str()) != 0) {
+        RLOG_IF(loggerId != RESIDUE_LOGGER_ID, ERROR) << "Error removing segment [" << segment->filename << "] "
+                                                      << std::strerror(errno);
+    }
+    if (!previousCompressedFilename.empty() && previousCompressedFilename != compressedFilename) {
+        ::remove(previousCompressedFilename.c_str());
+    }
+    return true;
+}
+
+void LogSegmenter::closeSegment(const std::string& loggerId, const std::string& filename)
+{
+    el::Logger* logger = el::Loggers::getLogger(loggerId, false);
+    if (logger == nullptr) {
+        return;
+    }
+    unsigned int sequence;
+    {
+        std::lock_guard<std::mutex> lock_(m_filesMutex);
+        sequence = fileSegments(filename).nextSequence++;
+    }
+    std::vector<LogRotator::FileSwap> swaps { { filename, segmentFilename(filename, sequence), "", false, nullptr } };
+    if (!LogRotator::prepareSwap(&swaps[0], logger, m_registry->configuration())) {
+        return;
+    }
+    std::vector<std::string> errors;
+    {
+        // no logging using residue logger in this scope, see LogRotator::rotate()
+        std::lock_guard<std::recursive_mutex> l(logger->lock());
+
+        // size counted for max_file_size is for whole file including segments
+        LogRotator::swapFiles(logger, &swaps, &errors, false);
+
+        if (swaps[0].swapped) {
+            // pushed under logger's lock so rotation either takes it or it
+            // belongs to next rotation, never in between
+            std::lock_guard<std::mutex> lock_(m_filesMutex);
+            FileSegments& fileSegments = m_files[filename];
+            const types::Time now = Utils::now();
+            fileSegments.segments.push_back(std::make_shared<Segment>(Segment { sequence, swaps[0].destination, "",
+                                                                                Utils::ArchiveFormat::Tar, 0,
+                                                                                fileSegments.dataSince, now }));
+            fileSegments.openedAt = now;
+            fileSegments.dataSince = now;
+        }
+    }
+    LogRotator::cleanUpSwaps(swaps);
+    LogRotator::writeBloomFilter(swaps[0], logger, m_registry->configuration());
+    for (const auto& error : errors) {
+        RLOG_IF(loggerId != RESIDUE_LOGGER_ID, ERROR) << error;
+    }
+    RVLOG_IF(swaps[0].swapped && loggerId != RESIDUE_LOGGER_ID, RV_DETAILS) << "Closed segment [" << swaps[0].destination << "]";
+}
+
+void LogSegmenter::execute()
+{
+    const Configuration* conf = m_registry->configuration();
+    const std::size_t segmentSize = conf->archiveSegmentSize();
+    const unsigned int segmentInterval = conf->archiveSegmentInterval();
+    if (segmentSize == 0 && segmentInterval == 0) {
+        return;
+    }
+
+    // only loggers that are rotated are segmented
+    std::unordered_set<std::string> loggerIds;
+    for (const auto& pair : conf->rotationFreqencies()) {
+        if (pair.second != Configuration::RotationFrequency::NEVER) {
+            loggerIds.insert(pair.first);
+        }
+    }
+    for (const auto& pair : conf->maxFileSizes()) {
+        loggerIds.insert(pair.first);
+    }
+
+    const types::Time now = Utils::now();
+    std::vector<std::pair<std::string, std::string>> segmentedFiles; // logger ID => filename
+    for (const auto& loggerId : loggerIds) {
+        el::Logger* logger = el::Loggers::getLogger(loggerId, false);
+        if (logger == nullptr) {
+            continue;
+        }
+        std::unordered_set<std::string> filenames;
+        {
+            std::lock_guard<std::recursive_mutex> l(logger->lock());
+            el::base::type::EnumType lIndex = el::LevelHelper::kMinValid;
+            el::LevelHelper::forEachLevel(&lIndex, [&](void) -> bool {
+                filenames.insert(logger->typedConfigurations()->filename(el::LevelHelper::castFromInt(lIndex)));
+                return false;
+            });
+        }
+        for (const auto& filename : filenames) {
+            long fsize = Utils::fileSize(filename.c_str());
+            bool due;
+            {
+                std::lock_guard<std::mutex> lock_(m_filesMutex);
+                FileSegments& fileSegments = this->fileSegments(filename);
+                due = fsize > 0 && ((segmentSize > 0 && static_cast<std::size_t>(fsize) >= segmentSize)
+                                    || (segmentInterval > 0 && now - fileSegments.openedAt >= segmentInterval));
+            }
+            if (due) {
+                closeSegment(loggerId, filename);
+            }
+            segmentedFiles.push_back(std::make_pair(loggerId, filename));
+        }
+    }
+
+    std::vector<PendingSegment> pending;
+    {
+        std::lock_guard<std::mutex> lock_(m_filesMutex);
+        for (const auto& pair : segmentedFiles) {
+            Utils::ArchiveFormat format = Utils::compressedArchiveFormat(conf->getArchivedLogCompressedFilename(pair.first));
+            for (const auto& segment : m_files[pair.second].segments) {
+                if (segment->compressedFilename.empty() || segment->format != format) {
+                    pending.push_back(std::make_tuple(pair.first, segment, format));
+                }
+            }
+        }
+    }
+    if (pending.empty()) {
+        return;
+    }
+
+    // compressed on compressor thread (with lower priority) so we do not hold scheduler's worker
+    {
+        std::lock_guard<std::mutex> lock_(m_pendingMutex);
+        m_pending.insert(m_pending.end(), pending.begin(), pending.end());
+    }
+    m_pendingCv.notify_one();
+}
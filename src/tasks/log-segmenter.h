@@ -0,0 +1,141 @@
+//
+//  log-segmenter.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef LogSegmenter_h
+#define LogSegmenter_h
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "tasks/task.h"
+
+namespace residue {
+
+class Registry;
+
+///
+/// \brief Closes segments of live log files (every archive_segment_size bytes or archive_segment_interval
+/// seconds) and compresses them in background so rotation only has to bundle already compressed data.
+/// Segments are compressed on segmenter's own thread so task does not hold scheduler's worker
+///
+class LogSegmenter final : public Task
+{
+public:
+    static const unsigned int CHECK_INTERVAL = 60;
+
+    ///
+    /// \brief Closed part of log file, it is removed once compressed
+    ///
+    struct Segment
+    {
+        unsigned int sequence;
+        std::string filename;
+        // empty until compressed
+        std::string compressedFilename;
+        Utils::ArchiveFormat format;
+        // uncompressed size
+        std::size_t size;
+        // when segment was opened and closed, i.e, time range of its logs (0 if unknown)
+        types::Time from;
+        types::Time to;
+    };
+
+    explicit LogSegmenter(Registry* registry);
+    ~LogSegmenter();
+
+    ///
+    /// \brief Whether log file has closed segments that are not yet taken by rotation
+    ///
+    bool hasSegments(const std::string& filename);
+
+    ///
+    /// \brief Takes all the segments of log file (in order) so next segments belong to next rotation.
+    /// This is called under logger's lock
+    ///
+    std::vector<std::shared_ptr<Segment>> takeSegments(const std::string& filename);
+
+    ///
+    /// \brief Puts segments taken by rotation back (in front of the segments closed since) when
+    /// they could not be archived, so they are still searched and archived by next rotation
+    ///
+    void restoreSegments(const std::string& filename, std::vector<std::shared_ptr<Segment>>&& segments);
+
+    ///
+    /// \brief Copy of closed segments of log file that are not yet taken by rotation (e.g, for search)
+    ///
+    std::vector<Segment> segments(const std::string& filename);
+
+    ///
+    /// \brief Compresses segments that background task has not compressed yet (or that are compressed
+    /// in a different format, e.g, archive extension changed by configuration reload)
+    /// \return False if any of the segments could not be compressed
+    ///
+    bool compressTaken(const std::string& loggerId, const std::string& filename,
+                       const std::vector<std::shared_ptr<Segment>>& segments,
+                       Utils::ArchiveFormat format,
+                       std::vector<Utils::CompressedSegment>* compressedSegments);
+
+    ///
+    /// \brief e.g, /var/log/app.log => /var/log/app.log.segment-3
+    ///
+    static std::string segmentFilename(const std::string& filename, unsigned int sequence);
+
+protected:
+    virtual void execute() override;
+
+private:
+    struct FileSegments
+    {
+        types::Time openedAt;
+        // when previous segment was closed, 0 if it is unknown since when file has logs
+        types::Time dataSince;
+        unsigned int nextSequence;
+        std::vector<std::shared_ptr<Segment>> segments;
+    };
+
+    using PendingSegment = std::tuple<std::string, std::shared_ptr<Segment>, Utils::ArchiveFormat>;
+
+    std::unordered_map<std::string, FileSegments> m_files;
+    std::mutex m_filesMutex;
+    // one segment is compressed at a time, either by compressor or by rotation
+    std::mutex m_compressMutex;
+
+    // segments (with logger ID and format) waiting for compressor
+    std::vector<PendingSegment> m_pending;
+    std::mutex m_pendingMutex;
+    std::condition_variable m_pendingCv;
+    bool m_stopped;
+    std::thread m_compressor;
+
+    ///
+    /// \brief Segments of the file. Segments left by previous run are picked up on first access.
+    /// Caller must hold m_filesMutex
+    ///
+    FileSegments& fileSegments(const std::string& filename);
+
+    void closeSegment(const std::string& loggerId, const std::string& filename);
+    bool compress(const std::string& loggerId, Segment* segment, Utils::ArchiveFormat format);
+};
+}
+#endif /* LogSegmenter_h */
@@ -0,0 +1,230 @@
+//
+//  task-scheduler.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "tasks/task-scheduler.h"
+
+#include <chrono>
+#include <limits>
+#include <string>
+
+#include "logging/log.h"
+#include "tasks/task.h"
+#include "utils/utils.h"
+
+using namespace residue;
+
+const unsigned int TaskScheduler::WORKER_PER_TASK = std::numeric_limits<unsigned int>::max();
+
+TaskScheduler::TaskScheduler(unsigned int workers, const Clock& clock) :
+    m_clock(clock ? clock : Clock(&Utils::now)),
+    m_workerCount(workers),
+    m_nextGeneration(1),
+    m_running(false)
+{
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    stop();
+}
+
+void TaskScheduler::schedule(Task* task)
+{
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        std::uint64_t generation = m_nextGeneration++;
+        m_generations[task] = generation;
+        task->rescheduleFrom(m_clock());
+        pushLocked(task, generation);
+        RVLOG(RV_DEBUG) << "Scheduled [" << task->name() << "] to run every " << task->intervalCount()
+                        << "s; next execution at [" << task->formattedNextExecution() << "]";
+        m_cv.notify_all();
+    }
+    addWorkers();
+}
+
+void TaskScheduler::cancel(Task* task)
+{
+    std::lock_guard<std::mutex> lock_(m_mutex);
+    if (m_generations.erase(task) > 0) {
+        RVLOG(RV_DEBUG) << "Cancelled task [" << task->name() << "]";
+    }
+    m_cv.notify_all();
+}
+
+void TaskScheduler::pushLocked(Task* task, std::uint64_t generation)
+{
+    m_entries.push({ task->nextExecution(), task, generation });
+}
+
+types::Time TaskScheduler::nextDue()
+{
+    std::lock_guard<std::mutex> lock_(m_mutex);
+    while (!m_entries.empty()) {
+        const Entry& top = m_entries.top();
+        auto iter = m_generations.find(top.task);
+        if (iter != m_generations.end() && iter->second == top.generation) {
+            return top.due;
+        }
+        m_entries.pop();
+    }
+    return 0;
+}
+
+std::size_t TaskScheduler::tick()
+{
+    std::vector<Entry> due;
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        const types::Time now = m_clock();
+        while (!m_entries.empty() && m_entries.top().due <= now) {
+            Entry entry = m_entries.top();
+            m_entries.pop();
+            auto iter = m_generations.find(entry.task);
+            if (iter == m_generations.end() || iter->second != entry.generation) {
+                // cancelled or rescheduled
+                continue;
+            }
+            due.push_back(entry);
+        }
+    }
+    for (const auto& entry : due) {
+        post([this, entry]() {
+            run(entry);
+        });
+    }
+    return due.size();
+}
+
+void TaskScheduler::post(const std::function<void(void)>& job)
+{
+    if (m_workerCount == 0) {
+        job();
+        return;
+    }
+    std::lock_guard<std::mutex> lock_(m_jobsMutex);
+    m_jobs.push_back(job);
+    m_jobsCv.notify_one();
+}
+
+void TaskScheduler::run(const Entry& entry)
+{
+    Task* task = entry.task;
+    if (!task->kickOff(true)) {
+        RLOG(WARNING) << "Task [" << task->name() << "] already running, started ["
+                      << task->formattedLastExecution() << "]. Skipping!";
+    }
+    std::lock_guard<std::mutex> lock_(m_mutex);
+    auto iter = m_generations.find(task);
+    if (iter == m_generations.end() || iter->second != entry.generation) {
+        // cancelled or rescheduled while it was running
+        return;
+    }
+    task->rescheduleFrom(m_clock());
+    pushLocked(task, entry.generation);
+    RVLOG(RV_DEBUG) << "Rescheduled task [" << task->name() << "] at [" << task->formattedNextExecution() << "]";
+    m_cv.notify_all();
+}
+
+void TaskScheduler::work()
+{
+    while (true) {
+        std::function<void(void)> job;
+        {
+            std::unique_lock<std::mutex> lock(m_jobsMutex);
+            m_jobsCv.wait(lock, [&]() {
+                return !m_running || !m_jobs.empty();
+            });
+            if (!m_running) {
+                return;
+            }
+            job = m_jobs.front();
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void TaskScheduler::addWorkers()
+{
+    std::size_t count;
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        count = m_workerCount == WORKER_PER_TASK ? m_generations.size() : m_workerCount;
+    }
+    std::lock_guard<std::mutex> lock_(m_workersMutex);
+    while (m_running && m_workers.size() < count) {
+        const std::size_t i = m_workers.size();
+        RVLOG(RV_DEBUG) << "Starting task worker #" << i;
+        m_workers.push_back(std::thread([this, i]() {
+            el::Helpers::setThreadName("TaskWorker#" + std::to_string(i));
+            work();
+        }));
+    }
+}
+
+void TaskScheduler::start()
+{
+    m_running = true;
+    addWorkers();
+
+    while (m_running) {
+        tick();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            break;
+        }
+        if (m_entries.empty()) {
+            m_cv.wait(lock);
+        } else {
+            const types::Time now = m_clock();
+            const types::Time due = m_entries.top().due;
+            if (due > now) {
+                m_cv.wait_for(lock, std::chrono::seconds(due - now));
+            }
+        }
+    }
+}
+
+void TaskScheduler::stop()
+{
+    m_running = false;
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        m_cv.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock_(m_jobsMutex);
+        m_jobsCv.notify_all();
+    }
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock_(m_workersMutex);
+        workers.swap(m_workers);
+    }
+    for (auto& t : workers) {
+        if (t.joinable()) {
+            if (t.get_id() != std::this_thread::get_id()) {
+                t.join();
+            } else {
+                t.detach();
+            }
+        }
+    }
+}
@@ -0,0 +1,152 @@
+//
+//  task-scheduler.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef TaskScheduler_h
+#define TaskScheduler_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core/types.h"
+#include "non-copyable.h"
+
+namespace residue {
+
+class Task;
+
+///
+/// \brief Runs all the tasks from single timer thread. Tasks that are due are
+/// dispatched to bounded pool of workers and rescheduled once they finish.
+///
+/// By default there is a worker for each scheduled task, as a task never runs
+/// alongside itself no task waits behind another long running one (e.g, client
+/// integrity task behind rotators archiving large files at midnight)
+///
+class TaskScheduler final : NonCopyable
+{
+public:
+    using Clock = std::function<types::Time(void)>;
+
+    ///
+    /// \brief Number of workers follows number of scheduled tasks
+    ///
+    static const unsigned int WORKER_PER_TASK;
+
+    ///
+    /// \param workers Number of worker threads (or WORKER_PER_TASK). If 0, due tasks are executed
+    /// on the thread that calls tick() (useful for testing)
+    /// \param clock Current time in seconds, defaults to Utils::now
+    ///
+    explicit TaskScheduler(unsigned int workers = WORKER_PER_TASK, const Clock& clock = nullptr);
+
+    ~TaskScheduler();
+
+    ///
+    /// \brief Schedules task from current time. If task is already scheduled it is rescheduled.
+    /// Worker is added for new task if scheduler is running with WORKER_PER_TASK
+    ///
+    void schedule(Task* task);
+
+    ///
+    /// \brief Removes task from schedule. If it is running, it is not rescheduled after it finishes
+    ///
+    void cancel(Task* task);
+
+    ///
+    /// \brief Runs job on the workers, this is how tick() dispatches due tasks.
+    /// With zero workers job is run straight away on calling thread
+    ///
+    void post(const std::function<void(void)>& job);
+
+    ///
+    /// \brief Starts workers and runs the timer loop, this blocks until stop() is called
+    ///
+    void start();
+
+    void stop();
+
+    ///
+    /// \brief Dispatches all the tasks that are due at clock()
+    /// \return Number of tasks dispatched
+    ///
+    std::size_t tick();
+
+    ///
+    /// \brief Time at which next task is due, 0 if nothing is scheduled
+    ///
+    types::Time nextDue();
+
+    inline bool isScheduled(Task* task)
+    {
+        std::lock_guard<std::mutex> lock_(m_mutex);
+        return m_generations.find(task) != m_generations.end();
+    }
+
+private:
+    struct Entry
+    {
+        types::Time due;
+        Task* task;
+        std::uint64_t generation;
+
+        inline bool operator>(const Entry& other) const
+        {
+            return due > other.due;
+        }
+    };
+
+    Clock m_clock;
+    unsigned int m_workerCount;
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> m_entries;
+
+    // current generation for each scheduled task, entries with older generation are
+    // outdated (cancelled or rescheduled) and skipped
+    std::unordered_map<Task*, std::uint64_t> m_generations;
+    std::uint64_t m_nextGeneration;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    std::deque<std::function<void(void)>> m_jobs;
+    std::mutex m_jobsMutex;
+    std::condition_variable m_jobsCv;
+    std::vector<std::thread> m_workers;
+    std::mutex m_workersMutex;
+
+    std::atomic<bool> m_running;
+
+    void pushLocked(Task* task, std::uint64_t generation);
+
+    ///
+    /// \brief Starts workers that are missing while scheduler is running
+    ///
+    void addWorkers();
+    void run(const Entry& entry);
+    void work();
+};
+}
+#endif /* TaskScheduler_h */
@@ -19,9 +19,6 @@
 
 #include "tasks/task.h"
 
-#include <chrono>
-#include <thread>
-
 #include "logging/custom-logging.h"
 #include "logging/log.h"
 #include "utils/utils.h"
@@ -33,35 +30,13 @@ Task::Task(const std::string& name,
            unsigned int intervalInSeconds) :
     m_name(name),
     m_registry(registry),
-    m_interval(std::chrono::seconds(intervalInSeconds)),
+    m_interval(intervalInSeconds),
     m_nextExecution(0UL),
     m_lastExecution(0UL),
     m_executing(false)
 {
 }
 
-void Task::start()
-{
-    rescheduleFrom(Utils::now());
-    RVLOG(RV_DEBUG) << "Scheduled [" << m_name << "] to run every " << m_interval
-                   << "; next execution at ["
-                   << formattedNextExecution() << "]";
-
-    while (true) {
-#ifdef RESIDUE_DEV
-        DRVLOG(RV_DEBUG) << "Scheduled [" << m_name << "] waiting... [" << m_nextWait << "]";
-#endif
-        std::this_thread::sleep_for(m_nextWait);
-        if (!kickOff(true)) {
-            RLOG(WARNING) << "Task [" << m_name << "] already running, started ["
-                          << formattedLastExecution() << "]. Skipping!";
-            continue;
-        }
-        rescheduleFrom(Utils::now());
-        RVLOG(RV_DEBUG) << "Rescheduled task [" << m_name << "] at [" << formattedNextExecution() << "]";
-    }
-}
-
 types::Time Task::calculateRoundOff(types::Time) const
 {
     return 0;
@@ -72,19 +47,28 @@ void Task::rescheduleFrom(types::Time now)
     types::Time roundOff = calculateRoundOff(now);
     if (roundOff > 0) {
         m_nextExecution = now + roundOff;
-        m_nextWait = std::chrono::seconds(roundOff);
     } else {
-        m_nextExecution = now + m_interval.count();
-        m_nextWait = m_interval;
+        m_nextExecution = now + intervalCount();
     }
 }
 
+bool Task::beginExecution()
+{
+    bool expected = false;
+    return m_executing.compare_exchange_strong(expected, true);
+}
+
+void Task::endExecution()
+{
+    m_executing = false;
+}
+
 bool Task::kickOff(bool scheduled)
 {
-    if (m_executing) {
+    ExecutionGuard guard(this);
+    if (!guard.acquired()) {
         return false;
     }
-    m_executing = true;
     m_lastExecution = Utils::now();
     if (scheduled) {
         RLOG(INFO) << "Executing task [" << m_name << "]";
@@ -93,6 +77,5 @@ bool Task::kickOff(bool scheduled)
     }
     execute();
     RLOG(INFO) << "Finished task [" << m_name << "]"<< (scheduled ? "" : " (Manual)");
-    m_executing = false;
     return true;
 }
@@ -22,7 +22,6 @@
 
 #include <string>
 #include <atomic>
-#include <chrono>
 #include "non-copyable.h"
 #include "utils/utils.h"
 
@@ -41,8 +40,6 @@ public:
          unsigned int intervalInSeconds);
     virtual ~Task() = default;
 
-    void start();
-
     inline bool isExecuting() const
     {
         return m_executing;
@@ -60,7 +57,15 @@ public:
 
     inline types::Time intervalCount() const
     {
-        return m_interval.count();
+        return m_interval.load(std::memory_order_relaxed);
+    }
+
+    ///
+    /// \brief Changes interval (e.g, on configuration reload) while task may be rescheduled by a worker
+    ///
+    inline void setInterval(unsigned int intervalInSeconds)
+    {
+        m_interval.store(intervalInSeconds, std::memory_order_relaxed);
     }
 
     inline std::string name() const
@@ -89,12 +94,50 @@ public:
 
     bool kickOff(bool scheduled = false);
 
+    ///
+    /// \brief Marks task as executing if it is not already. Any run (scheduled, manual or
+    /// partial e.g, rotating single logger) must acquire this first and call endExecution() after
+    /// \return False if task is already executing
+    ///
+    bool beginExecution();
+
+    void endExecution();
+
+    ///
+    /// \brief Begins execution of the task and ends it when guard goes out of scope
+    /// (including when run throws). Check acquired() before running
+    ///
+    class ExecutionGuard final : NonCopyable
+    {
+    public:
+        explicit ExecutionGuard(Task* task) :
+            m_task(task),
+            m_acquired(task->beginExecution())
+        {
+        }
+
+        ~ExecutionGuard()
+        {
+            if (m_acquired) {
+                m_task->endExecution();
+            }
+        }
+
+        inline bool acquired() const
+        {
+            return m_acquired;
+        }
+    private:
+        Task* m_task;
+        bool m_acquired;
+    };
+
 protected:
     std::string m_name;
     Registry* m_registry;
-    std::chrono::seconds m_interval;
+    // in seconds
+    std::atomic<unsigned int> m_interval;
     types::Time m_nextExecution;
-    std::chrono::seconds m_nextWait;
     types::Time m_lastExecution;
     std::atomic<bool> m_executing;
 
@@ -0,0 +1,170 @@
+//
+//  archive-index.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "utils/archive-index.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "crypto/zlib.h"
+#include "crypto/zstd.h"
+#include "utils/utils.h"
+
+using namespace residue;
+
+static const char* kArchiveIndexHeader = "# residue archive index 1";
+
+std::string ArchiveIndex::indexFilename(const std::string& archiveFilename)
+{
+    return archiveFilename + ".idx";
+}
+
+bool ArchiveIndex::write(const std::string& archiveFilename, const std::vector<ArchiveFrame>& frames)
+{
+    std::ofstream out(indexFilename(archiveFilename), std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        RLOG(ERROR) << "Unable to open file for writing [" << indexFilename(archiveFilename) << "] " << std::strerror(errno);
+        return false;
+    }
+    // one frame per line, name is last as it may contain spaces
+    out << kArchiveIndexHeader << std::endl;
+    for (const auto& frame : frames) {
+        out << frame.offset << " " << frame.size << " " << frame.skip << " " << frame.length << " "
+            << frame.from << " " << frame.to << " " << frame.name << "\n";
+    }
+    out.flush();
+    return out.good();
+}
+
+bool ArchiveIndex::read(const std::string& archiveFilename, std::vector<ArchiveFrame>* frames)
+{
+    std::ifstream in(indexFilename(archiveFilename));
+    if (!in.is_open()) {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(in, line) || line != kArchiveIndexHeader) {
+        return false;
+    }
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream ss(line);
+        ArchiveFrame frame;
+        if (!(ss >> frame.offset >> frame.size >> frame.skip >> frame.length >> frame.from >> frame.to)) {
+            return false;
+        }
+        ss.get(); // separator
+        std::getline(ss, frame.name);
+        frames->push_back(frame);
+    }
+    return true;
+}
+
+bool ArchiveIndex::overlaps(const ArchiveFrame& frame, types::Time from, types::Time to)
+{
+    return (from == 0 || frame.to == 0 || frame.to >= from)
+            && (to == 0 || frame.from == 0 || frame.from <= to);
+}
+
+bool ArchiveIndex::readFrame(std::FILE* in, const ArchiveFrame& frame, bool zstd,
+                             const std::function<bool(const char*, std::size_t)>& output)
+{
+    if (std::fseek(in, static_cast<long>(frame.offset), SEEK_SET) != 0) {
+        return false;
+    }
+    std::size_t position = 0;
+    bool stopped = false;
+    auto window = [&](const char* data, std::size_t len) -> bool {
+        // tar header and padding are not part of logs
+        std::size_t begin = std::max(position, frame.skip);
+        std::size_t end = std::min(position + len, frame.skip + frame.length);
+        if (end > begin && !output(data + (begin - position), end - begin)) {
+            stopped = true;
+        }
+        position += len;
+        return !stopped && position < frame.skip + frame.length;
+    };
+    bool result;
+#ifdef RESIDUE_HAS_ZSTD
+    if (zstd) {
+        result = ZStd::decompress(in, frame.size, window);
+    } else
+#else
+    (void)zstd;
+#endif
+    {
+        result = ZLib::decompressGzip(in, frame.size, window);
+    }
+    return result || stopped;
+}
+
+int ArchiveIndex::extract(const std::string& archiveFilename, types::Time from, types::Time to,
+                          std::ostream& out, std::size_t maxBytes, std::string* errorText)
+{
+    std::vector<ArchiveFrame> frames;
+    if (!read(archiveFilename, &frames)) {
+        *errorText = "No index found for [" + archiveFilename + "]";
+        return -1;
+    }
+    const Utils::ArchiveFormat format = Utils::compressedArchiveFormat(archiveFilename);
+#ifndef RESIDUE_HAS_ZSTD
+    if (format == Utils::ArchiveFormat::TarZstd) {
+        *errorText = "Residue was built without zstd support";
+        return -1;
+    }
+#endif
+    std::FILE* in = std::fopen(archiveFilename.c_str(), "rb");
+    if (in == nullptr) {
+        *errorText = "Cannot open [" + archiveFilename + "] " + std::strerror(errno);
+        return -1;
+    }
+    int extracted = 0;
+    std::size_t written = 0;
+    for (const auto& frame : frames) {
+        if (!overlaps(frame, from, to)) {
+            continue;
+        }
+        if (maxBytes > 0 && written >= maxBytes) {
+            break;
+        }
+        auto output = [&](const char* data, std::size_t len) -> bool {
+            if (maxBytes > 0) {
+                len = std::min(len, maxBytes - written);
+            }
+            out.write(data, len);
+            written += len;
+            return maxBytes == 0 || written < maxBytes;
+        };
+        if (!readFrame(in, frame, format == Utils::ArchiveFormat::TarZstd, output)) {
+            *errorText = "Failed to decompress frame at [" + std::to_string(frame.offset) + "] of [" + frame.name + "]";
+            extracted = -1;
+            break;
+        }
+        ++extracted;
+    }
+    std::fclose(in);
+    return extracted;
+}
@@ -0,0 +1,87 @@
+//
+//  archive-index.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef ArchiveIndex_h
+#define ArchiveIndex_h
+
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "core/types.h"
+#include "static-base.h"
+
+namespace residue {
+
+///
+/// \brief Part of compressed archive that can be decompressed on its own (gzip member / zstd frame)
+///
+struct ArchiveFrame
+{
+    // file in archive
+    std::string name;
+    // compressed bytes in archive file
+    std::size_t offset;
+    std::size_t size;
+    // log data once decompressed, i.e, without tar header and padding
+    std::size_t skip;
+    std::size_t length;
+    // time range of logs in frame, 0 if unknown
+    types::Time from;
+    types::Time to;
+    // file the frame was archived from (rotated file or compressed segment), not part of index
+    std::string source;
+};
+
+///
+/// \brief Sidecar index (<archive>.idx) of frames in archive so logs for time range
+/// can be extracted without decompressing whole archive
+///
+class ArchiveIndex final : StaticBase
+{
+public:
+    static std::string indexFilename(const std::string& archiveFilename);
+
+    static bool write(const std::string& archiveFilename, const std::vector<ArchiveFrame>& frames);
+    static bool read(const std::string& archiveFilename, std::vector<ArchiveFrame>* frames);
+
+    ///
+    /// \brief Whether frame may contain logs between from and to (inclusive)
+    ///
+    static bool overlaps(const ArchiveFrame& frame, types::Time from, types::Time to);
+
+    ///
+    /// \brief Decompresses single frame from opened archive (or compressed segment) and passes
+    /// its log data to output in chunks, output returns false to stop
+    ///
+    static bool readFrame(std::FILE* in, const ArchiveFrame& frame, bool zstd,
+                          const std::function<bool(const char*, std::size_t)>& output);
+
+    ///
+    /// \brief Decompresses only the frames that overlap time range and writes their log data to out
+    /// \param maxBytes Stops after writing this many bytes, 0 for no limit
+    /// \param errorText Reason on failure
+    /// \return Number of frames extracted, -1 on failure
+    ///
+    static int extract(const std::string& archiveFilename, types::Time from, types::Time to,
+                       std::ostream& out, std::size_t maxBytes, std::string* errorText);
+};
+}
+#endif /* ArchiveIndex_h */
@@ -0,0 +1,223 @@
+//
+//  bloom-filter.cc
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "utils/bloom-filter.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "logging/log.h"
+
+using namespace residue;
+
+const std::size_t BloomFilter::MIN_SIZE = 1024; // 1KB
+const std::size_t BloomFilter::MAX_SIZE = 64 * 1024 * 1024; // 64MB
+const unsigned int BloomFilter::MAX_HASHES = 16;
+
+static const char* kBloomFilterHeader = "# residue bloom filter 1";
+
+BloomFilter::BloomFilter(std::size_t size, float falsePositiveRate) :
+    m_bits(std::min(std::max(size, MIN_SIZE), MAX_SIZE), 0),
+    m_count(0)
+{
+    // optimal number of hashes is (m / n) ln 2, where n is number of tokens size was meant for at
+    // the rate. That is -log2(rate) unless size was clamped, then it is scaled by actual / requested size
+    const double scale = static_cast<double>(m_bits.size()) / static_cast<double>(std::max(size, static_cast<std::size_t>(1)));
+    const double hashes = std::round(-std::log2(static_cast<double>(falsePositiveRate)) * scale);
+    m_hashes = static_cast<unsigned int>(std::min(std::max(hashes, 1.0), static_cast<double>(MAX_HASHES)));
+}
+
+BloomFilter::BloomFilter() :
+    m_hashes(0),
+    m_count(0)
+{
+}
+
+std::string BloomFilter::filterFilename(const std::string& filename)
+{
+    return filename + ".bloom";
+}
+
+std::shared_ptr<BloomFilter> BloomFilter::build(const std::string& filename, std::size_t size, float falsePositiveRate)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+        return nullptr;
+    }
+    std::shared_ptr<BloomFilter> filter = std::make_shared<BloomFilter>(size, falsePositiveRate);
+    auto addToken = [&](const char* token, std::size_t len) {
+        filter->add(hash(token, len));
+    };
+    std::vector<char> block(64 * 1024);
+    std::string pending;
+    while (in.read(block.data(), static_cast<std::streamsize>(block.size())) || in.gcount() > 0) {
+        pending.append(block.data(), static_cast<std::size_t>(in.gcount()));
+        // token at the end may continue in next block
+        std::size_t end = pending.size();
+        while (end > 0 && !isSeparator(pending[end - 1])) {
+            --end;
+        }
+        if (end == 0 && pending.size() < block.size()) {
+            continue;
+        }
+        end = end == 0 ? pending.size() : end;
+        tokenize(pending.data(), end, addToken);
+        pending.erase(0, end);
+    }
+    if (in.bad()) {
+        return nullptr;
+    }
+    tokenize(pending.data(), pending.size(), addToken);
+    return filter;
+}
+
+void BloomFilter::tokenize(const char* data, std::size_t len,
+                           const std::function<void(const char*, std::size_t)>& callback)
+{
+    std::size_t start = 0;
+    while (start < len) {
+        while (start < len && isSeparator(data[start])) {
+            ++start;
+        }
+        std::size_t end = start;
+        while (end < len && !isSeparator(data[end])) {
+            ++end;
+        }
+        if (end > start) {
+            callback(data + start, end - start);
+        }
+        start = end;
+    }
+}
+
+std::uint64_t BloomFilter::hash(const char* token, std::size_t len)
+{
+    // FNV-1a, mixed (murmur3 finalizer) so both halves can be used as hashes
+    std::uint64_t h = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(token[i]);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void BloomFilter::hashTokens(const std::string& text, std::vector<std::uint64_t>* hashes)
+{
+    tokenize(text.data(), text.size(), [&](const char* token, std::size_t len) {
+        hashes->push_back(hash(token, len));
+    });
+}
+
+void BloomFilter::add(std::uint64_t hash)
+{
+    if (m_bits.empty()) {
+        return;
+    }
+    // k hashes from two (Kirsch-Mitzenmacher)
+    const std::uint64_t bits = m_bits.size() * 8;
+    const std::uint64_t h1 = hash & 0xffffffffULL;
+    const std::uint64_t h2 = (hash >> 32) | 1;
+    for (unsigned int i = 0; i < m_hashes; ++i) {
+        const std::uint64_t bit = (h1 + i * h2) % bits;
+        m_bits[bit >> 3] |= static_cast<unsigned char>(1 << (bit & 7));
+    }
+    ++m_count;
+}
+
+bool BloomFilter::mayContain(std::uint64_t hash) const
+{
+    if (m_bits.empty()) {
+        return true;
+    }
+    const std::uint64_t bits = m_bits.size() * 8;
+    const std::uint64_t h1 = hash & 0xffffffffULL;
+    const std::uint64_t h2 = (hash >> 32) | 1;
+    for (unsigned int i = 0; i < m_hashes; ++i) {
+        const std::uint64_t bit = (h1 + i * h2) % bits;
+        if ((m_bits[bit >> 3] & (1 << (bit & 7))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BloomFilter::mayContainAll(const std::vector<std::uint64_t>& hashes) const
+{
+    return std::all_of(hashes.begin(), hashes.end(), [&](std::uint64_t h) { return mayContain(h); });
+}
+
+bool BloomFilter::write(const std::string& filename,
+                        const std::vector<std::pair<std::size_t, const BloomFilter*>>& filters)
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        RLOG(ERROR) << "Unable to open file for writing [" << filename << "] " << std::strerror(errno);
+        return false;
+    }
+    // each filter is a line (key, size, hashes, count) followed by its bits
+    out << kBloomFilterHeader << "\n";
+    for (const auto& pair : filters) {
+        const BloomFilter* filter = pair.second;
+        out << pair.first << " " << filter->m_bits.size() << " " << filter->m_hashes << " " << filter->m_count << "\n";
+        out.write(reinterpret_cast<const char*>(filter->m_bits.data()), static_cast<std::streamsize>(filter->m_bits.size()));
+    }
+    out.flush();
+    return out.good();
+}
+
+bool BloomFilter::read(const std::string& filename, std::size_t key, BloomFilter* filter)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(in, line) || line != kBloomFilterHeader) {
+        return false;
+    }
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::size_t entryKey;
+        std::size_t size;
+        unsigned int hashes;
+        std::size_t count;
+        if (!(ss >> entryKey >> size >> hashes >> count) || size > MAX_SIZE || hashes > MAX_HASHES) {
+            return false;
+        }
+        if (entryKey != key) {
+            in.seekg(static_cast<std::streamoff>(size), std::ios::cur);
+            continue;
+        }
+        filter->m_bits.resize(size);
+        filter->m_hashes = hashes;
+        filter->m_count = count;
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(filter->m_bits.data()), static_cast<std::streamsize>(size)));
+    }
+    return false;
+}
@@ -0,0 +1,126 @@
+//
+//  bloom-filter.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef BloomFilter_h
+#define BloomFilter_h
+
+#include <cctype>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace residue {
+
+///
+/// \brief Bloom filter of tokens (words split on whitespace and punctuation) in a log file,
+/// used by search to skip files that cannot contain the text. Filters are stored in sidecar
+/// files (<file>.bloom) keyed by offset of the frame they belong to (0 for a single file)
+///
+class BloomFilter final
+{
+public:
+    static const std::size_t MIN_SIZE;
+    static const std::size_t MAX_SIZE;
+    static const unsigned int MAX_HASHES;
+
+    ///
+    /// \param size Size of filter in bytes
+    /// \param falsePositiveRate Rate filter is tuned for, i.e, number of hashes per token (scaled
+    /// if size is clamped to MIN_SIZE or MAX_SIZE)
+    ///
+    BloomFilter(std::size_t size, float falsePositiveRate);
+    BloomFilter();
+
+    static std::string filterFilename(const std::string& filename);
+
+    ///
+    /// \brief Builds filter of all the tokens in existing file, e.g, file that had lines before
+    /// server started so its filter was not kept while it was written
+    /// \return nullptr if file could not be read
+    ///
+    static std::shared_ptr<BloomFilter> build(const std::string& filename, std::size_t size, float falsePositiveRate);
+
+    static inline bool isSeparator(char c)
+    {
+        return std::isspace(static_cast<unsigned char>(c)) || std::ispunct(static_cast<unsigned char>(c));
+    }
+
+    ///
+    /// \brief Passes each token in data to callback with its position
+    ///
+    static void tokenize(const char* data, std::size_t len,
+                         const std::function<void(const char*, std::size_t)>& callback);
+
+    static std::uint64_t hash(const char* token, std::size_t len);
+
+    ///
+    /// \brief Hashes of all the tokens in text
+    ///
+    static void hashTokens(const std::string& text, std::vector<std::uint64_t>* hashes);
+
+    void add(std::uint64_t hash);
+
+    inline void add(const std::vector<std::uint64_t>& hashes)
+    {
+        for (std::uint64_t h : hashes) {
+            add(h);
+        }
+    }
+
+    bool mayContain(std::uint64_t hash) const;
+
+    bool mayContainAll(const std::vector<std::uint64_t>& hashes) const;
+
+    inline std::size_t size() const
+    {
+        return m_bits.size();
+    }
+
+    inline unsigned int hashes() const
+    {
+        return m_hashes;
+    }
+
+    // tokens added (including duplicates)
+    inline std::size_t count() const
+    {
+        return m_count;
+    }
+
+    ///
+    /// \brief Writes filters with their keys to sidecar file (replaced if exists)
+    ///
+    static bool write(const std::string& filename,
+                      const std::vector<std::pair<std::size_t, const BloomFilter*>>& filters);
+
+    ///
+    /// \brief Reads filter for key from sidecar file
+    /// \return False if file or key does not exist or file is invalid
+    ///
+    static bool read(const std::string& filename, std::size_t key, BloomFilter* filter);
+
+private:
+    std::vector<unsigned char> m_bits;
+    unsigned int m_hashes;
+    std::size_t m_count;
+};
+}
+#endif /* BloomFilter_h */
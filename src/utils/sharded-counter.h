@@ -0,0 +1,84 @@
+//
+//  sharded-counter.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef ShardedCounter_h
+#define ShardedCounter_h
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "non-copyable.h"
+
+namespace residue {
+
+///
+/// \brief Monotonic 64-bit counter updated from many threads
+///
+/// Each thread adds to its own cache-line sized shard with relaxed ordering so
+/// concurrent writers do not contend. Shards are only summed when value is read
+///
+class ShardedCounter final : NonCopyable
+{
+public:
+    static const std::size_t SHARDS = 16;
+
+    ShardedCounter()
+    {
+        reset();
+    }
+
+    inline void add(std::uint64_t v)
+    {
+        m_shards[shardIndex()].value.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    inline std::uint64_t value() const
+    {
+        std::uint64_t total = 0;
+        for (const auto& shard : m_shards) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    inline void reset()
+    {
+        for (auto& shard : m_shards) {
+            shard.value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<std::uint64_t> value;
+    };
+
+    Shard m_shards[SHARDS];
+
+    static inline std::size_t shardIndex()
+    {
+        static thread_local const std::size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % SHARDS;
+        return index;
+    }
+};
+}
+#endif /* ShardedCounter_h */
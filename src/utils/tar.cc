@@ -19,6 +19,8 @@
 
 #include "utils/tar.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <cerrno>
@@ -26,10 +28,78 @@
 #include <cstring>
 #include <ctime>
 
+#include <algorithm>
+
 #include "logging/log.h"
+#include "utils/utils.h"
 
 using namespace residue;
 
+// only headers and padding are buffered
+const std::size_t TarFileBuffer::BUFFER_SIZE = 64 * 1024;
+
+TarFileBuffer::TarFileBuffer(const std::string& filename) :
+    m_fd(-1),
+    m_failed(false),
+    m_buffer(BUFFER_SIZE)
+{
+    m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+        RLOG(ERROR) << "Unable to open file for writing [" << filename << "] " << std::strerror(errno);
+        return;
+    }
+    setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+}
+
+TarFileBuffer::~TarFileBuffer()
+{
+    close();
+}
+
+TarFileBuffer::int_type TarFileBuffer::overflow(int_type ch)
+{
+    if (sync() != 0) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int TarFileBuffer::sync()
+{
+    if (m_fd < 0 || m_failed) {
+        return -1;
+    }
+    const char* p = pbase();
+    while (p < pptr()) {
+        ssize_t nWritten = ::write(m_fd, p, static_cast<std::size_t>(pptr() - p));
+        if (nWritten < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nWritten <= 0) {
+            m_failed = true;
+            return -1;
+        }
+        p += nWritten;
+    }
+    setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    return 0;
+}
+
+bool TarFileBuffer::close()
+{
+    if (m_fd < 0) {
+        return false;
+    }
+    bool result = sync() == 0;
+    result = ::close(m_fd) == 0 && result;
+    m_fd = -1;
+    return result;
+}
+
 Tar::Tar(std::ostream& out) :
     m_finished(false),
     m_out(out)
@@ -130,17 +200,64 @@ void Tar::put(const char* filename, const char* content, std::size_t len)
     addDelimiter(len);
 }
 
+void Tar::putHeader(const char* nameInArchive, std::size_t size)
+{
+    Header header;
+    initialize(&header);
+    setFilenameInArchive(&header, nameInArchive);
+    header.typeflag[0] = 0;
+    setSizeInArchive(&header, size);
+    setChecksum(&header);
+    m_out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+}
+
+void Tar::putPadding(std::size_t size)
+{
+    addDelimiter(size);
+}
+
+bool Tar::copyFileData(int inFd, std::size_t len)
+{
+    TarFileBuffer* fileBuffer = dynamic_cast<TarFileBuffer*>(m_out.rdbuf());
+    if (fileBuffer != nullptr) {
+        // header must be on disk before contents
+        m_out.flush();
+        return m_out.good() && Utils::copyFileData(fileBuffer->fd(), inFd, len);
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(inFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    // compressed streams buffer blocks themselves, large reads only save syscalls
+    std::vector<char> buff(Utils::COPY_BUFFER_SIZE);
+    std::size_t remaining = len;
+    while (remaining > 0) {
+        ssize_t nRead = ::read(inFd, buff.data(), std::min(buff.size(), remaining));
+        if (nRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nRead <= 0) {
+            return false;
+        }
+        m_out.write(buff.data(), nRead);
+        remaining -= static_cast<std::size_t>(nRead);
+    }
+    return m_out.good();
+}
+
 bool Tar::putFile(const char* filename, const char* nameInArchive)
 {
-    char buff[BUFSIZ];
-    std::FILE* in = std::fopen(filename,"rb");
-    if (in == nullptr) {
+    int in = ::open(filename, O_RDONLY);
+    if (in < 0) {
         RLOG(ERROR) << "Cannot open " << filename << " " << std::strerror(errno);
         return false;
     }
-    std::fseek(in, 0L, SEEK_END);
-    long int len = std::ftell(in);
-    std::fseek(in, 0L, SEEK_SET);
+    struct stat st;
+    if (::fstat(in, &st) != 0) {
+        RLOG(ERROR) << "Cannot read " << filename << " " << std::strerror(errno);
+        ::close(in);
+        return false;
+    }
+    const std::size_t len = static_cast<std::size_t>(st.st_size);
 
     Header header;
     initialize(&header);
@@ -149,11 +266,13 @@ bool Tar::putFile(const char* filename, const char* nameInArchive)
     setSizeInArchive(&header, len);
     setChecksum(&header);
     m_out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
-    std::size_t nRead = 0;
-    while((nRead = std::fread(buff, sizeof(char), BUFSIZ, in)) > 0) {
-        m_out.write(buff, nRead);
+    bool result = copyFileData(in, len);
+    ::close(in);
+    if (!result) {
+        // size is already in header, archive is not usable
+        RLOG(ERROR) << "Failed to copy " << filename << " in to archive " << std::strerror(errno);
+        return false;
     }
-    std::fclose(in);
     addDelimiter(len);
     return true;
 }
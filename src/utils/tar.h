@@ -21,11 +21,52 @@
 #define Tar_h
 
 #include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
 
 #include "non-copyable.h"
 
 namespace residue {
 
+///
+/// \brief Output stream buffer for uncompressed tar file. Tar writes headers through it
+/// and copies file contents directly to its descriptor (in kernel where possible)
+///
+class TarFileBuffer final : public std::streambuf, NonCopyable
+{
+public:
+    static const std::size_t BUFFER_SIZE;
+
+    explicit TarFileBuffer(const std::string& filename);
+    virtual ~TarFileBuffer();
+
+    inline bool isOpen() const
+    {
+        return m_fd >= 0;
+    }
+
+    inline int fd() const
+    {
+        return m_fd;
+    }
+
+    ///
+    /// \brief Flushes and closes the file
+    /// \return False if anything failed to write
+    ///
+    bool close();
+
+protected:
+    virtual int_type overflow(int_type ch) override;
+    virtual int sync() override;
+
+private:
+    int m_fd;
+    bool m_failed;
+    std::vector<char> m_buffer;
+};
+
 ///
 /// \brief Utility functions to create TAR archive
 ///
@@ -40,6 +81,13 @@ public:
     void put(const char* filename, const char* content, std::size_t len);
     bool putFile(const char* filename, const char* nameInArchive);
 
+    ///
+    /// \brief Writes header only, for files that are written in parts. Contents are written
+    /// by caller followed by putPadding(size)
+    ///
+    void putHeader(const char* nameInArchive, std::size_t size);
+    void putPadding(std::size_t size);
+
 private:
     struct Header
     {
@@ -70,6 +118,7 @@ private:
     void setSizeInArchive(Header* header, unsigned long fileSize);
     void setFilenameInArchive(Header* header, const char* filename);
     void addDelimiter(std::size_t len);
+    bool copyFileData(int inFd, std::size_t len);
 };
 }
 
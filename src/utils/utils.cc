@@ -20,20 +20,32 @@
 #include "utils/utils.h"
 
 #include <pwd.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#if defined(__linux__)
+#   include <sys/sendfile.h>
+#   include <sys/syscall.h>
+#endif
+#include <fcntl.h>
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 
 #include <algorithm>
+#include <fstream>
+#include <functional>
 #include <iomanip>
 #include <random>
 #include <string>
+#include <vector>
 
 #include "core/configuration.h"
 #include "core/residue-exception.h"
+#include "crypto/zlib.h"
+#include "crypto/zstd.h"
 #include "logging/log.h"
 #include "net/url.h"
 #include "utils/tar.h"
@@ -175,17 +187,18 @@ void Utils::updateFilePermissions(const char* path, const el::Logger* logger, co
     // find owner for file
     const std::string fileUser = conf->findLoggerUser(logger->id());
     if (!fileUser.empty()) {
-        struct passwd* userDetails = getpwnam(fileUser.data());
-        if (userDetails == nullptr) {
+        // re-entrant version as archives for different loggers are processed in parallel
+        struct passwd pwd;
+        struct passwd* userDetails = nullptr;
+        char buf[4096];
+        if (getpwnam_r(fileUser.data(), &pwd, buf, sizeof(buf), &userDetails) != 0 || userDetails == nullptr) {
             RLOG_IF(id != RESIDUE_LOGGER_ID, ERROR) << "User [" << fileUser << "] does not exist. Unable to change ownership for " << path;
-            endpwent();
             return;
         } else {
             RVLOG_IF(id != RESIDUE_LOGGER_ID, RV_INFO) << "Changing ownership for [" << path << "] to [" << fileUser << "]";
         }
         uid_t userId = userDetails->pw_uid;
         gid_t groupId = userDetails->pw_gid;
-        endpwent();
         if (chown(path, userId, groupId) == -1) {
             RLOG_IF(id != RESIDUE_LOGGER_ID, ERROR) << "Failed to change ownership for " << path << ". Error: " << std::strerror(errno);
         }
@@ -195,6 +208,93 @@ void Utils::updateFilePermissions(const char* path, const el::Logger* logger, co
     }
 }
 
+const std::size_t Utils::COPY_BUFFER_SIZE = 1024 * 1024;
+
+bool Utils::copyFileData(int outFd, int inFd, std::size_t len)
+{
+    std::size_t remaining = len;
+#if defined(__linux__)
+#   if defined(SYS_copy_file_range)
+    // no copy at all on filesystems that support reflinks, fails for
+    // different filesystems on older kernels (sendfile is tried then)
+    while (remaining > 0) {
+        ssize_t copied = syscall(SYS_copy_file_range, inFd, nullptr, outFd, nullptr, remaining, 0U);
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copied <= 0) {
+            break;
+        }
+        remaining -= static_cast<std::size_t>(copied);
+    }
+#   endif
+    while (remaining > 0) {
+        ssize_t copied = ::sendfile(outFd, inFd, nullptr, remaining);
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copied <= 0) {
+            break;
+        }
+        remaining -= static_cast<std::size_t>(copied);
+    }
+#endif
+    if (remaining == 0) {
+        return true;
+    }
+    std::vector<char> buff(COPY_BUFFER_SIZE);
+    while (remaining > 0) {
+        ssize_t nRead = ::read(inFd, buff.data(), std::min(buff.size(), remaining));
+        if (nRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nRead <= 0) {
+            return false;
+        }
+        const char* p = buff.data();
+        std::size_t toWrite = static_cast<std::size_t>(nRead);
+        while (toWrite > 0) {
+            ssize_t nWritten = ::write(outFd, p, toWrite);
+            if (nWritten < 0 && errno == EINTR) {
+                continue;
+            }
+            if (nWritten <= 0) {
+                return false;
+            }
+            p += nWritten;
+            toWrite -= static_cast<std::size_t>(nWritten);
+        }
+        remaining -= static_cast<std::size_t>(nRead);
+    }
+    return true;
+}
+
+void Utils::lowerCurrentThreadPriority(int niceness)
+{
+    if (niceness <= 0) {
+        return;
+    }
+#if defined(__linux__)
+    // on linux nice value is per thread (PRIO_PROCESS with thread ID)
+    const pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), niceness) != 0) {
+        RVLOG(RV_WARNING) << "Failed to set thread priority: " << std::strerror(errno);
+    }
+#   if defined(SYS_ioprio_set)
+    // best-effort I/O class with level scaled from niceness (0-19 => 0-7)
+    const int ioprioClassBestEffort = 2;
+    const int ioprioClassShift = 13;
+    const int ioprioWhoProcess = 1;
+    const int level = std::min(7, niceness * 8 / 20);
+    if (syscall(SYS_ioprio_set, ioprioWhoProcess, tid, (ioprioClassBestEffort << ioprioClassShift) | level) != 0) {
+        RVLOG(RV_WARNING) << "Failed to set thread I/O priority: " << std::strerror(errno);
+    }
+#   endif
+#else
+    RESIDUE_UNUSED(niceness);
+#endif
+}
+
 std::string Utils::generateRandomFromArray(const char* list,
                                            std::size_t size,
                                            unsigned int length)
@@ -250,24 +350,272 @@ bool Utils::isJSON(const std::string& data)
     return copy[0] == '[' || copy[0] == '{';
 }
 
+Utils::ArchiveFormat Utils::compressedArchiveFormat(const std::string& filename)
+{
+    if (endsWith(filename, ".tar.zst") || endsWith(filename, ".tzst")) {
+        return ArchiveFormat::TarZstd;
+    }
+    return ArchiveFormat::TarGz;
+}
+
+bool Utils::isZstdSupported()
+{
+#ifdef RESIDUE_HAS_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+///
+/// \brief Writes to compressed buffer of given format and closes it, one call creates one gzip member / zstd frame
+///
+template <typename Fn>
+static bool writeCompressed(const std::string& outputFile, Utils::ArchiveFormat format, unsigned int compressThreads,
+                            int zstdLevel, bool zstdLongDistance, bool append, Fn&& write)
+{
+    if (format == Utils::ArchiveFormat::TarZstd) {
+#ifdef RESIDUE_HAS_ZSTD
+        ZstdFileBuffer zbuf(outputFile, zstdLevel, zstdLongDistance, compressThreads, append);
+        if (!zbuf.isOpen()) {
+            return false;
+        }
+        bool result = write(&zbuf);
+        return zbuf.close() && result;
+#else
+        (void) zstdLevel;
+        (void) zstdLongDistance;
+        RLOG(ERROR) << "Unable to create [" << outputFile << "]. Residue was built without zstd support";
+        return false;
+#endif
+    }
+    GzipFileBuffer gzbuf(outputFile, compressThreads, append);
+    if (!gzbuf.isOpen()) {
+        return false;
+    }
+    bool result = write(&gzbuf);
+    return gzbuf.close() && result;
+}
+
+static bool appendFile(const std::string& outputFile, const std::string& inputFile)
+{
+    int in = ::open(inputFile.c_str(), O_RDONLY);
+    if (in < 0) {
+        RLOG(ERROR) << "Cannot open " << inputFile << " " << std::strerror(errno);
+        return false;
+    }
+    // not O_APPEND, in-kernel copy does not support it
+    int out = ::open(outputFile.c_str(), O_WRONLY);
+    if (out < 0) {
+        RLOG(ERROR) << "Cannot open " << outputFile << " " << std::strerror(errno);
+        ::close(in);
+        return false;
+    }
+    struct stat st;
+    bool result = ::fstat(in, &st) == 0 && ::lseek(out, 0, SEEK_END) >= 0
+            && Utils::copyFileData(out, in, static_cast<std::size_t>(st.st_size));
+    if (!result) {
+        RLOG(ERROR) << "Failed to copy " << inputFile << " to " << outputFile << " " << std::strerror(errno);
+    }
+    ::close(in);
+    return ::close(out) == 0 && result;
+}
+
 bool Utils::archiveFiles(const std::string& outputFile,
-                         const std::unordered_map<std::string, std::string>& files)
+                         const std::unordered_map<std::string, std::string>& files,
+                         ArchiveFormat format,
+                         unsigned int compressThreads,
+                         int zstdLevel,
+                         bool zstdLongDistance)
 {
-    std::fstream out(outputFile, std::ios::out);
-    if (!out.is_open()) {
-        RLOG(ERROR) << "Unable to open file [" << outputFile << "] for writing. " << std::strerror(errno);
+    auto putAll = [&](std::ostream& out) -> bool {
+        bool result = true;
+        Tar tar(out);
+        for (auto f : files) {
+            if (!tar.putFile(f.first.c_str(), f.second.c_str())) {
+                result = result && false;
+            }
+        }
+        tar.finish();
+        return result && out.good();
+    };
+    if (format != ArchiveFormat::Tar) {
+        // tar is streamed through compressor so archive is written once
+        return writeCompressed(outputFile, format, compressThreads, zstdLevel, zstdLongDistance, false,
+                               [&](std::streambuf* buf) -> bool {
+            std::ostream out(buf);
+            return putAll(out);
+        });
+    }
+    // file contents are copied in to archive without going through user space
+    TarFileBuffer buffer(outputFile);
+    if (!buffer.isOpen()) {
         return false;
     }
-    bool result = true;
+    std::ostream out(&buffer);
+    bool result = putAll(out);
+    return buffer.close() && result;
+}
+
+bool Utils::archiveFilesWithSegments(const std::string& outputFile,
+                                     const std::unordered_map<std::string, std::string>& files,
+                                     const CompressedSegments& segments,
+                                     ArchiveFormat format,
+                                     unsigned int compressThreads,
+                                     int zstdLevel,
+                                     bool zstdLongDistance,
+                                     std::vector<ArchiveFrame>* frames)
+{
+    if (format == ArchiveFormat::Tar) {
+        RLOG(ERROR) << "Compressed segments can only be archived in compressed archive";
+        return false;
+    }
+    // Every part is written as separate gzip member (or zstd frame) which are valid when concatenated,
+    // so segments are copied as they are. Tar is switched between the buffers of each part
+    std::ostream out(nullptr);
     Tar tar(out);
-    for (auto f : files) {
-        if (!tar.putFile(f.first.c_str(), f.second.c_str())) {
-            result = result && false;
+    bool append = false;
+    std::size_t outputSize = 0;
+    // adds frame for part that was just written (from outputSize to end of file)
+    auto addFrame = [&](const std::string& name, std::size_t skip, std::size_t length,
+                        types::Time from, types::Time to, const std::string& source) {
+        long newSize = fileSize(outputFile.c_str());
+        std::size_t end = newSize < 0 ? outputSize : static_cast<std::size_t>(newSize);
+        if (frames != nullptr && length > 0) {
+            frames->push_back({ name, outputSize, end - outputSize, skip, length, from, to, source });
+        }
+        outputSize = end;
+    };
+    auto writePart = [&](const std::function<bool(void)>& write) -> bool {
+        bool result = writeCompressed(outputFile, format, compressThreads, zstdLevel, zstdLongDistance, append,
+                                      [&](std::streambuf* buf) -> bool {
+            out.rdbuf(buf);
+            bool written = write();
+            out.flush();
+            written = written && out.good();
+            out.rdbuf(nullptr);
+            return written;
+        });
+        append = true;
+        return result;
+    };
+    for (const auto& f : files) {
+        struct stat st;
+        if (::stat(f.first.c_str(), &st) != 0) {
+            RLOG(ERROR) << "Cannot read " << f.first << " " << std::strerror(errno);
+            return false;
+        }
+        // last write to rotated file
+        const types::Time modified = static_cast<types::Time>(st.st_mtime);
+        const std::size_t remaining = static_cast<std::size_t>(st.st_size);
+        auto iter = segments.find(f.first);
+        if (iter == segments.end() || iter->second.empty()) {
+            if (!writePart([&]() { return tar.putFile(f.first.c_str(), f.second.c_str()); })) {
+                return false;
+            }
+            addFrame(f.second, 512, remaining, 0, modified, f.first);
+            continue;
+        }
+        std::size_t total = remaining;
+        for (const auto& segment : iter->second) {
+            total += segment.size;
+        }
+        // file is single entry in archive, i.e, header with full size, segments and
+        // then rest of the file
+        if (!writePart([&]() { tar.putHeader(f.second.c_str(), total); return true; })) {
+            return false;
+        }
+        addFrame(f.second, 0, 0, 0, 0, "");
+        for (const auto& segment : iter->second) {
+            if (!appendFile(outputFile, segment.filename)) {
+                return false;
+            }
+            addFrame(f.second, 0, segment.size, segment.from, segment.to, segment.filename);
+        }
+        if (!writePart([&]() -> bool {
+                       std::ifstream in(f.first, std::ios::binary);
+                       if (!in.is_open()) {
+                           return false;
+                       }
+                       if (in.peek() != std::ifstream::traits_type::eof()) {
+                           out << in.rdbuf();
+                       }
+                       tar.putPadding(total);
+                       return true;
+                   })) {
+            return false;
+        }
+        addFrame(f.second, 0, remaining, iter->second.back().to, modified, f.first);
+    }
+    return writePart([&]() { tar.finish(); return true; });
+}
+
+std::string Utils::compressedExtension(ArchiveFormat format)
+{
+    switch (format) {
+    case ArchiveFormat::TarZstd:
+        return ".zst";
+    case ArchiveFormat::TarGz:
+        return ".gz";
+    default:
+        return "";
+    }
+}
+
+bool Utils::compressFile(const std::string& outputFile, const std::string& inputFile, ArchiveFormat format,
+                         int zstdLevel, bool zstdLongDistance)
+{
+    return writeCompressed(outputFile, format, 1, zstdLevel, zstdLongDistance, false,
+                           [&](std::streambuf* buf) -> bool {
+        std::ifstream in(inputFile, std::ios::binary);
+        if (!in.is_open()) {
+            RLOG(ERROR) << "Cannot open " << inputFile << " " << std::strerror(errno);
+            return false;
+        }
+        std::ostream out(buf);
+        if (in.peek() != std::ifstream::traits_type::eof()) {
+            out << in.rdbuf();
+        }
+        out.flush();
+        return out.good();
+    });
+}
+
+bool Utils::decompressFile(const std::string& outputFile, const std::string& inputFile, ArchiveFormat format)
+{
+    long size = fileSize(inputFile.c_str());
+    std::FILE* in = std::fopen(inputFile.c_str(), "rb");
+    if (in == nullptr || size < 0) {
+        RLOG(ERROR) << "Cannot open " << inputFile << " " << std::strerror(errno);
+        if (in != nullptr) {
+            std::fclose(in);
         }
+        return false;
     }
-    tar.finish();
+    std::ofstream out(outputFile, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        RLOG(ERROR) << "Cannot open " << outputFile << " " << std::strerror(errno);
+        std::fclose(in);
+        return false;
+    }
+    auto write = [&](const char* data, std::size_t len) -> bool {
+        out.write(data, static_cast<std::streamsize>(len));
+        return out.good();
+    };
+    bool result;
+    if (format == ArchiveFormat::TarZstd) {
+#ifdef RESIDUE_HAS_ZSTD
+        result = ZStd::decompress(in, static_cast<std::size_t>(size), write);
+#else
+        RLOG(ERROR) << "Unable to decompress [" << inputFile << "]. Residue was built without zstd support";
+        result = false;
+#endif
+    } else {
+        result = ZLib::decompressGzip(in, static_cast<std::size_t>(size), write);
+    }
+    std::fclose(in);
     out.close();
-    return result;
+    return result && !out.fail();
 }
 
 std::string Utils::bytesToHumanReadable(long size)
@@ -311,3 +659,24 @@ std::tm Utils::timeToTm(types::Time epochInSec)
     el::base::utils::DateTime::buildTimeInfo(&tval, &tmObj);
     return tmObj;
 }
+
+types::Time Utils::parseTime(const std::string& str)
+{
+    if (str.empty()) {
+        return 0;
+    }
+    if (str.find_first_not_of("0123456789") == std::string::npos) {
+        return str.size() > 19 ? 0 : static_cast<types::Time>(std::stoull(str));
+    }
+    for (const char* format : { "%Y-%m-%dT%H:%M:%S", "%Y-%m-%dT%H:%M" }) {
+        std::tm tm;
+        std::memset(&tm, 0, sizeof(tm));
+        const char* end = strptime(str.c_str(), format, &tm);
+        if (end != nullptr && *end == '\0') {
+            tm.tm_isdst = -1;
+            const std::time_t t = std::mktime(&tm);
+            return t > 0 ? static_cast<types::Time>(t) : 0;
+        }
+    }
+    return 0;
+}
@@ -22,10 +22,12 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <chrono>
 #include "logging/log.h"
 #include "static-base.h"
 #include "core/types.h"
+#include "utils/archive-index.h"
 
 namespace residue {
 
@@ -100,8 +102,94 @@ public:
     static void updateFilePermissions(const char* path, const el::Logger* logger, const Configuration* conf);
     static std::string bytesToHumanReadable(long size);
 
+    ///
+    /// \brief Sets nice value (and I/O priority on linux) for calling thread so background work
+    /// like archiving does not starve request handlers
+    ///
+    static void lowerCurrentThreadPriority(int niceness);
+
+    ///
+    /// \brief Buffer size used when file contents have to be copied through user space
+    ///
+    static const std::size_t COPY_BUFFER_SIZE;
+
+    ///
+    /// \brief Copies len bytes from current offset of inFd to current offset of outFd. On linux data
+    /// is moved in kernel (copy_file_range, then sendfile), otherwise using COPY_BUFFER_SIZE buffer.
+    /// outFd must not be opened with O_APPEND
+    /// \return False if fewer than len bytes were copied
+    ///
+    static bool copyFileData(int outFd, int inFd, std::size_t len);
+
     // compression
-    static bool archiveFiles(const std::string& outputFile, const std::unordered_map<std::string, std::string>& files);
+    enum class ArchiveFormat : unsigned short
+    {
+        Tar = 1,
+        TarGz = 2,
+        TarZstd = 3
+    };
+
+    ///
+    /// \brief Format of compressed archive based on its filename. Anything not ending with .tar.zst
+    /// (or .tzst) is gzipped to stay compatible with existing configurations
+    ///
+    static ArchiveFormat compressedArchiveFormat(const std::string& filename);
+
+    ///
+    /// \brief Whether this build can write .tar.zst archives
+    ///
+    static bool isZstdSupported();
+
+    ///
+    /// \brief Creates tar archive of files (source => name in archive). Compressed formats are
+    /// compressed on the fly using compressThreads threads. zstdLevel and zstdLongDistance
+    /// are only used for ArchiveFormat::TarZstd
+    ///
+    static bool archiveFiles(const std::string& outputFile, const std::unordered_map<std::string, std::string>& files,
+                             ArchiveFormat format = ArchiveFormat::Tar, unsigned int compressThreads = 1,
+                             int zstdLevel = 3, bool zstdLongDistance = false);
+
+    ///
+    /// \brief Part of a file that was compressed before archiving (see LogSegmenter)
+    ///
+    struct CompressedSegment
+    {
+        std::string filename;
+        std::size_t size; // uncompressed
+        // when segment was opened and closed, 0 if unknown
+        types::Time from;
+        types::Time to;
+    };
+
+    // source file => its compressed segments in order
+    using CompressedSegments = std::unordered_map<std::string, std::vector<CompressedSegment>>;
+
+    ///
+    /// \brief Same as archiveFiles but source files can be preceded by segments that are already
+    /// compressed in the same format. Segments are copied without compressing again and each file is still
+    /// a single entry in the archive
+    /// \param frames If not null, filled with independently compressed parts that contain logs (see ArchiveIndex)
+    ///
+    static bool archiveFilesWithSegments(const std::string& outputFile, const std::unordered_map<std::string, std::string>& files,
+                                         const CompressedSegments& segments, ArchiveFormat format,
+                                         unsigned int compressThreads = 1, int zstdLevel = 3, bool zstdLongDistance = false,
+                                         std::vector<ArchiveFrame>* frames = nullptr);
+
+    ///
+    /// \brief Extension added to compressed segments (.gz or .zst)
+    ///
+    static std::string compressedExtension(ArchiveFormat format);
+
+    ///
+    /// \brief Compresses single file as it is (without tar) in format of archive
+    ///
+    static bool compressFile(const std::string& outputFile, const std::string& inputFile, ArchiveFormat format,
+                             int zstdLevel = 3, bool zstdLongDistance = false);
+
+    ///
+    /// \brief Decompresses file created by compressFile
+    ///
+    static bool decompressFile(const std::string& outputFile, const std::string& inputFile, ArchiveFormat format);
 
     // date
     static inline types::Time now()
@@ -115,6 +203,12 @@ public:
 
     static std::tm timeToTm(types::Time epochInSec);
 
+    ///
+    /// \brief Parses epoch seconds or local time in %Y-%m-%dT%H:%M[:%S] format
+    /// \return 0 if invalid
+    ///
+    static types::Time parseTime(const std::string& str);
+
     // serization
     static bool isJSON(const std::string& data);
 
@@ -56,5 +56,65 @@ TEST(AdminRequestTest, DeserializeTest)
     ASSERT_TRUE(r.isValid());
 }
 
+TEST(AdminRequestTest, DeserializeSearch)
+{
+    std::stringstream ss;
+    ss << R"({"type": 10, "text": "request-id", "_t":)" << Utils::now() << "}";
+    AdminRequest r(nullptr);
+    r.setDateReceived(Utils::now());
+    r.deserialize(ss.str());
+    // logger ID is required
+    ASSERT_FALSE(r.isValid());
+
+    ss.str("");
+    ss << R"({"type": 10, "logger_id": "sample-app", "text": "request-id", "regex": true,)"
+       << R"( "from": 1519812917, "to": "2018-02-28T21:00", "max_results": 50, "logging_levels": ["error"], "_t":)"
+       << Utils::now() << "}";
+    AdminRequest r2(nullptr);
+    r2.setDateReceived(Utils::now());
+    r2.deserialize(ss.str());
+    ASSERT_TRUE(r2.isValid());
+    ASSERT_EQ(AdminRequest::Type::SEARCH, r2.type());
+    ASSERT_EQ("request-id", r2.text());
+    ASSERT_TRUE(r2.isRegex());
+    ASSERT_FALSE(r2.isWord());
+    ASSERT_EQ("1519812917", r2.from());
+    ASSERT_EQ("2018-02-28T21:00", r2.to());
+    ASSERT_EQ(50, r2.maxResults());
+    ASSERT_EQ(1, r2.loggingLevels().count("error"));
+
+    ss.str("");
+    ss << R"({"type": 10, "logger_id": "sample-app", "text": "request-id", "word": true, "_t":)" << Utils::now() << "}";
+    AdminRequest r3(nullptr);
+    r3.setDateReceived(Utils::now());
+    r3.deserialize(ss.str());
+    ASSERT_TRUE(r3.isValid());
+    ASSERT_FALSE(r3.isRegex());
+    ASSERT_TRUE(r3.isWord());
+}
+
+TEST(AdminRequestTest, DeserializeTail)
+{
+    std::stringstream ss;
+    ss << R"({"type": 11, "_t":)" << Utils::now() << "}";
+    AdminRequest r(nullptr);
+    r.setDateReceived(Utils::now());
+    r.deserialize(ss.str());
+    // logger ID is required
+    ASSERT_FALSE(r.isValid());
+
+    ss.str("");
+    ss << R"({"type": 11, "logger_id": "sample-app", "client_id": "muflihun00102030", "logging_levels": ["warning"], "_t":)"
+       << Utils::now() << "}";
+    AdminRequest r2(nullptr);
+    r2.setDateReceived(Utils::now());
+    r2.deserialize(ss.str());
+    ASSERT_TRUE(r2.isValid());
+    ASSERT_EQ(AdminRequest::Type::TAIL, r2.type());
+    ASSERT_EQ("sample-app", r2.loggerId());
+    ASSERT_EQ("muflihun00102030", r2.clientId());
+    ASSERT_EQ(1, r2.loggingLevels().count("warning"));
+}
+
 
 #endif // ADMIN_REQUEST_TEST_H
@@ -112,6 +112,7 @@ protected:
                               "enable_cli": false,
                               "allow_insecure_connection": true,
                               "immediate_flush": true,
+                              "trusted_socket_users": [{ "user": "root", "client_ids": ["client-for-test"] }],
                               "allow_bulk_log_request": true,
                               "client_integrity_task_interval": 500,
                               "client_age": 2147483648,
@@ -205,6 +206,11 @@ TEST_F(ConfigurationTest, CheckValues)
     ASSERT_EQ(conf->keySize("client-for-test"), 128);
     ASSERT_EQ(conf->keySize("client-for-test2"), 256);
     ASSERT_EQ(conf->getConfigurationFile("muflihun"), "muflihun-logger.conf");
+    ASSERT_EQ(conf->socketMode(), 432);
+    ASSERT_TRUE(conf->isTrustedSocketUser(0));
+    ASSERT_TRUE(conf->isTrustedSocketClient(0, "client-for-test"));
+    ASSERT_FALSE(conf->isTrustedSocketClient(0, "client-for-test2"));
+    ASSERT_FALSE(conf->isTrustedSocketClient(65534, "client-for-test"));
 
     ASSERT_EQ(conf->managedLoggersEndpoint(), "http://localhost:3000/managed-loggers");
     ASSERT_EQ(conf->managedClientsEndpoint(), "http://localhost:3000/managed-clients");
@@ -297,7 +303,7 @@ TEST_F(ConfigurationTest, ManagedLoggersRequestAllowed)
             LogRequest logRequest(registry.configuration());
             logRequest.setDateReceived(Utils::now());
             logRequest.deserialize(std::move(r1));
-            logRequest.setClient(t.get<1>());
+            logRequest.setClient(std::make_shared<Client>(*t.get<1>()));
             ASSERT_EQ(logProcessor.isRequestAllowed(&logRequest), t.get<2>())
                     << "Logger: " << t.get<0>() << " Client: " << t.get<1>()->id();
         }
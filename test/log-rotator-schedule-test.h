@@ -22,10 +22,16 @@
 
 #include "test.h"
 
+#include <algorithm>
+#include <fstream>
 #include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "tasks/archive-retention.h"
 #include "tasks/log-rotator.h"
+#include "tasks/log-segmenter.h"
 #include "utils/utils.h"
 
 using namespace residue;
@@ -225,4 +231,197 @@ TEST(LogRotatorScheduleTest, YearlyRoundOffCalculation)
     }
 }
 
+TEST(LogRotatorScheduleTest, SequencedFilename)
+{
+    // size based rotations can happen more than once in same period
+    ASSERT_EQ("mylogs-17-00-Mon.tar.gz", LogRotator::sequencedFilename("mylogs-17-00-Mon.tar.gz", 0));
+    ASSERT_EQ("mylogs-17-00-Mon.1.tar.gz", LogRotator::sequencedFilename("mylogs-17-00-Mon.tar.gz", 1));
+    ASSERT_EQ("mylogs-17-00-Mon.12.tar.zst", LogRotator::sequencedFilename("mylogs-17-00-Mon.tar.zst", 12));
+    ASSERT_EQ("mylogs-17-00-Mon-info.2.log", LogRotator::sequencedFilename("mylogs-17-00-Mon-info.log", 2));
+    ASSERT_EQ("mylogs.3", LogRotator::sequencedFilename("mylogs", 3));
+    ASSERT_EQ(".hidden.4", LogRotator::sequencedFilename(".hidden", 4));
+    ASSERT_EQ("mylogs-17-00-Mon.5.tzst", LogRotator::sequencedFilename("mylogs-17-00-Mon.tzst", 5));
+    ASSERT_EQ("mylogs-17-00-Mon.6.tgz", LogRotator::sequencedFilename("mylogs-17-00-Mon.tgz", 6));
+    ASSERT_EQ("mylogs-17-00-Mon.7.tar", LogRotator::sequencedFilename("mylogs-17-00-Mon.tar", 7));
+}
+
+TEST(LogRotatorScheduleTest, CompressedExtension)
+{
+    // compressed segments use extension of archive format
+    TestData<std::string, Utils::ArchiveFormat, std::string> TData = {
+        { "mylogs-17-00-Mon.tar.gz", Utils::ArchiveFormat::TarGz, ".gz" },
+        { "mylogs-17-00-Mon.tgz", Utils::ArchiveFormat::TarGz, ".gz" },
+        { "mylogs-17-00-Mon.tar", Utils::ArchiveFormat::TarGz, ".gz" },
+        { "mylogs-17-00-Mon.tar.zst", Utils::ArchiveFormat::TarZstd, ".zst" },
+        { "mylogs-17-00-Mon.tzst", Utils::ArchiveFormat::TarZstd, ".zst" },
+        { "mylogs-17-00-Mon.2.tar.zst", Utils::ArchiveFormat::TarZstd, ".zst" },
+    };
+
+    for (auto& item : TData) {
+        ASSERT_EQ(item.get<1>(), Utils::compressedArchiveFormat(item.get<0>())) << item.get<0>();
+        ASSERT_EQ(item.get<2>(), Utils::compressedExtension(Utils::compressedArchiveFormat(item.get<0>()))) << item.get<0>();
+    }
+    ASSERT_EQ("", Utils::compressedExtension(Utils::ArchiveFormat::Tar));
+}
+
+TEST(LogRotatorScheduleTest, NextSequence)
+{
+    const std::string dir = "/tmp/residue_unit_test_sequence/";
+    ASSERT_TRUE(Utils::createPath(dir));
+    auto touch = [&](const std::string& f) {
+        std::ofstream ss(dir + f, std::ios::out | std::ios::trunc);
+        ss << "line" << std::endl;
+    };
+    auto target = [&](const std::string& archiveFilename) -> LogRotator::RotateTarget {
+        return { dir, archiveFilename, { { "/tmp/mylogs.log", dir, "mylogs-17-00-Mon.log" } } };
+    };
+
+    for (const std::string ext : { ".tar.gz", ".tar.zst" }) {
+        const std::string archiveFilename = "mylogs-17-00-Mon" + ext;
+
+        // scheduled rotation does not add sequence unless period was already rotated
+        LogRotator::RotateTarget scheduled = target(archiveFilename);
+        LogRotator::applyNextSequence(&scheduled, 0);
+        ASSERT_EQ(archiveFilename, scheduled.archiveFilename);
+        ASSERT_EQ("mylogs-17-00-Mon.log", scheduled.items[0].targetFilename);
+
+        // size based rotation always adds sequence
+        LogRotator::RotateTarget sized = target(archiveFilename);
+        LogRotator::applyNextSequence(&sized, 1);
+        ASSERT_EQ("mylogs-17-00-Mon.1" + ext, sized.archiveFilename);
+        ASSERT_EQ("mylogs-17-00-Mon.1.log", sized.items[0].targetFilename);
+
+        // archive from same period already exists (e.g, manual rotation)
+        touch(archiveFilename);
+        scheduled = target(archiveFilename);
+        LogRotator::applyNextSequence(&scheduled, 0);
+        ASSERT_EQ("mylogs-17-00-Mon.1" + ext, scheduled.archiveFilename);
+        ASSERT_EQ("mylogs-17-00-Mon.1.log", scheduled.items[0].targetFilename);
+
+        // size based archive and rotated file left by failed archive
+        touch("mylogs-17-00-Mon.1" + ext);
+        touch("mylogs-17-00-Mon.2.log");
+        scheduled = target(archiveFilename);
+        LogRotator::applyNextSequence(&scheduled, 0);
+        ASSERT_EQ("mylogs-17-00-Mon.3" + ext, scheduled.archiveFilename);
+        ASSERT_EQ("mylogs-17-00-Mon.3.log", scheduled.items[0].targetFilename);
+        sized = target(archiveFilename);
+        LogRotator::applyNextSequence(&sized, 1);
+        ASSERT_EQ("mylogs-17-00-Mon.3" + ext, sized.archiveFilename);
+
+        for (const auto& f : { archiveFilename, "mylogs-17-00-Mon.1" + ext, std::string("mylogs-17-00-Mon.2.log") }) {
+            ::remove((dir + f).c_str());
+        }
+    }
+    ::remove(dir.c_str());
+}
+
+TEST(LogRotatorScheduleTest, SegmentsFromPreviousRun)
+{
+    const std::string filename = "/tmp/residue_unit_test_segments.log";
+    auto touch = [](const std::string& f) {
+        std::ofstream ss(f, std::ios::out | std::ios::trunc);
+        ss << "line" << std::endl;
+    };
+    touch(LogSegmenter::segmentFilename(filename, 1));
+    touch(filename + ".segment-2.120.gz");
+    // interrupted compression, uncompressed segment is kept
+    touch(LogSegmenter::segmentFilename(filename, 3));
+    touch(filename + ".segment-3.5.gz");
+    touch(filename + ".segment-x");
+
+    LogSegmenter segmenter(nullptr);
+    ASSERT_TRUE(segmenter.hasSegments(filename));
+    auto segments = segmenter.takeSegments(filename);
+    ASSERT_FALSE(segmenter.hasSegments(filename));
+    ASSERT_EQ(3, segments.size());
+    ASSERT_EQ(1, segments[0]->sequence);
+    ASSERT_EQ("", segments[0]->compressedFilename);
+    ASSERT_EQ(2, segments[1]->sequence);
+    ASSERT_EQ(filename + ".segment-2.120.gz", segments[1]->compressedFilename);
+    ASSERT_EQ(120, segments[1]->size);
+    ASSERT_EQ(3, segments[2]->sequence);
+    ASSERT_EQ("", segments[2]->compressedFilename);
+    ASSERT_FALSE(Utils::fileExists((filename + ".segment-3.5.gz").c_str()));
+
+    // segments that rotation could not archive go back in front of newer ones
+    auto first = std::vector<std::shared_ptr<LogSegmenter::Segment>>(segments.begin(), segments.begin() + 2);
+    auto newer = std::vector<std::shared_ptr<LogSegmenter::Segment>>(segments.begin() + 2, segments.end());
+    segmenter.restoreSegments(filename, std::move(newer));
+    segmenter.restoreSegments(filename, std::move(first));
+    ASSERT_TRUE(segmenter.hasSegments(filename));
+    ASSERT_EQ(3, segmenter.segments(filename).size());
+    segments = segmenter.takeSegments(filename);
+    ASSERT_EQ(3, segments.size());
+    ASSERT_EQ(1, segments[0]->sequence);
+    ASSERT_EQ(2, segments[1]->sequence);
+    ASSERT_EQ(3, segments[2]->sequence);
+
+    for (const auto& f : { LogSegmenter::segmentFilename(filename, 1), filename + ".segment-2.120.gz",
+                           LogSegmenter::segmentFilename(filename, 3), filename + ".segment-x" }) {
+        ::remove(f.c_str());
+    }
+}
+
+TEST(LogRotatorScheduleTest, ArchivePattern)
+{
+    const std::string pattern = "/var/log/archives/%year/mylogs-%hour-%min.tar.gz";
+    ASSERT_TRUE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/mylogs-17-00.tar.gz", pattern));
+    ASSERT_TRUE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/mylogs-17-00.2.tar.gz", pattern));
+    ASSERT_TRUE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/mylogs-Mon-Q1.12.tar.gz",
+                                                        "/var/log/archives/%year/mylogs-%wday-%quarter.tar.gz"));
+    ASSERT_TRUE(ArchiveRetention::matchesArchivePattern("/var/log/archives/Feb-28/mylogs.tar.gz",
+                                                        "/var/log/archives/%month-%day/mylogs.tar.gz"));
+    // specifiers only match what they resolve to
+    ASSERT_FALSE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/Feb/mylogs-17-00.tar.gz", pattern));
+    ASSERT_FALSE(ArchiveRetention::matchesArchivePattern("/var/log/archives/18/mylogs-17-00.tar.gz", pattern));
+    ASSERT_FALSE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/mylogs-7-00.tar.gz", pattern));
+    ASSERT_FALSE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/mylogs-Mon-Q5.tar.gz",
+                                                         "/var/log/archives/%year/mylogs-%wday-%quarter.tar.gz"));
+    ASSERT_FALSE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/mylogs-Abc-Q1.tar.gz",
+                                                         "/var/log/archives/%year/mylogs-%wday-%quarter.tar.gz"));
+    ASSERT_FALSE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/mylogs-17-00.tar.zst", pattern));
+    ASSERT_FALSE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/other-17-00.tar.gz", pattern));
+    ASSERT_FALSE(ArchiveRetention::matchesArchivePattern("/var/log/archives/2018/mylogs-17-00.x.tar.gz", "/var/log/archives/2018/mylogs-17-00.tar.gz"));
+    ASSERT_TRUE(ArchiveRetention::matchesArchivePattern("/var/log/mylogs.3.tar.gz", "/var/log/mylogs.tar.gz"));
+}
+
+TEST(LogRotatorScheduleTest, ArchivesOfLoggersSharingPrefix)
+{
+    const std::string dir = "/tmp/residue_unit_test_retention";
+    ASSERT_TRUE(Utils::createPath(dir));
+    const std::vector<std::string> appArchives = { "app.Mon.tar.gz", "app.Tue.2.tar.gz", "app-17.tar.gz" };
+    const std::vector<std::string> otherArchives = { "app.worker.Mon.tar.gz", "app.worker.Tue.3.tar.gz",
+                                                     "app.Mon.tar.gz.idx", "app-17-worker.tar.gz", "app-1x.tar.gz" };
+    for (const auto& f : appArchives) {
+        std::ofstream ss(dir + "/" + f, std::ios::out | std::ios::trunc);
+    }
+    for (const auto& f : otherArchives) {
+        std::ofstream ss(dir + "/" + f, std::ios::out | std::ios::trunc);
+    }
+
+    auto find = [&](const std::string& loggerId, const std::string& compressedFilename) {
+        std::vector<std::string> result;
+        for (const auto& archive : ArchiveRetention::findArchives(
+                 ArchiveRetention::archivePattern(loggerId, dir, compressedFilename, "/var/log/"))) {
+            result.push_back(archive.filename.substr(dir.size() + 1));
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+
+    ASSERT_EQ(std::vector<std::string>({ "app.Mon.tar.gz", "app.Tue.2.tar.gz" }), find("app", "%logger.%wday.tar.gz"));
+    ASSERT_EQ(std::vector<std::string>({ "app.worker.Mon.tar.gz", "app.worker.Tue.3.tar.gz" }),
+              find("app.worker", "%logger.%wday.tar.gz"));
+    ASSERT_EQ(std::vector<std::string>({ "app-17.tar.gz" }), find("app", "%logger-%hour.tar.gz"));
+
+    for (const auto& f : appArchives) {
+        ::remove((dir + "/" + f).c_str());
+    }
+    for (const auto& f : otherArchives) {
+        ::remove((dir + "/" + f).c_str());
+    }
+    ::remove(dir.c_str());
+}
+
 #endif // LOG_ROTATOR_SCHEDULE_TEST_H
@@ -26,6 +26,7 @@
 #include "crypto-test.h"
 #include "json-test.h"
 #include "log-rotator-schedule-test.h"
+#include "networking-test.h"
 #include "task-schedule-test.h"
 #include "url-test.h"
 #include "utils-test.h"
@@ -0,0 +1,573 @@
+//
+//  networking-test.h
+//  Residue
+//
+//  Copyright 2017-present @abumq (Majid Q.)
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#ifndef NETWORKING_TEST_H
+#define NETWORKING_TEST_H
+
+#include "test.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "connect/connection-request.h"
+#include "core/client.h"
+#include "core/configuration.h"
+#include "core/registry.h"
+#include "core/request-handler.h"
+#include "core/residue-exception.h"
+#include "crypto/aes.h"
+#include "logging/client-queue-processor.h"
+#include "logging/log-request-handler.h"
+#include "net/session.h"
+#include "net/shm-ring.h"
+#include "net/udp-server.h"
+#include "utils/utils.h"
+
+using namespace residue;
+
+class NetworkingTestHandler final : public RequestHandler
+{
+public:
+    explicit NetworkingTestHandler(Registry* registry) :
+        RequestHandler("Test", registry)
+    {
+    }
+
+    virtual void handle(RawRequest&&) override
+    {
+    }
+};
+
+///
+/// \brief Session over one end of socket pair, responses are read from the other end
+///
+class SessionTest : public ::testing::Test
+{
+protected:
+    SessionTest() :
+        m_registry(&m_conf)
+    {
+    }
+
+    void SetUp() override
+    {
+        m_conf.loadFromInput(configurationInput());
+        m_handler = std::unique_ptr<NetworkingTestHandler>(new NetworkingTestHandler(&m_registry));
+        int fds[2];
+        ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+        m_peer = fds[1];
+        ::fcntl(m_peer, F_SETFL, ::fcntl(m_peer, F_GETFL) | O_NONBLOCK);
+        Session::Socket socket(m_io);
+        socket.assign(net::generic::stream_protocol(AF_UNIX, SOCK_STREAM), fds[0]);
+        m_session = std::make_shared<Session>(std::move(socket), m_handler.get(), "test");
+    }
+
+    void TearDown() override
+    {
+        m_session.reset();
+        ::close(m_peer);
+    }
+
+    virtual std::string configurationInput() const
+    {
+        return R"({ "admin_port": 87761, "connect_port": 87771, "logging_port": 87791,
+                    "allow_unmanaged_loggers": true, "enable_cli": false })";
+    }
+
+    ///
+    /// \brief Runs session's io (writes and acknowledgement timer) and returns what peer received
+    ///
+    std::string received(unsigned int waitMs = 0)
+    {
+        if (waitMs > 0) {
+            m_io.run_for(std::chrono::milliseconds(waitMs));
+            m_io.restart();
+        }
+        m_io.poll();
+        m_io.restart();
+        std::string result;
+        char buffer[1024];
+        ssize_t n;
+        while ((n = ::read(m_peer, buffer, sizeof(buffer))) > 0) {
+            result.append(buffer, static_cast<std::size_t>(n));
+        }
+        return result;
+    }
+
+    Configuration m_conf;
+    Registry m_registry;
+    std::unique_ptr<NetworkingTestHandler> m_handler;
+    net::io_service m_io;
+    int m_peer;
+    std::shared_ptr<Session> m_session;
+};
+
+TEST(NetworkingTest, BuildCumulativeAck)
+{
+    ASSERT_EQ("{\"r\":0,\"seq\":1}\r\n\r\n", *Session::buildCumulativeAck(Response::StatusCode::OK, 1));
+    ASSERT_EQ("{\"r\":1,\"seq\":18446744073709551615}\r\n\r\n",
+              *Session::buildCumulativeAck(Response::StatusCode::BAD_REQUEST, 18446744073709551615ULL));
+}
+
+TEST_F(SessionTest, CumulativeAckEvery)
+{
+    m_session->setAckMode(Client::AckMode::CUMULATIVE, 3, 0);
+    m_session->acknowledge(Response::StatusCode::OK);
+    m_session->acknowledge(Response::StatusCode::OK);
+    ASSERT_EQ("", received());
+    m_session->acknowledge(Response::StatusCode::OK);
+    ASSERT_EQ("{\"r\":0,\"seq\":3}\r\n\r\n", received());
+
+    // failed packet right after acknowledgement only reports failure
+    m_session->acknowledge(Response::StatusCode::BAD_REQUEST);
+    ASSERT_EQ("{\"r\":1,\"seq\":4}\r\n\r\n", received());
+
+    // packets before failed one are acknowledged first, failed packet counts towards sequence
+    m_session->acknowledge(Response::StatusCode::OK);
+    m_session->acknowledge(Response::StatusCode::INVALID_CLIENT);
+    ASSERT_EQ("{\"r\":0,\"seq\":5}\r\n\r\n{\"r\":2,\"seq\":6}\r\n\r\n", received());
+    m_session->acknowledge(Response::StatusCode::OK);
+    m_session->acknowledge(Response::StatusCode::OK);
+    ASSERT_EQ("", received());
+    m_session->acknowledge(Response::StatusCode::OK);
+    ASSERT_EQ("{\"r\":0,\"seq\":9}\r\n\r\n", received());
+}
+
+TEST_F(SessionTest, CumulativeAckInterval)
+{
+    m_session->setAckMode(Client::AckMode::CUMULATIVE, 0, 20);
+    m_session->acknowledge(Response::StatusCode::OK);
+    m_session->acknowledge(Response::StatusCode::OK);
+    ASSERT_EQ("", received());
+    // everything received so far is flushed once interval passes
+    ASSERT_EQ("{\"r\":0,\"seq\":2}\r\n\r\n", received(100));
+    // nothing new, nothing to flush
+    ASSERT_EQ("", received(50));
+
+    // whichever comes first
+    m_session->setAckMode(Client::AckMode::CUMULATIVE, 2, 20);
+    m_session->acknowledge(Response::StatusCode::OK);
+    m_session->acknowledge(Response::StatusCode::OK);
+    ASSERT_EQ("{\"r\":0,\"seq\":4}\r\n\r\n", received());
+    m_session->acknowledge(Response::StatusCode::OK);
+    ASSERT_EQ("{\"r\":0,\"seq\":5}\r\n\r\n", received(100));
+}
+
+TEST_F(SessionTest, AckModes)
+{
+    // fire-and-forget only hears about failures
+    m_session->setAckMode(Client::AckMode::NONE, 0, 0);
+    m_session->acknowledge(Response::StatusCode::OK);
+    ASSERT_EQ("", received());
+    m_session->acknowledge(Response::StatusCode::BAD_REQUEST);
+    ASSERT_EQ("{\"r\":1}\r\n\r\n", received());
+
+    m_session->setAckMode(Client::AckMode::PER_PACKET, 0, 0);
+    m_session->acknowledge(Response::StatusCode::OK);
+    m_session->acknowledge(Response::StatusCode::OK);
+    ASSERT_EQ("{\"r\":0}\r\n\r\n{\"r\":0}\r\n\r\n", received());
+}
+
+///
+/// \brief Session feeding client queue that is limited to 4 requests and resumes at 1
+///
+class QueueDepthTest : public SessionTest
+{
+protected:
+    std::string configurationInput() const override
+    {
+        return R"({ "admin_port": 87761, "connect_port": 87771, "logging_port": 87791,
+                    "allow_unmanaged_loggers": true, "enable_cli": false,
+                    "compression": false, "max_queue_depth": 4, "queue_resume_depth": 1 })";
+    }
+};
+
+TEST_F(QueueDepthTest, PauseAndResume)
+{
+    ClientQueueProcessor processor(&m_registry, "test");
+    for (int i = 0; i < 3; ++i) {
+        processor.handle(RawRequest { "{}", "127.0.0.1", Utils::now(), nullptr, nullptr });
+        EXPECT_FALSE(processor.isOverloaded());
+    }
+    processor.handle(RawRequest { "{}", "127.0.0.1", Utils::now(), nullptr, nullptr });
+    EXPECT_TRUE(processor.isOverloaded());
+
+    processor.pauseSession(m_session);
+    EXPECT_TRUE(m_session->readPaused());
+    // nothing resumes session until queue is drained
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    received();
+    EXPECT_TRUE(m_session->readPaused());
+
+    // worker drops invalid requests and resumes session once queue is down to queue_resume_depth
+    processor.start();
+    for (int i = 0; i < 100 && m_session->readPaused(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        received();
+    }
+    ASSERT_FALSE(m_session->readPaused());
+    ASSERT_FALSE(processor.isOverloaded());
+}
+
+TEST_F(SessionTest, QueueDepthUnlimited)
+{
+    // max_queue_depth of 0 never pauses sessions
+    ClientQueueProcessor processor(&m_registry, "test");
+    for (int i = 0; i < 100; ++i) {
+        processor.handle(RawRequest { "{}", "127.0.0.1", Utils::now(), nullptr, nullptr });
+    }
+    ASSERT_FALSE(processor.isOverloaded());
+}
+
+///
+/// \brief Acts as producer of a ring of MIN_CAPACITY bytes owned by current user
+///
+class ShmRingTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_name = "/residue-unit-test-" + std::to_string(::getpid());
+        int fd = ::shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        ASSERT_GE(fd, 0);
+        // shm_open mode is subject to umask
+        ::fchmod(fd, 0600);
+        m_size = sizeof(ShmRing::Header) + ShmRing::MIN_CAPACITY;
+        ASSERT_EQ(0, ::ftruncate(fd, static_cast<off_t>(m_size)));
+        void* segment = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        ASSERT_NE(MAP_FAILED, segment);
+        m_header = static_cast<ShmRing::Header*>(segment);
+        m_data = static_cast<char*>(segment) + sizeof(ShmRing::Header);
+        std::memcpy(m_header->magic, ShmRing::MAGIC, sizeof(ShmRing::MAGIC));
+        m_header->version = ShmRing::VERSION;
+        m_header->state = static_cast<std::uint32_t>(ShmRing::State::OPEN);
+        m_header->capacity = ShmRing::MIN_CAPACITY;
+        m_header->head = 0;
+        m_header->tail = 0;
+    }
+
+    void TearDown() override
+    {
+        ::munmap(m_header, m_size);
+        ::shm_unlink(m_name.c_str());
+    }
+
+    ///
+    /// \brief Starts ring (empty) at position so records can be made to wrap around
+    ///
+    void startAt(std::uint64_t position)
+    {
+        m_header->head = position;
+        m_header->tail = position;
+    }
+
+    ///
+    /// \brief Writes bytes at head (wrapping around) without publishing them
+    ///
+    void write(const char* src, std::size_t len)
+    {
+        for (std::size_t i = 0; i < len; ++i) {
+            m_data[(m_header->head + m_written + i) & (ShmRing::MIN_CAPACITY - 1)] = src[i];
+        }
+        m_written += len;
+    }
+
+    void publish(std::size_t len)
+    {
+        m_header->head += len;
+        m_written -= len;
+    }
+
+    void push(const std::string& record)
+    {
+        std::uint32_t len = static_cast<std::uint32_t>(record.size());
+        write(reinterpret_cast<const char*>(&len), sizeof(len));
+        write(record.data(), record.size());
+        publish(sizeof(len) + record.size());
+    }
+
+    std::string m_name;
+    std::size_t m_size;
+    ShmRing::Header* m_header;
+    char* m_data;
+    std::size_t m_written = 0;
+};
+
+TEST_F(ShmRingTest, Ownership)
+{
+    ASSERT_THROW(ShmRing(m_name, "test", -1), ResidueException);
+    ASSERT_THROW(ShmRing(m_name, "test", static_cast<int>(::getuid()) + 1), ResidueException);
+    ASSERT_THROW(ShmRing("/residue-unit-test-missing", "test", static_cast<int>(::getuid())), ResidueException);
+    int fd = ::shm_open(m_name.c_str(), O_RDWR, 0);
+    ::fchmod(fd, 0620);
+    ASSERT_THROW(ShmRing(m_name, "test", static_cast<int>(::getuid())), ResidueException);
+    ::fchmod(fd, 0600);
+    ::close(fd);
+    ShmRing ring(m_name, "test", static_cast<int>(::getuid()));
+    ASSERT_EQ("test", ring.clientId());
+    ASSERT_FALSE(ring.closed());
+}
+
+TEST_F(ShmRingTest, Pop)
+{
+    ShmRing ring(m_name, "test", static_cast<int>(::getuid()));
+    std::string output;
+    ASSERT_FALSE(ring.pop(output));
+    push("first");
+    push("second");
+    ASSERT_TRUE(ring.pop(output));
+    ASSERT_EQ("first", output);
+    ASSERT_TRUE(ring.pop(output));
+    ASSERT_EQ("second", output);
+    ASSERT_FALSE(ring.pop(output));
+    ASSERT_EQ(m_header->head.load(), m_header->tail.load());
+
+    m_header->state = static_cast<std::uint32_t>(ShmRing::State::CLOSED);
+    ASSERT_TRUE(ring.closed());
+}
+
+TEST_F(ShmRingTest, PartialRecord)
+{
+    ShmRing ring(m_name, "test", static_cast<int>(::getuid()));
+    std::string output = "untouched";
+    const std::string record = "partially published";
+    std::uint32_t len = static_cast<std::uint32_t>(record.size());
+    write(reinterpret_cast<const char*>(&len), sizeof(len));
+    write(record.data(), record.size());
+
+    // only part of length is published
+    publish(2);
+    ASSERT_FALSE(ring.pop(output));
+    // length but not all of the record
+    publish(sizeof(len) - 2 + 5);
+    ASSERT_FALSE(ring.pop(output));
+    ASSERT_EQ("untouched", output);
+    ASSERT_EQ(0U, m_header->tail.load());
+    ASSERT_FALSE(ring.closed());
+
+    publish(record.size() - 5);
+    ASSERT_TRUE(ring.pop(output));
+    ASSERT_EQ(record, output);
+}
+
+TEST_F(ShmRingTest, WrapAround)
+{
+    ShmRing ring(m_name, "test", static_cast<int>(::getuid()));
+    std::string output;
+
+    // record wraps
+    startAt(ShmRing::MIN_CAPACITY - 10);
+    push("record wrapping around the end");
+    ASSERT_TRUE(ring.pop(output));
+    ASSERT_EQ("record wrapping around the end", output);
+
+    // length itself wraps
+    startAt(3 * ShmRing::MIN_CAPACITY - 2);
+    push("length wraps");
+    push("after wrap");
+    ASSERT_TRUE(ring.pop(output));
+    ASSERT_EQ("length wraps", output);
+    ASSERT_TRUE(ring.pop(output));
+    ASSERT_EQ("after wrap", output);
+    ASSERT_FALSE(ring.closed());
+}
+
+TEST_F(ShmRingTest, CorruptedLength)
+{
+    ShmRing ring(m_name, "test", static_cast<int>(::getuid()));
+    std::string output;
+    // record claims to be bigger than ring
+    std::uint32_t len = static_cast<std::uint32_t>(ShmRing::MIN_CAPACITY);
+    write(reinterpret_cast<const char*>(&len), sizeof(len));
+    publish(sizeof(len));
+    ASSERT_FALSE(ring.pop(output));
+    ASSERT_TRUE(ring.closed());
+
+    // ring is not read any further even if producer recovers
+    startAt(0);
+    push("valid");
+    ASSERT_FALSE(ring.pop(output));
+    ASSERT_TRUE(ring.closed());
+}
+
+TEST_F(ShmRingTest, ZeroLengthAndOverrun)
+{
+    {
+        ShmRing ring(m_name, "test", static_cast<int>(::getuid()));
+        std::string output;
+        push("");
+        ASSERT_FALSE(ring.pop(output));
+        ASSERT_TRUE(ring.closed());
+    }
+    {
+        // head ahead of tail by more than capacity
+        startAt(0);
+        ShmRing ring(m_name, "test", static_cast<int>(::getuid()));
+        std::string output;
+        push("valid");
+        m_header->head += ShmRing::MIN_CAPACITY;
+        ASSERT_FALSE(ring.pop(output));
+        ASSERT_TRUE(ring.closed());
+    }
+}
+
+TEST_F(ShmRingTest, Truncated)
+{
+    ShmRing ring(m_name, "test", static_cast<int>(::getuid()));
+    std::string output;
+    push("before truncation");
+    int fd = ::shm_open(m_name.c_str(), O_RDWR, 0);
+    ASSERT_EQ(0, ::ftruncate(fd, 0));
+    ::close(fd);
+    // segment is gone under the mapping, ring detaches instead of crashing
+    ASSERT_FALSE(ring.pop(output));
+    ASSERT_TRUE(ring.closed());
+}
+
+TEST(NetworkingTest, DatagramRequestData)
+{
+    auto requestData = [](const std::string& datagram) -> std::string {
+        return UdpServer::requestData(datagram.data(), datagram.size());
+    };
+    ASSERT_EQ("request", requestData("request\r\n\r\n"));
+    // delimiter is optional
+    ASSERT_EQ("request", requestData("request"));
+    ASSERT_EQ("", requestData("\r\n\r\n"));
+    ASSERT_EQ("", requestData(""));
+    // only complete trailing delimiter is removed, and only once
+    ASSERT_EQ("request\r\n", requestData("request\r\n"));
+    ASSERT_EQ("request\r\n\r\n", requestData("request\r\n\r\n\r\n\r\n"));
+    ASSERT_EQ("first\r\n\r\nsecond", requestData("first\r\n\r\nsecond"));
+}
+
+///
+/// \brief Log request handler with one (unmanaged) client known to registry, its queue
+/// is limited to 2 requests
+///
+class DatagramTest : public ::testing::Test
+{
+protected:
+    static const std::string CLIENT_ID;
+    static const std::string KEY;
+
+    DatagramTest() :
+        m_registry(&m_conf),
+        m_handler(&m_registry)
+    {
+    }
+
+    void SetUp() override
+    {
+        m_conf.loadFromInput(std::string(R"({ "admin_port": 87761, "connect_port": 87771, "logging_port": 87791,
+                                             "allow_unmanaged_loggers": true, "enable_cli": false,
+                                             "compression": false, "max_queue_depth": 2, "queue_resume_depth": 1 })"));
+        m_handler.start();
+        ConnectionRequest connectionReq(&m_conf);
+        connectionReq.setDateReceived(Utils::now());
+        ASSERT_TRUE(connectionReq.deserialize(std::string(R"({ "client_id": ")") + CLIENT_ID
+                                              + R"(", "type": 1, "key_size": 256, "_t": )" + std::to_string(Utils::now()) + " }"));
+        Client client(&connectionReq);
+        ASSERT_EQ(CLIENT_ID, client.id());
+        client.setKey(KEY);
+        client.setIsManaged(false);
+        ASSERT_TRUE(m_registry.addClient(client));
+    }
+
+    ///
+    /// \brief Datagram as client would send it, i.e, [iv]:[client_id]:[base64 data] followed by delimiter
+    ///
+    std::string datagram(const std::string& clientId, const std::string& request) const
+    {
+        std::string encrypted = AES::encrypt(request, KEY);
+        encrypted.insert(encrypted.find(':') + 1, clientId + ":");
+        return encrypted;
+    }
+
+    static std::string logRequest()
+    {
+        return R"({ "datetime": 1517579594000, "logger": "default", "msg": "over udp", "level": 4, "_t": )"
+                + std::to_string(Utils::now()) + " }";
+    }
+
+    LogRequestHandler::DatagramStatus send(const std::string& datagram)
+    {
+        return m_handler.handleDatagram(RawRequest {
+                                            UdpServer::requestData(datagram.data(), datagram.size()),
+                                            "127.0.0.1",
+                                            Utils::now(),
+                                            nullptr,
+                                            nullptr
+                                        });
+    }
+
+    Configuration m_conf;
+    Registry m_registry;
+    LogRequestHandler m_handler;
+};
+
+const std::string DatagramTest::CLIENT_ID = "datagram-client";
+const std::string DatagramTest::KEY = "A6A3E4A5B0B7F6D8C1D2E3F4A5B6C7D8A1B2C3D4E5F6A7B8C9D0E1F2A3B4C5D6";
+
+TEST_F(DatagramTest, Malformed)
+{
+    ASSERT_EQ(LogRequestHandler::DatagramStatus::MALFORMED, send(""));
+    ASSERT_EQ(LogRequestHandler::DatagramStatus::MALFORMED, send("not a request\r\n\r\n"));
+    // plain requests have no client
+    ASSERT_EQ(LogRequestHandler::DatagramStatus::MALFORMED, send(logRequest()));
+    // client not connected
+    ASSERT_EQ(LogRequestHandler::DatagramStatus::MALFORMED, send(datagram("unknown-client", logRequest())));
+    // no client id after IV
+    ASSERT_EQ(LogRequestHandler::DatagramStatus::MALFORMED, send(AES::encrypt(logRequest(), KEY)));
+    // not a valid log request
+    ASSERT_EQ(LogRequestHandler::DatagramStatus::MALFORMED, send(datagram(CLIENT_ID, R"({ "logger": "default" })")));
+}
+
+TEST_F(DatagramTest, QueuedAndDropped)
+{
+    ASSERT_EQ(LogRequestHandler::DatagramStatus::QUEUED, send(datagram(CLIENT_ID, logRequest())));
+    // without delimiter
+    std::string withoutDelimiter = datagram(CLIENT_ID, logRequest());
+    withoutDelimiter.erase(withoutDelimiter.size() - Session::PACKET_DELIMITER_SIZE);
+    LogRequestHandler::DatagramStatus status = send(withoutDelimiter);
+    ASSERT_NE(LogRequestHandler::DatagramStatus::MALFORMED, status);
+
+    // once queue is at max_queue_depth datagrams are dropped instead of pausing anyone
+    // (worker only drains it every 100ms)
+    unsigned int queued = 0;
+    for (int i = 0; i < 100 && status != LogRequestHandler::DatagramStatus::DROPPED; ++i) {
+        status = send(datagram(CLIENT_ID, logRequest()));
+        if (status == LogRequestHandler::DatagramStatus::QUEUED) {
+            ++queued;
+        }
+    }
+    ASSERT_EQ(LogRequestHandler::DatagramStatus::DROPPED, status);
+    ASSERT_LT(queued, 100U);
+}
+
+#endif // NETWORKING_TEST_H
@@ -20,9 +20,16 @@
 #ifndef TASK_SCHEDULE_TEST_H
 #define TASK_SCHEDULE_TEST_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "test.h"
 
 #include "tasks/task.h"
+#include "tasks/task-scheduler.h"
 #include "utils/utils.h"
 
 using namespace residue;
@@ -38,7 +45,10 @@ public:
     virtual void execute() override
     {
         LOG(INFO) << "SimpleTask::execute()";
+        ++executions;
     }
+
+    int executions = 0;
 };
 
 TEST(TaskScheduleTest, TestBasicSchedule)
@@ -51,4 +61,134 @@ TEST(TaskScheduleTest, TestBasicSchedule)
     ASSERT_EQ(interv, t.intervalCount());
 }
 
+TEST(TaskScheduleTest, SchedulerDispatchesDueTasks)
+{
+    types::Time now = 1000;
+    TaskScheduler scheduler(0, [&]() { return now; });
+    SimpleTask t1(10);
+    SimpleTask t2(30);
+    scheduler.schedule(&t1);
+    scheduler.schedule(&t2);
+    ASSERT_TRUE(scheduler.isScheduled(&t1));
+    ASSERT_EQ(1010, scheduler.nextDue());
+
+    ASSERT_EQ(0, scheduler.tick());
+    ASSERT_EQ(0, t1.executions);
+
+    now = 1010;
+    ASSERT_EQ(1, scheduler.tick());
+    ASSERT_EQ(1, t1.executions);
+    ASSERT_EQ(0, t2.executions);
+    ASSERT_EQ(1020, t1.nextExecution());
+    ASSERT_EQ(1020, scheduler.nextDue());
+
+    // both due, t1 is rescheduled from current time
+    now = 1035;
+    ASSERT_EQ(2, scheduler.tick());
+    ASSERT_EQ(2, t1.executions);
+    ASSERT_EQ(1, t2.executions);
+    ASSERT_EQ(1045, scheduler.nextDue());
+    ASSERT_FALSE(t1.isExecuting());
+}
+
+TEST(TaskScheduleTest, SchedulerCancelAndReschedule)
+{
+    types::Time now = 1000;
+    TaskScheduler scheduler(0, [&]() { return now; });
+    SimpleTask t1(10);
+    SimpleTask t2(30);
+    scheduler.schedule(&t1);
+    scheduler.schedule(&t2);
+
+    scheduler.cancel(&t1);
+    ASSERT_FALSE(scheduler.isScheduled(&t1));
+    ASSERT_EQ(1030, scheduler.nextDue());
+    now = 1010;
+    ASSERT_EQ(0, scheduler.tick());
+    ASSERT_EQ(0, t1.executions);
+
+    // interval changed (e.g, config reload), new schedule takes over straight away
+    t2.setInterval(5);
+    scheduler.schedule(&t2);
+    ASSERT_EQ(1015, scheduler.nextDue());
+    now = 1030;
+    ASSERT_EQ(1, scheduler.tick());
+    ASSERT_EQ(1, t2.executions);
+    ASSERT_EQ(1035, scheduler.nextDue());
+
+    scheduler.cancel(&t2);
+    ASSERT_EQ(0, scheduler.nextDue());
+}
+
+TEST(TaskScheduleTest, ManualRunDoesNotRaceScheduled)
+{
+    SimpleTask t(10);
+    ASSERT_TRUE(t.beginExecution());
+    ASSERT_FALSE(t.kickOff());
+    ASSERT_EQ(0, t.executions);
+    t.endExecution();
+    ASSERT_TRUE(t.kickOff());
+    ASSERT_EQ(1, t.executions);
+}
+
+TEST(TaskScheduleTest, WorkerPerTask)
+{
+    // long running task (e.g, rotator archiving) does not hold up other tasks
+    class BlockingTask final : public Task
+    {
+    public:
+        BlockingTask() : Task("BlockingTask", nullptr, 10), released(false) {}
+        virtual void execute() override
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return released; });
+        }
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool released;
+    };
+    class CountingTask final : public Task
+    {
+    public:
+        CountingTask() : Task("CountingTask", nullptr, 10), executions(0) {}
+        virtual void execute() override
+        {
+            ++executions;
+        }
+        std::atomic<int> executions;
+    };
+    std::atomic<types::Time> now(1000);
+    TaskScheduler scheduler(TaskScheduler::WORKER_PER_TASK, [&]() { return now.load(); });
+    BlockingTask blocking;
+    CountingTask t;
+    scheduler.schedule(&blocking);
+    scheduler.schedule(&t);
+    now = 1010;
+    std::thread timer([&]() {
+        scheduler.start();
+    });
+    for (int i = 0; i < 200 && (t.executions == 0 || !blocking.isExecuting()); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(blocking.isExecuting());
+    ASSERT_EQ(1, t.executions.load());
+    {
+        std::lock_guard<std::mutex> lock(blocking.mutex);
+        blocking.released = true;
+    }
+    blocking.cv.notify_all();
+    scheduler.stop();
+    timer.join();
+}
+
+TEST(TaskScheduleTest, PostRunsInlineWithoutWorkers)
+{
+    TaskScheduler scheduler(0);
+    int ran = 0;
+    scheduler.post([&]() {
+        ++ran;
+    });
+    ASSERT_EQ(1, ran);
+}
+
 #endif // TASK_SCHEDULE_TEST_H
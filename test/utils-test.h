@@ -21,9 +21,12 @@
 #define UTILS_TEST_H
 
 #include <cstdio>
+#include <fstream>
 
 #include "test.h"
 
+#include "utils/archive-index.h"
+#include "utils/bloom-filter.h"
 #include "utils/utils.h"
 
 using namespace residue;
@@ -174,4 +177,202 @@ TEST(UtilsTest, TimeToTmTest)
     ASSERT_STREQ(time.tm_zone, "AEDT");
 }
 
+TEST(UtilsTest, CompressedArchiveFormat)
+{
+    ASSERT_EQ(Utils::compressedArchiveFormat("mylogs-%hour-00-%wday.tar.gz"), Utils::ArchiveFormat::TarGz);
+    ASSERT_EQ(Utils::compressedArchiveFormat("mylogs-%hour-00-%wday.tgz"), Utils::ArchiveFormat::TarGz);
+    ASSERT_EQ(Utils::compressedArchiveFormat("mylogs-%hour-00-%wday"), Utils::ArchiveFormat::TarGz);
+    ASSERT_EQ(Utils::compressedArchiveFormat("mylogs-%hour-00-%wday.tar.zst"), Utils::ArchiveFormat::TarZstd);
+    ASSERT_EQ(Utils::compressedArchiveFormat("mylogs-%hour-00-%wday.tzst"), Utils::ArchiveFormat::TarZstd);
+    ASSERT_EQ(Utils::compressedArchiveFormat("mylogs.tar.zst.tar.gz"), Utils::ArchiveFormat::TarGz);
+}
+
+TEST(UtilsTest, ArchiveFilesZstd)
+{
+    std::string archive = "archive.tmp.tar.zst";
+    std::remove(archive.c_str());
+    std::ofstream f(kUtilsTestFile);
+    f << "line 1" << std::endl << "line 2" << std::endl;
+    f.close();
+    std::unordered_map<std::string, std::string> files = { { kUtilsTestFile, "file.log" } };
+    bool result = Utils::archiveFiles(archive, files, Utils::ArchiveFormat::TarZstd, 2, 3, true);
+    ASSERT_EQ(result, Utils::isZstdSupported());
+    if (result) {
+        ASSERT_TRUE(Utils::fileExists(archive.c_str()));
+        // zstd frame magic number (little endian 0xFD2FB528)
+        std::ifstream in(archive, std::ios::binary);
+        unsigned char magic[4] = { 0 };
+        in.read(reinterpret_cast<char*>(magic), 4);
+        ASSERT_EQ(magic[0], 0x28);
+        ASSERT_EQ(magic[1], 0xB5);
+        ASSERT_EQ(magic[2], 0x2F);
+        ASSERT_EQ(magic[3], 0xFD);
+    }
+    std::remove(archive.c_str());
+    std::remove(kUtilsTestFile);
+}
+
+TEST(UtilsTest, ArchiveFilesTar)
+{
+    std::string archive = "archive.tmp.tar";
+    std::remove(archive.c_str());
+    std::ofstream f(kUtilsTestFile);
+    for (int i = 0; i < 1000; ++i) {
+        f << "line " << i << std::endl;
+    }
+    f.close();
+    long size = Utils::fileSize(kUtilsTestFile);
+    std::unordered_map<std::string, std::string> files = { { kUtilsTestFile, "file.log" } };
+    ASSERT_TRUE(Utils::archiveFiles(archive, files, Utils::ArchiveFormat::Tar));
+    // header, contents padded to 512 bytes and two empty blocks at the end
+    ASSERT_EQ(512 + ((size + 511) / 512) * 512 + 1024, Utils::fileSize(archive.c_str()));
+    std::ifstream in(archive, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ASSERT_EQ("file.log", std::string(contents.c_str()));
+    ASSERT_EQ("line 0\nline 1\n", contents.substr(512, 14));
+    ASSERT_EQ("line 999\n", contents.substr(512 + size - 9, 9));
+    std::remove(archive.c_str());
+    std::remove(kUtilsTestFile);
+}
+
+TEST(UtilsTest, ArchiveIndexExtract)
+{
+    std::string archive = "archive.tmp.tar.gz";
+    std::string segment = std::string(kUtilsTestFile) + ".segment-1";
+    std::string compressedSegment = segment + ".gz";
+    std::ofstream f(segment);
+    for (int i = 0; i < 100; ++i) {
+        f << "old " << i << std::endl;
+    }
+    f.close();
+    long segmentSize = Utils::fileSize(segment.c_str());
+    ASSERT_TRUE(Utils::compressFile(compressedSegment, segment, Utils::ArchiveFormat::TarGz));
+    // segment is recompressed from its raw data when archive format changes
+    std::string restored = segment + ".restored";
+    ASSERT_TRUE(Utils::decompressFile(restored, compressedSegment, Utils::ArchiveFormat::TarGz));
+    ASSERT_EQ(segmentSize, Utils::fileSize(restored.c_str()));
+    std::remove(restored.c_str());
+    ASSERT_FALSE(Utils::decompressFile(restored, segment + ".missing", Utils::ArchiveFormat::TarGz));
+    f.open(kUtilsTestFile);
+    for (int i = 0; i < 100; ++i) {
+        f << "new " << i << std::endl;
+    }
+    f.close();
+    long size = Utils::fileSize(kUtilsTestFile);
+
+    std::unordered_map<std::string, std::string> files = { { kUtilsTestFile, "file.log" } };
+    Utils::CompressedSegments segments;
+    segments[kUtilsTestFile].push_back({ compressedSegment, static_cast<std::size_t>(segmentSize), 1000, 2000 });
+    std::vector<ArchiveFrame> frames;
+    ASSERT_TRUE(Utils::archiveFilesWithSegments(archive, files, segments, Utils::ArchiveFormat::TarGz,
+                                                1, 3, false, &frames));
+    ASSERT_EQ(2, frames.size());
+    ASSERT_EQ(static_cast<std::size_t>(segmentSize), frames[0].length);
+    ASSERT_EQ(static_cast<std::size_t>(size), frames[1].length);
+    ASSERT_EQ(2000, frames[1].from);
+
+    ASSERT_TRUE(ArchiveIndex::write(archive, frames));
+    std::vector<ArchiveFrame> read;
+    ASSERT_TRUE(ArchiveIndex::read(archive, &read));
+    ASSERT_EQ(2, read.size());
+    ASSERT_EQ(frames[1].offset, read[1].offset);
+    ASSERT_EQ("file.log", read[1].name);
+
+    ASSERT_TRUE(ArchiveIndex::overlaps(frames[0], 1500, 1600));
+    ASSERT_FALSE(ArchiveIndex::overlaps(frames[0], 2001, 0));
+    ASSERT_FALSE(ArchiveIndex::overlaps(frames[0], 0, 999));
+
+    std::string errorText;
+    std::ostringstream out;
+    ASSERT_EQ(1, ArchiveIndex::extract(archive, 1500, 1600, out, 0, &errorText));
+    ASSERT_EQ(static_cast<std::size_t>(segmentSize), out.str().size());
+    ASSERT_EQ("old 0\n", out.str().substr(0, 6));
+    ASSERT_EQ("old 99\n", out.str().substr(segmentSize - 7));
+
+    out.str("");
+    ASSERT_EQ(2, ArchiveIndex::extract(archive, 0, 0, out, 0, &errorText));
+    ASSERT_EQ(static_cast<std::size_t>(segmentSize + size), out.str().size());
+    ASSERT_EQ("new 99\n", out.str().substr(segmentSize + size - 7));
+
+    out.str("");
+    ASSERT_EQ(1, ArchiveIndex::extract(archive, 0, 0, out, 10, &errorText));
+    ASSERT_EQ("old 0\nold ", out.str());
+
+    std::remove(ArchiveIndex::indexFilename(archive).c_str());
+    ASSERT_EQ(-1, ArchiveIndex::extract(archive, 0, 0, out, 0, &errorText));
+    std::remove(archive.c_str());
+    std::remove(segment.c_str());
+    std::remove(compressedSegment.c_str());
+    std::remove(kUtilsTestFile);
+}
+
+TEST(UtilsTest, BloomFilter)
+{
+    std::vector<std::string> tokens;
+    std::string line = "2018-02-26 16:10:01,123 INFO request-id=a1b2c3 done (200)\n";
+    BloomFilter::tokenize(line.data(), line.size(), [&](const char* token, std::size_t len) {
+        tokens.push_back(std::string(token, len));
+    });
+    std::vector<std::string> expected = { "2018", "02", "26", "16", "10", "01", "123", "INFO",
+                                          "request", "id", "a1b2c3", "done", "200" };
+    ASSERT_EQ(expected, tokens);
+
+    BloomFilter filter(BloomFilter::MIN_SIZE, 0.01f);
+    ASSERT_EQ(7, filter.hashes());
+    for (int i = 0; i < 500; ++i) {
+        std::vector<std::uint64_t> hashes;
+        BloomFilter::hashTokens("request-" + std::to_string(i), &hashes);
+        filter.add(hashes);
+    }
+    ASSERT_EQ(1000, filter.count());
+    for (int i = 0; i < 500; ++i) {
+        std::string token = std::to_string(i);
+        ASSERT_TRUE(filter.mayContain(BloomFilter::hash(token.data(), token.size())));
+    }
+    // 500 unique tokens in 8192 bits, far less than 5% should be false positives
+    int falsePositives = 0;
+    for (int i = 1000; i < 2000; ++i) {
+        std::string token = std::to_string(i);
+        falsePositives += filter.mayContain(BloomFilter::hash(token.data(), token.size())) ? 1 : 0;
+    }
+    ASSERT_LT(falsePositives, 50);
+
+    BloomFilter empty(BloomFilter::MIN_SIZE, 0.5f);
+    ASSERT_EQ(1, empty.hashes());
+    std::string filename = BloomFilter::filterFilename(kUtilsTestFile);
+    ASSERT_TRUE(BloomFilter::write(filename, { { 0, &empty }, { 512, &filter } }));
+    BloomFilter read;
+    ASSERT_TRUE(BloomFilter::read(filename, 512, &read));
+    ASSERT_EQ(filter.size(), read.size());
+    ASSERT_EQ(filter.count(), read.count());
+    std::vector<std::uint64_t> hashes;
+    BloomFilter::hashTokens("request 250", &hashes);
+    ASSERT_TRUE(read.mayContainAll(hashes));
+    ASSERT_TRUE(BloomFilter::read(filename, 0, &read));
+    ASSERT_FALSE(read.mayContainAll(hashes));
+    ASSERT_FALSE(BloomFilter::read(filename, 1, &read));
+    std::remove(filename.c_str());
+
+    // clamped size has hashes for the words requested size holds
+    ASSERT_EQ(7, BloomFilter(BloomFilter::MIN_SIZE * 2, 0.01f).hashes());
+    ASSERT_EQ(13, BloomFilter(BloomFilter::MIN_SIZE / 2, 0.01f).hashes());
+    ASSERT_EQ(BloomFilter::MAX_HASHES, BloomFilter(1, 0.01f).hashes());
+
+    // token across read blocks
+    std::ofstream out(kUtilsTestFile, std::ios::out | std::ios::trunc);
+    out << std::string(64 * 1024 - 4, ' ') << "boundary request-id=a1b2c3\nlast";
+    out.close();
+    std::shared_ptr<BloomFilter> built = BloomFilter::build(kUtilsTestFile, BloomFilter::MIN_SIZE, 0.01f);
+    ASSERT_NE(nullptr, built);
+    ASSERT_EQ(5, built->count());
+    hashes.clear();
+    BloomFilter::hashTokens("boundary a1b2c3 last", &hashes);
+    ASSERT_TRUE(built->mayContainAll(hashes));
+    hashes.clear();
+    BloomFilter::hashTokens("bound", &hashes);
+    ASSERT_FALSE(built->mayContainAll(hashes));
+    std::remove(kUtilsTestFile);
+    ASSERT_EQ(nullptr, BloomFilter::build(kUtilsTestFile, BloomFilter::MIN_SIZE, 0.01f));
+}
+
 #endif // UTILS_TEST_H